@@ -0,0 +1,107 @@
+#include "aer.h"
+#include <unistd.h>
+
+AerWriter::AerWriter(std::ostream *_out, const size_t n, const bool append, const uint64_t _last) 
+    : out(_out), last(_last) {
+    buffer.reserve(block_size + (1<<12));
+    if (append) return;
+    buffer.insert(buffer.end(), {'N', 'N', 'A', 'E', 'R', (char)version});
+    put(n);
+}
+
+AerWriter::~AerWriter() {
+    try {
+        flush();
+    } catch (...) {}
+}
+
+void AerWriter::close(const uint64_t endstep) {
+    if (closed) return;
+    put(0);
+    put(endstep);
+    flush();
+    out->flush();
+    closed = true;
+}
+
+void AerWriter::flush() {
+    out->write(buffer.data(), buffer.size());
+    if (out->bad()) throw(OUTPUT_ERROR("Cannot write AER raster"));
+    buffer.clear();
+}
+
+AerReader::AerReader(std::istream *_in) : in(_in) {
+    char head[6];
+    in->read(head, 6);
+    if (!in->good() || std::string(head, 5) != "NNAER" || head[5] != AerWriter::version)
+        throw(CFILE_ERROR("Not an AER raster file"));
+    nneurons = get();
+}
+
+uint64_t AerReader::get() {
+    uint64_t x = 0;
+    for (int shift=0; ; shift+=7) {
+        int c = in->get();
+        if (c == EOF || shift > 63) throw(CFILE_ERROR("Truncated AER raster file"));
+        x |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) return x;
+    }
+}
+
+bool AerReader::next(uint64_t &step, std::vector<size_t> &spk) {
+    spk.clear();
+    uint64_t delta = get();
+    if (delta == 0) {
+        step = get();
+        return false;
+    }
+    step = last += delta;
+    size_t ns = get(), n = 0;
+    for (size_t k=0; k<ns; k++) {
+        n += get();
+        if (n >= nneurons) throw(CFILE_ERROR("Invalid neuron index in AER raster file"));
+        spk.push_back(n);
+    }
+    return true;
+}
+
+void AerReader::to_text(std::istream *_in, std::ostream *_out) {
+    AerReader aer(_in);
+    std::vector<char> line(aer.size(), '0');
+    std::vector<size_t> spk;
+    uint64_t step, time = 0;
+    bool more = true;
+    while (more) {
+        more = aer.next(step, spk);
+        for (time++; time<=step; time++) {
+            bool fire = more && time==step;
+            if (fire) for (auto n : spk) line[n] = '1';
+            (*_out) << time;
+            for (auto c : line) (*_out) << ' ' << c;
+            (*_out) << '\n';
+            if (fire) for (auto n : spk) line[n] = '0';
+        }
+        time = step;
+    }
+    _out->flush();
+}
+
+uint64_t AerReader::truncate(const std::string &filename, const uint64_t step) {
+    uint64_t offset, kept = 0, recstep;
+    {
+        std::ifstream inf(filename, std::ios::binary);
+        if (!inf.is_open()) throw(CFILE_ERROR("Could not open file " + filename));
+        AerReader aer(&inf);
+        std::vector<size_t> spk;
+        offset = inf.tellg();
+// --- the file may end with an incomplete record if the simulation was interrupted
+        try {
+            while (aer.next(recstep, spk) && recstep <= step) {
+                kept = recstep;
+                offset = inf.tellg();
+            }
+        } catch (CFILE_ERROR&) {}
+    }
+    if (::truncate(filename.c_str(), offset) != 0) throw(OUTPUT_ERROR("Cannot truncate file " + filename));
+    return kept;
+}
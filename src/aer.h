@@ -0,0 +1,121 @@
+#ifndef AER_H
+#define AER_H
+
+#include "globals.h"
+
+/*! \class AerWriter
+  Writes a spike raster in a compact binary address-event representation (AER):
+  only the (time-step, neuron index) pairs of the spikes are stored, instead of one value per neuron and per step.
+
+  Layout of the file (all integers are unsigned LEB128 varints):
+  - header: the 5 bytes "NNAER", one byte of \ref version, the number of neurons,
+  - one record for each time-step with at least one spike: the step minus the step of the previous record
+    (the first record is relative to step 0), the number of spikes, then the indices of the firing neurons
+    in increasing order, the first one as is and the following ones as differences to the previous one,
+  - an end record: 0 followed by the last time-step of the simulation.
+
+  Records are accumulated in a memory buffer and written to the stream in blocks of \ref block_size bytes.
+  Files are converted back to the text raster of Simulation::run by \ref AerReader::to_text
+  (see the program *NeuronNet_aer2txt*).
+ */
+
+class AerWriter {
+
+public:
+    static const unsigned char version = 1;
+    static const size_t block_size = 1<<20;
+/*!
+  Writes the header to \p _out for a network of \p n neurons.
+  With \p append, the stream already holds a raster truncated by \ref AerReader::truncate, 
+  which ends with a record at time-step \p _last: no header is written and the records go on from there.
+ */
+    AerWriter(std::ostream *_out, const size_t n, const bool append=false, const uint64_t _last=0);
+/*!
+  Writes the buffered records, ignoring errors, but not the end record: 
+  a raster which has not been \ref close "closed" (failed run) is seen as truncated by \ref AerReader.
+ */
+    ~AerWriter();
+/*!
+  Adds the spikes of time-step \p step (which must be larger than the previous one).
+  \param spk : indices of firing neurons, in increasing order.
+ */
+    template<typename Container>
+    void write(const uint64_t step, const Container &spk) {
+        if (spk.empty()) return;
+        put(step-last);
+        put(spk.size());
+        size_t prev = 0;
+        for (auto n : spk) {
+            put(n-prev);
+            prev = n;
+        }
+        last = step;
+        if (buffer.size() >= block_size) flush();
+    }
+/*!
+  Writes the end record with the last time-step \p endstep and flushes the buffer.
+ */
+    void close(const uint64_t endstep);
+/*!
+  Writes the buffered records to the stream and flushes it.
+ */
+    void sync() {
+        flush();
+        out->flush();
+    }
+
+private:
+    void put(uint64_t x) {
+        for (; x >= 0x80; x >>= 7) buffer.push_back((char)(x | 0x80));
+        buffer.push_back((char)x);
+    }
+    void flush();
+
+    std::ostream *out;
+    std::vector<char> buffer;
+    uint64_t last = 0;
+    bool closed = false;
+
+};
+
+/*! \class AerReader
+  Reads the files written by \ref AerWriter, one time-step with spikes at a time.
+ */
+
+class AerReader {
+
+public:
+/*!
+  Reads the header, throws a CFILE_ERROR if the stream is not in AER format.
+ */
+    AerReader(std::istream *_in);
+    size_t size() const {return nneurons;}
+/*!
+  Reads the next record.
+  \param step : time-step of the spikes,
+  \param spk : indices of the firing neurons.
+  \return false at the end record, then \p step is the last time-step of the simulation.
+ */
+    bool next(uint64_t &step, std::vector<size_t> &spk);
+/*!
+  Converts an AER file to the text raster of Simulation::run:
+  one line per time-step with the step followed by 0 or 1 for each neuron.
+ */
+    static void to_text(std::istream *_in, std::ostream *_out);
+/*!
+  Removes the records after time-step \p step and the end record from the file \p filename,
+  so that it can be continued with an \ref AerWriter in append mode.
+  \return the time-step of the last record kept (0 if there is none).
+ */
+    static uint64_t truncate(const std::string &filename, const uint64_t step);
+
+private:
+    uint64_t get();
+
+    std::istream *in;
+    size_t nneurons;
+    uint64_t last = 0;
+
+};
+
+#endif //AER_H
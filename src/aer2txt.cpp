@@ -0,0 +1,33 @@
+#include "aer.h"
+
+/*!
+  \file aer2txt.cpp
+  Converts a raster written with `--raster-format=aer` to the text raster format:
+  \verbatim
+ ./NeuronNet_aer2txt test1000 [test1000.txt]
+  \endverbatim
+  The text raster is written to the second file, or to the screen.
+ */
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " aer_file [text_file]" << std::endl;
+        return 1;
+    }
+    try {
+        std::ifstream inf(argv[1], std::ios::binary);
+        if (!inf.is_open()) throw(CFILE_ERROR(std::string("Could not open file ")+argv[1]));
+        std::ofstream outf;
+        std::ostream *_outf = &std::cout;
+        if (argc > 2) {
+            outf.open(argv[2]);
+            if (!outf.is_open()) throw(OUTPUT_ERROR(std::string("Cannot write to file ")+argv[2]));
+            _outf = &outf;
+        }
+        AerReader::to_text(&inf, _outf);
+    } catch (SimulError &e) {
+        std::cerr << e.what() << std::endl;
+        return e.value();
+    }
+    return 0;
+}
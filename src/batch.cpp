@@ -0,0 +1,193 @@
+#include "batch.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define _BATCH_X86_ 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+struct BatchArrays {
+    const double *a, *b, *c, *d, *w;
+    double *v, *u, *I;
+    const double *thal, *fired;
+    double *next;
+    const size_t *row_start, *src;
+    const double *wgt;
+    size_t K;
+};
+
+/// * synaptic input of neuron n for all trials, inhibitory links carry a negative intensity (see Network::add_link) *
+inline void gather_scalar(const BatchArrays &p, const size_t n, size_t k, double *exc, double *inh) {
+    for (size_t l=p.row_start[n]; l<p.row_start[n+1]; l++) {
+        const double wl = p.wgt[l], *f = p.fired + p.src[l]*p.K;
+        if (wl < 0) for (size_t j=k; j<p.K; j++) inh[j] -= wl*f[j];
+        else        for (size_t j=k; j<p.K; j++) exc[j] += wl*f[j];
+    }
+}
+
+inline void update_scalar(const BatchArrays &p, const size_t n, size_t k, const double *exc, const double *inh) {
+    const double th = Neuron::firing_threshold();
+    for (size_t j=n*p.K+k; k<p.K; k++, j++)
+        p.next[j] = NeuronPopulation::update(p.v[j], p.u[j], p.I[j], p.a[n], p.b[n], p.c[n], p.d[n], p.w[n],
+                                             p.thal[j], exc[k], inh[k], th) ? 1.0 : 0.0;
+}
+
+void kernel_scalar(const BatchArrays &p, const size_t begin, const size_t end, double *exc, double *inh) {
+    for (size_t n=begin; n<end; n++) {
+        std::fill(exc, exc+p.K, 0.0);
+        std::fill(inh, inh+p.K, 0.0);
+        gather_scalar(p, n, 0, exc, inh);
+        update_scalar(p, n, 0, exc, inh);
+    }
+}
+
+#ifdef _BATCH_X86_
+// Same operations in the same order as gather_scalar and NeuronPopulation::update (no FMA),
+// vectorized across trials with the parameters of the neuron broadcast.
+
+__attribute__((target("avx2")))
+void kernel_avx2(const BatchArrays &p, const size_t begin, const size_t end, double *exc, double *inh) {
+    const __m256d th = _mm256_set1_pd(Neuron::firing_threshold()), half = _mm256_set1_pd(0.5),
+        c004 = _mm256_set1_pd(0.04), c5 = _mm256_set1_pd(5), c140 = _mm256_set1_pd(140), one = _mm256_set1_pd(1);
+    const size_t K4 = p.K - p.K%4;
+    for (size_t n=begin; n<end; n++) {
+        std::fill(exc, exc+p.K, 0.0);
+        std::fill(inh, inh+p.K, 0.0);
+        for (size_t l=p.row_start[n]; l<p.row_start[n+1]; l++) {
+            const double *f = p.fired + p.src[l]*p.K;
+            const __m256d wl = _mm256_set1_pd(p.wgt[l]);
+            double *acc = (p.wgt[l] < 0) ? inh : exc;
+            for (size_t k=0; k<K4; k+=4) {
+                __m256d x = _mm256_mul_pd(wl, _mm256_loadu_pd(f+k)), s = _mm256_loadu_pd(acc+k);
+                _mm256_storeu_pd(acc+k, (p.wgt[l] < 0) ? _mm256_sub_pd(s, x) : _mm256_add_pd(s, x));
+            }
+        }
+        gather_scalar(p, n, K4, exc, inh);
+        const __m256d a = _mm256_set1_pd(p.a[n]), b = _mm256_set1_pd(p.b[n]), c = _mm256_set1_pd(p.c[n]),
+            d = _mm256_set1_pd(p.d[n]), w = _mm256_set1_pd(p.w[n]);
+        for (size_t k=0, j=n*p.K; k<K4; k+=4, j+=4) {
+            __m256d v = _mm256_loadu_pd(p.v+j), u = _mm256_loadu_pd(p.u+j);
+            __m256d fired = _mm256_cmp_pd(v, th, _CMP_GT_OQ);
+            v = _mm256_blendv_pd(v, c, fired);
+            u = _mm256_blendv_pd(u, _mm256_add_pd(u, d), fired);
+            __m256d I = _mm256_add_pd(_mm256_mul_pd(w, _mm256_loadu_pd(p.thal+j)),
+                                      _mm256_mul_pd(half, _mm256_loadu_pd(exc+k)));
+            I = _mm256_sub_pd(I, _mm256_loadu_pd(inh+k));
+            for (int h=0; h<2; h++) {
+                __m256d dv = _mm256_mul_pd(_mm256_mul_pd(c004, v), v);
+                dv = _mm256_add_pd(dv, _mm256_mul_pd(c5, v));
+                dv = _mm256_sub_pd(_mm256_add_pd(dv, c140), u);
+                v = _mm256_add_pd(v, _mm256_mul_pd(half, _mm256_add_pd(dv, I)));
+            }
+            u = _mm256_add_pd(u, _mm256_mul_pd(a, _mm256_sub_pd(_mm256_mul_pd(b, v), u)));
+            _mm256_storeu_pd(p.v+j, v);
+            _mm256_storeu_pd(p.u+j, u);
+            _mm256_storeu_pd(p.I+j, I);
+            _mm256_storeu_pd(p.next+j, _mm256_and_pd(_mm256_cmp_pd(v, th, _CMP_GT_OQ), one));
+        }
+        update_scalar(p, n, K4, exc, inh);
+    }
+}
+
+__attribute__((target("avx512f")))
+void kernel_avx512(const BatchArrays &p, const size_t begin, const size_t end, double *exc, double *inh) {
+    const __m512d th = _mm512_set1_pd(Neuron::firing_threshold()), half = _mm512_set1_pd(0.5),
+        c004 = _mm512_set1_pd(0.04), c5 = _mm512_set1_pd(5), c140 = _mm512_set1_pd(140), one = _mm512_set1_pd(1);
+    const size_t K8 = p.K - p.K%8;
+    for (size_t n=begin; n<end; n++) {
+        std::fill(exc, exc+p.K, 0.0);
+        std::fill(inh, inh+p.K, 0.0);
+        for (size_t l=p.row_start[n]; l<p.row_start[n+1]; l++) {
+            const double *f = p.fired + p.src[l]*p.K;
+            const __m512d wl = _mm512_set1_pd(p.wgt[l]);
+            double *acc = (p.wgt[l] < 0) ? inh : exc;
+            for (size_t k=0; k<K8; k+=8) {
+                __m512d x = _mm512_mul_pd(wl, _mm512_loadu_pd(f+k)), s = _mm512_loadu_pd(acc+k);
+                _mm512_storeu_pd(acc+k, (p.wgt[l] < 0) ? _mm512_sub_pd(s, x) : _mm512_add_pd(s, x));
+            }
+        }
+        gather_scalar(p, n, K8, exc, inh);
+        const __m512d a = _mm512_set1_pd(p.a[n]), b = _mm512_set1_pd(p.b[n]), c = _mm512_set1_pd(p.c[n]),
+            d = _mm512_set1_pd(p.d[n]), w = _mm512_set1_pd(p.w[n]);
+        for (size_t k=0, j=n*p.K; k<K8; k+=8, j+=8) {
+            __m512d v = _mm512_loadu_pd(p.v+j), u = _mm512_loadu_pd(p.u+j);
+            __mmask8 fired = _mm512_cmp_pd_mask(v, th, _CMP_GT_OQ);
+            v = _mm512_mask_mov_pd(v, fired, c);
+            u = _mm512_mask_add_pd(u, fired, u, d);
+            __m512d I = _mm512_add_pd(_mm512_mul_pd(w, _mm512_loadu_pd(p.thal+j)),
+                                      _mm512_mul_pd(half, _mm512_loadu_pd(exc+k)));
+            I = _mm512_sub_pd(I, _mm512_loadu_pd(inh+k));
+            for (int h=0; h<2; h++) {
+                __m512d dv = _mm512_mul_pd(_mm512_mul_pd(c004, v), v);
+                dv = _mm512_add_pd(dv, _mm512_mul_pd(c5, v));
+                dv = _mm512_sub_pd(_mm512_add_pd(dv, c140), u);
+                v = _mm512_add_pd(v, _mm512_mul_pd(half, _mm512_add_pd(dv, I)));
+            }
+            u = _mm512_add_pd(u, _mm512_mul_pd(a, _mm512_sub_pd(_mm512_mul_pd(b, v), u)));
+            _mm512_storeu_pd(p.v+j, v);
+            _mm512_storeu_pd(p.u+j, u);
+            _mm512_storeu_pd(p.I+j, I);
+            _mm512_storeu_pd(p.next+j, _mm512_maskz_mov_pd(_mm512_cmp_pd_mask(v, th, _CMP_GT_OQ), one));
+        }
+        update_scalar(p, n, K8, exc, inh);
+    }
+}
+#endif
+
+}
+
+TrialBatch::TrialBatch(const Network &net, const std::vector<unsigned long> &seeds, const size_t nthreads)
+    : pop(net.neurons), syn(net.synapses), N(net.size()), K(seeds.size()), spike_lists(seeds.size()) {
+    net.index_links();
+    if (syn.max_delay() > 1) throw(TCLAP_ERROR("Trials of a network with link delays are not supported"));
+    if (net.is_reordered()) throw(TCLAP_ERROR("Trials of a reordered network are not supported"));
+    for (auto s : seeds) rngs.push_back(RandomNumbers(s));
+    for (auto vec : {&v, &u, &I, &thal, &fired, &next}) vec->assign(N*K, 0.0);
+    const double th = Neuron::firing_threshold();
+    for (size_t n=0; n<N; n++)
+        for (size_t k=0; k<K; k++) {
+            v[n*K+k] = pop.v[n];
+            u[n*K+k] = pop.u[n];
+            I[n*K+k] = pop.I[n];
+            fired[n*K+k] = (pop.v[n] > th) ? 1.0 : 0.0;
+        }
+    size_t nchunks = 1;
+    if (nthreads > 1) {
+        pool = std::make_shared<ThreadPool>(nthreads);
+        nchunks = 4*nthreads;
+    }
+    for (size_t c=0; c<=nchunks; c++) chunk_bounds.push_back(c*N/nchunks);
+    chunk_bounds.erase(std::unique(chunk_bounds.begin(), chunk_bounds.end()), chunk_bounds.end());
+    scratch.resize(chunk_bounds.size()-1);
+    for (size_t c=0; c+1<chunk_bounds.size(); c++)
+        scratch[c].assign(2*K + chunk_bounds[c+1]-chunk_bounds[c], 0.0);
+}
+
+void TrialBatch::step(const double thalam, const uint64_t time) {
+    for (size_t k=0; k<K; k++) spike_lists[k].clear();
+    for (size_t n=0; n<N; n++)
+        for (size_t k=0; k<K; k++)
+            if (fired[n*K+k] != 0) spike_lists[k].push_back(n);
+    const BatchArrays p{pop.a.data(), pop.b.data(), pop.c.data(), pop.d.data(), pop.w.data(),
+                        v.data(), u.data(), I.data(), thal.data(), fired.data(), next.data(),
+                        syn.row_start.data(), syn.source_data(), syn.weight_data(), K};
+    const NeuronPopulation::SimdLevel level = NeuronPopulation::simd_level();
+    auto chunk_step = [&](size_t c) {
+        size_t begin = chunk_bounds[c], end = chunk_bounds[c+1];
+        double *exc = scratch[c].data(), *inh = exc+K, *noise = inh+K;
+        for (size_t k=0; k<K; k++) {
+            rngs[k].normal(noise, begin, end-begin, time, RandomNumbers::THALAMIC, 0, thalam);
+            for (size_t n=begin; n<end; n++) thal[n*K+k] = noise[n-begin];
+        }
+#ifdef _BATCH_X86_
+        if (level == NeuronPopulation::AVX512) kernel_avx512(p, begin, end, exc, inh);
+        else if (level == NeuronPopulation::AVX2) kernel_avx2(p, begin, end, exc, inh);
+        else
+#endif
+        kernel_scalar(p, begin, end, exc, inh);
+    };
+    if (pool) pool->run(scratch.size(), std::ref(chunk_step));
+    else for (size_t c=0; c<scratch.size(); c++) chunk_step(c);
+    fired.swap(next);
+}
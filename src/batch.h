@@ -0,0 +1,66 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "network.h"
+#include "random.h"
+
+/*! \class TrialBatch
+  Runs K independent trials of the same \ref Network at once: the trials share the parameters and the 
+  \ref SynapseTable of the network, only their dynamic state is replicated.
+
+  The state arrays are interleaved by trial: the K values of neuron *n* are contiguous (index *n*K+k*),
+  so that the synaptic gather and the neuron update run with SIMD registers across trials.
+  Each link is read once per time-step for all trials: the input of neuron *n* in trial *k* is the sum of the weights 
+  of its incoming links multiplied by the firing flag (0 or 1) of the sending neuron in trial *k*.
+  This is the pull propagation of Network::step, and gives exactly the same values.
+
+  Trial *k* has its own thalamic noise, drawn from the RandomNumbers::THALAMIC stream of seed \p seeds[k]:
+  it evolves exactly as the network would with Network::step and a generator seeded with \p seeds[k].
+
+  The network must not be modified while the batch is used.
+ */
+
+class TrialBatch {
+
+public:
+/*!
+  Prepares one trial per seed in \p seeds, all starting from the current state of \p net,
+  the time-steps will run on \p nthreads threads.
+  Networks with link delays or \ref Network::reorder "reordered" networks are not supported (TCLAP_ERROR).
+ */
+    TrialBatch(const Network &net, const std::vector<unsigned long> &seeds, const size_t nthreads=1);
+    size_t trials() const {return K;}
+    size_t size() const {return N;}
+/*!
+  One time-step of all trials, with thalamic input of standard deviation \p thalam drawn for time-step \p time.
+  The neurons firing before the update (as returned by Network::step) are then given by \ref spikes.
+ */
+    void step(const double thalam, const uint64_t time);
+    const std::vector<size_t>& spikes(const size_t trial) const {return spike_lists[trial];}
+    double potential(const size_t trial, const size_t n) const {return v[n*K+trial];}
+    double recovery(const size_t trial, const size_t n) const {return u[n*K+trial];}
+
+private:
+    const NeuronPopulation &pop;
+    const SynapseTable &syn;
+    size_t N, K;
+    std::vector<RandomNumbers> rngs;
+/*! @name Trial-interleaved arrays
+  \ref fired and \ref next hold the firing flags before and after the current step.
+ */
+///@{
+    aligned_vector v, u, I, thal, fired, next;
+///@}
+    std::vector<std::vector<size_t> > spike_lists;
+/*! @name Parallel chunks
+  Consecutive ranges of neurons, with their scratch buffers (synaptic input of one neuron for all trials, noise).
+ */
+///@{
+    std::shared_ptr<ThreadPool> pool;
+    std::vector<size_t> chunk_bounds;
+    std::vector<aligned_vector> scratch;
+///@}
+
+};
+
+#endif //BATCH_H
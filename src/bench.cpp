@@ -0,0 +1,257 @@
+#include "network.h"
+#include "random.h"
+#include "ranks.h"
+#include "recorder.h"
+#include <chrono>
+#include <tclap/CmdLine.h>
+
+/*!
+  \file bench.cpp
+  Micro-benchmarks of the hot paths of the simulation, written as JSON:
+  \verbatim
+ ./NeuronNet_bench -o bench.json --max-size 100000 --threads 4
+  \endverbatim
+  Network sizes are swept from 10^3 to \p max-size neurons and mean degrees from 10 to 1000,
+  configurations with more than \p max-links links are skipped.
+  Each benchmark is repeated until it has run for at least \p min-time seconds,
+  the result gives the time per call and per item (neuron, link or number drawn).
+  The *network_step_ranksR* cases time the steps of the network split between R processes (see RankGroup),
+  so that the scaling of --ranks can be read against *network_step_ranks1*.
+ */
+
+RandomNumbers *_RNG;
+
+namespace {
+
+typedef std::chrono::steady_clock bench_clock;
+
+class BenchReport {
+
+public:
+    BenchReport(std::ostream *_out, const double _t, const size_t _th) : out(_out), min_time(_t), threads(_th) {
+        static const char *simd[] = {"scalar", "avx2", "avx512"};
+        (*out) << "{\n  \"compiler\": \"" << __VERSION__ << "\",\n";
+#ifdef NDEBUG
+        (*out) << "  \"build\": \"release\",\n";
+#else
+        (*out) << "  \"build\": \"debug\",\n";
+#endif
+        (*out) << "  \"simd\": \"" << simd[NeuronPopulation::simd_level()] << "\",\n"
+               << "  \"threads\": " << threads << ",\n  \"results\": [";
+    }
+    ~BenchReport() {(*out) << "\n  ]\n}" << std::endl;}
+/*!
+  Times \p f, which processes \p items items per call, and writes a result line.
+ */
+    template<typename F>
+    void run(const std::string &name, const size_t neurons, const double degree, const size_t items, F f) {
+        f();
+        size_t calls = 0;
+        double elapsed = 0;
+        auto start = bench_clock::now();
+        do {
+            f();
+            calls++;
+            elapsed = std::chrono::duration<double>(bench_clock::now()-start).count();
+        } while (elapsed < min_time);
+        write(name, neurons, degree, items, calls, elapsed);
+    }
+/*!
+  Writes the result line of a benchmark timed by the caller: \p calls calls in \p elapsed seconds.
+ */
+    void write(const std::string &name, const size_t neurons, const double degree, const size_t items,
+               const size_t calls, const double elapsed) {
+        (*out) << (first ? "\n" : ",\n") << "    {\"benchmark\": \"" << name << "\", \"neurons\": " << neurons
+               << ", \"degree\": " << degree << ", \"calls\": " << calls << ", \"seconds\": " << elapsed
+               << ", \"ns_per_call\": " << 1e9*elapsed/calls
+               << ", \"ns_per_item\": " << 1e9*elapsed/(calls*std::max(items, (size_t)1)) << "}";
+        out->flush();
+        first = false;
+    }
+
+private:
+    std::ostream *out;
+    double min_time;
+    size_t threads;
+    bool first = true;
+
+};
+
+void bench_rng(BenchReport &rep, const size_t n) {
+    std::vector<double> vals(n);
+    std::vector<int> ivals(n);
+    rep.run("rng_uniform", n, 0, n, [&] () {_RNG->uniform_double(vals);});
+    rep.run("rng_normal", n, 0, n, [&] () {_RNG->normal(vals, 0, _THALAM_);});
+    rep.run("rng_poisson", n, 0, n, [&] () {_RNG->poisson(ivals, _DEGREE_);});
+    uint64_t t = 0;
+    rep.run("rng_normal_stream", n, 0, n, [&] () {
+            _RNG->normal(vals.data(), 0, n, t++, RandomNumbers::THALAMIC, 0, _THALAM_);});
+}
+
+void bench_population(BenchReport &rep, const size_t n) {
+    NeuronPopulation pop;
+    pop.resize(n);
+    std::vector<double> thal(n), exc(n, 0.0), inh(n, 0.0);
+    _RNG->normal(thal, 0, _THALAM_);
+// --- the typed kernels only run on noise-free neurons, such as those of resize
+    rep.run("population_step_typed", n, 0, n, [&] () {pop.step(thal.data(), exc.data(), inh.data());});
+    NeuronPopulation::set_type_kernels(false);
+    rep.run("population_step_generic", n, 0, n, [&] () {pop.step(thal.data(), exc.data(), inh.data());});
+    NeuronPopulation::set_type_kernels(true);
+// --- the neurons of a random network as in Network::set_default_params, with the noise which leaves them to the generic kernel
+    NeuronPopulation noisy;
+    noisy.resize(n);
+    std::vector<double> noise(n);
+    _RNG->uniform_double(noise);
+    const size_t nfs = _PROP_INHIB_*n+.5;
+    for (size_t k=0; k<n; k++) {
+        Neuron nrn = noisy.neuron(k);
+        nrn.set_default_params(k < nfs ? "FS" : "RS", noise[k]);
+        noisy.set(k, nrn);
+    }
+    noisy.classify();
+    rep.run("population_step_default", n, 0, n, [&] () {noisy.step(thal.data(), exc.data(), inh.data());});
+}
+
+void bench_network(BenchReport &rep, const size_t n, const double deg, const size_t threads) {
+    Network net;
+    net.resize(n, _PROP_INHIB_);
+    net.set_threads(threads);
+    size_t nlinks = 0;
+    rep.run("random_connect", n, deg, n*deg, [&] () {nlinks = net.random_connect(deg, _STRENG_);});
+    uint64_t t = 0;
+    SpikeList firing;
+    net.set_event_driven(true);
+    rep.run("network_step_push", n, deg, n, [&] () {net.step(_THALAM_, t++, firing);});
+    rep.run("network_step_push_set", n, deg, n, [&] () {net.step(_THALAM_, t++);});
+    net.set_event_driven(false);
+    rep.run("network_step_pull", n, deg, n, [&] () {net.step(_THALAM_, t++, firing);});
+    Network reordered(net);
+    rep.run("reorder_rcm", n, deg, nlinks, [&] () {
+            reordered = net;
+            reordered.reorder(reordered.locality_order("rcm"));});
+    reordered.set_event_driven(true);
+    rep.run("network_step_push_rcm", n, deg, n, [&] () {reordered.step(_THALAM_, t++, firing);});
+    reordered.set_event_driven(false);
+    rep.run("network_step_pull_rcm", n, deg, n, [&] () {reordered.step(_THALAM_, t++, firing);});
+    BasicNetwork<float> single(net);
+    single.set_event_driven(true);
+    rep.run("network_step_push_float", n, deg, n, [&] () {single.step(_THALAM_, t++, firing);});
+    single.set_event_driven(false);
+    rep.run("network_step_pull_float", n, deg, n, [&] () {single.step(_THALAM_, t++, firing);});
+    for (std::string format : {"u32-i8", "varint-i8"}) {
+        BasicNetwork<float> compact(net);
+        compact.set_compact(CompactSynapses::parse_format(format));
+        rep.run("network_step_compact_" + format, n, deg, n, [&] () {compact.step(_THALAM_, t++, firing);});
+    }
+    size_t sink = 0;
+    rep.run("degree", n, deg, n, [&] () {
+            for (size_t k=0; k<n; k++) sink += net.degree(k).first;});
+    rep.run("neighbors", n, deg, nlinks, [&] () {
+            for (size_t k=0; k<n; k++) sink += net.neighbors(k).size();});
+    std::map<std::string, size_t> ntypes{{"FS", (size_t)(_PROP_INHIB_*n+.5)}};
+    std::ostringstream trajstr;
+    rep.run("print_traj", n, deg, 1, [&] () {
+            trajstr.str("");
+            net.print_traj(t, ntypes, &trajstr);});
+    Recorder recorder(net, "types", ntypes);
+    std::vector<double> trajvals;
+    rep.run("recorder_values", n, deg, 1, [&] () {
+            trajvals.clear();
+            recorder.values(net, trajvals);});
+    if (sink == 0) std::cerr << "no links" << std::endl;
+}
+
+/*!
+  Time-steps of a network split between \p ranks processes (option --ranks of Simulation): 
+  each one steps its slice and the spikes are exchanged at every step. 
+  The ranks must run the same number of steps, so a fixed number of them is timed on rank 0 (the other ranks exit).
+ */
+void bench_ranks(BenchReport &rep, const size_t n, const double deg, const size_t threads, const int ranks) {
+    const int nsteps = 100;
+    RankGroup group(ranks);
+    try {
+        Network net;
+        net.resize(n, _PROP_INHIB_);
+        std::pair<size_t, size_t> own = group.slice(n);
+        net.set_slice(own.first, own.second);
+        net.set_threads(threads);
+        net.random_connect(deg, _STRENG_);
+        group.allocate(n);
+        std::vector<size_t> local, all;
+        local.reserve(n);
+        all.reserve(n);
+        SpikeList firing;
+        net.next_spikes(local);
+        group.exchange(local, all);
+        auto start = bench_clock::now();
+        for (int t=0; t<=nsteps; t++) {
+            if (t == 1) start = bench_clock::now();
+            net.step(_THALAM_, t, all, firing);
+            net.next_spikes(local);
+            group.exchange(local, all);
+        }
+        const double elapsed = std::chrono::duration<double>(bench_clock::now()-start).count();
+        if (group.rank() == 0) rep.write("network_step_ranks" + std::to_string(ranks), n, deg, n, nsteps, elapsed);
+        group.finish();
+    } catch (SimulError &e) {
+        if (group.rank() == 0) throw;
+        std::cerr << e.what() << std::endl;
+        std::_Exit(e.value());
+    }
+    if (group.rank()) std::_Exit(0);
+}
+
+}
+
+int main(int argc, char **argv) {
+    _RNG = new RandomNumbers(_BENCH_SEED_);
+    try {
+        TCLAP::CmdLine cmd(_BENCH_TEXT_);
+        TCLAP::ValueArg<std::string> outputArg("o", "output", _BOUTPUT_TEXT_, false, "", "string");
+        cmd.add(outputArg);
+        TCLAP::ValueArg<unsigned long> sizeArg("N", "max-size", _BSIZE_TEXT_, false, 1000000, "int");
+        cmd.add(sizeArg);
+        TCLAP::ValueArg<double> linksArg("", "max-links", _BLINKS_TEXT_, false, 2e7, "double");
+        cmd.add(linksArg);
+        TCLAP::ValueArg<double> timeArg("", "min-time", _BTIME_TEXT_, false, 0.2, "double");
+        cmd.add(timeArg);
+        TCLAP::ValueArg<int> threadsArg("", "threads", _THREADS_TEXT_, false, 1, "int");
+        cmd.add(threadsArg);
+        cmd.parse(argc, argv);
+
+        std::ofstream outf;
+        std::ostream *_outf = &std::cout;
+        if (outputArg.getValue().size()) {
+            outf.open(outputArg.getValue());
+            if (!outf.is_open()) throw(OUTPUT_ERROR("Cannot write to file " + outputArg.getValue()));
+            _outf = &outf;
+        }
+        size_t threads = std::max(threadsArg.getValue(), 1);
+        BenchReport rep(_outf, timeArg.getValue(), threads);
+        Neuron nrn;
+        nrn.set_default_params("RS");
+        nrn.input(_THALAM_);
+        rep.run("neuron_step", 1, 0, 1000, [&] () {
+                for (int k=0; k<1000; k++) {
+                    nrn.step();
+                    if (nrn.firing()) nrn.reset();
+                }});
+        for (size_t n=1000; n<=sizeArg.getValue(); n*=10) {
+            bench_rng(rep, n);
+            bench_population(rep, n);
+            for (double deg : {10., 100., 1000.})
+                if (deg < n && n*deg <= linksArg.getValue()) {
+                    bench_network(rep, n, deg, threads);
+                    for (int ranks : {1, 2, 4}) bench_ranks(rep, n, deg, threads, ranks);
+                }
+        }
+    } catch(TCLAP::ArgException &e) {
+        throw(TCLAP_ERROR("Error: " + e.error() + " " + e.argId()));
+    } catch (SimulError &e) {
+        std::cerr << e.what() << std::endl;
+        return e.value();
+    }
+    delete _RNG;
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include "checkpoint.h"
+#include <cstdio>
+
+CheckpointWriter::~CheckpointWriter() {
+    if (worker.joinable()) worker.join();
+}
+
+template<typename Real>
+void CheckpointWriter::save(const BasicNetwork<Real> &net, const Snapshot::RunState &rs, const OutputWriter *out) {
+    if (!ready()) {
+        num_skipped++;
+        return;
+    }
+// --- the previous thread has ended, joining it does not wait
+    finish();
+    std::shared_ptr<Snapshot> snap = std::make_shared<Snapshot>(net, rs, true);
+    const long time = rs.time;
+    running.store(true, std::memory_order_release);
+    worker = std::thread([this, snap, time, out] () {
+        try {
+            std::string tmpfile = filename + ".tmp";
+            snap->write(tmpfile);
+            while (out && out->ok() && out->synced_time() < time)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            if (out && !out->ok()) return;
+            if (std::rename(tmpfile.c_str(), filename.c_str()) != 0)
+                throw(OUTPUT_ERROR("Cannot write to file " + filename));
+        } catch (...) {
+            error = std::current_exception();
+        }
+        running.store(false, std::memory_order_release);
+    });
+    num_saved++;
+}
+
+template void CheckpointWriter::save(const BasicNetwork<double>&, const Snapshot::RunState&, const OutputWriter*);
+template void CheckpointWriter::save(const BasicNetwork<float>&, const Snapshot::RunState&, const OutputWriter*);
+
+void CheckpointWriter::finish() {
+    if (worker.joinable()) worker.join();
+    if (error) {
+        std::exception_ptr e = error;
+        error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
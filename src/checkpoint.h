@@ -0,0 +1,53 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "snapshot.h"
+#include "writer.h"
+#include <atomic>
+#include <thread>
+
+/*! \class CheckpointWriter
+  Writes periodic checkpoints of a running simulation (\ref Snapshot with its \ref Snapshot::RunState) without blocking it.
+
+  \ref save copies the dynamic variables of the network (O(neurons)) and returns,
+  the file is written by a background thread, to a temporary file renamed when complete,
+  so that the checkpoint file is always a complete snapshot even if the run is killed meanwhile.
+  The rename also waits for the \ref OutputWriter to have flushed the outputs up to the time-step of the checkpoint,
+  so that a resumed run finds them complete.
+  If a checkpoint is still being written when the next one is due (for instance because the outputs are late), 
+  the run does not wait for it: the new checkpoint is skipped (see \ref ready), the file keeps the previous one.
+ */
+
+class CheckpointWriter {
+
+public:
+    CheckpointWriter(const std::string &_file) : filename(_file) {}
+    ~CheckpointWriter();
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+/*!
+  Starts writing a checkpoint of \p net at run state \p rs, once \p out (if not null) has synced time-step \p rs.time.
+ */
+    template<typename Real>
+    void save(const BasicNetwork<Real> &net, const Snapshot::RunState &rs, const OutputWriter *out=nullptr);
+/*!
+  True if no checkpoint is being written, \ref save is then started at once, otherwise it is skipped.
+ */
+    bool ready() const {return !running.load(std::memory_order_acquire);}
+/*!
+  Waits for the checkpoint being written, re-throws its error if it failed.
+ */
+    void finish();
+    size_t count() const {return num_saved;}
+    size_t skipped() const {return num_skipped;}
+
+private:
+    std::string filename;
+    std::thread worker;
+    std::atomic<bool> running{false};
+    std::exception_ptr error;
+    size_t num_saved = 0, num_skipped = 0;
+
+};
+
+#endif //CHECKPOINT_H
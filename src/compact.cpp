@@ -0,0 +1,255 @@
+#include "compact.h"
+#include <cstring>
+
+namespace {
+
+/*
+  IEEE half precision: conversions with rounding to nearest even.
+ */
+uint16_t half_from_float(const float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, 4);
+    uint32_t sign = (x>>16) & 0x8000, mant = x & 0x7fffff;
+    int exp = (int)((x>>23) & 0xff) - 127 + 15;
+    if (((x>>23) & 0xff) == 0xff) return sign | 0x7c00 | (mant ? 0x200 : 0);
+    if (exp >= 31) return sign | 0x7c00;
+    if (exp <= 0) {
+        if (exp < -10) return sign;
+        mant |= 0x800000;
+        int shift = 14-exp;
+        uint32_t h = mant >> shift, rem = mant & ((1u<<shift)-1), halfway = 1u<<(shift-1);
+        if (rem > halfway || (rem == halfway && (h & 1))) h++;
+        return sign | h;
+    }
+    uint32_t h = sign | (exp<<10) | (mant>>13), rem = mant & 0x1fff;
+// --- a carry out of the mantissa correctly increments the exponent
+    if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) h++;
+    return h;
+}
+
+inline float float_from_half(const uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16, exp = (h>>10) & 0x1f, mant = h & 0x3ff, x;
+    if (exp == 31) x = sign | 0x7f800000 | (mant<<13);
+    else if (exp) x = sign | ((exp+127-15)<<23) | (mant<<13);
+    else if (!mant) x = sign;
+    else {
+        exp = 127-15+1;
+        while (!(mant & 0x400)) {
+            mant <<= 1;
+            exp--;
+        }
+        x = sign | (exp<<23) | ((mant & 0x3ff)<<13);
+    }
+    float f;
+    std::memcpy(&f, &x, 4);
+    return f;
+}
+
+/*
+  Decoders of one row: next() returns the next sending neuron, weight(i) the intensity of link i of the row.
+ */
+struct Index32 {
+    const uint32_t *p;
+    size_t next() {return *p++;}
+};
+
+struct IndexVarint {
+    const unsigned char *p;
+    size_t prev;
+    size_t next() {
+        size_t delta = 0;
+        for (int shift=0; ; shift+=7) {
+            unsigned char byte = *p++;
+            delta |= (size_t)(byte & 127) << shift;
+            if (byte < 128) break;
+        }
+        return prev += delta;
+    }
+};
+
+struct Weight32 {
+    const float *p;
+    float weight(const size_t i) const {return p[i];}
+};
+
+struct Weight16 {
+    const uint16_t *p;
+    float weight(const size_t i) const {return float_from_half(p[i]);}
+};
+
+struct Weight8 {
+    const int8_t *p;
+    float scale;
+    float weight(const size_t i) const {return p[i]*scale;}
+};
+
+template<typename T>
+void concat(ArrayStore<T> &to, ArrayStore<T> &from) {
+    size_t old = to.size();
+    to.resize(old+from.size());
+    std::copy(from.begin(), from.end(), to.begin()+old);
+    from.clear();
+}
+
+template<typename Real, class Idx, class Wgt, class MakeIdx, class MakeWgt>
+void pull_rows(const size_t *row_start, const size_t begin, const size_t end, const char *fired,
+               Real *exc, Real *inh, MakeIdx make_index, MakeWgt make_weight) {
+    for (size_t nn=begin; nn<end; nn++) {
+        Idx idx = make_index(nn);
+        Wgt wgt = make_weight(nn);
+        Real i_exc(0.0), i_inh(0.0);
+        for (size_t i=0, k=row_start[nn+1]-row_start[nn]; i<k; i++)
+            if (fired[idx.next()]) {
+                Real w = wgt.weight(i);
+                if (w<0) i_inh -= w;
+                else i_exc += w;
+            }
+        exc[nn] = i_exc;
+        inh[nn] = i_inh;
+    }
+}
+
+}
+
+CompactSynapses::Format CompactSynapses::parse_format(const std::string &name, const size_t n) {
+    size_t dash = name.find('-');
+    std::string idx = name.substr(0, dash), wgt = (dash == std::string::npos) ? "" : name.substr(dash+1);
+    Format f{INDEX32, INT8};
+    if (idx == "varint") f.index = VARINT;
+    else if (idx != "u32") throw(TCLAP_ERROR("Unknown synapse format " + name));
+    if (wgt == "f32") f.weight = FLOAT32;
+    else if (wgt == "f16") f.weight = FLOAT16;
+    else if (wgt != "i8") throw(TCLAP_ERROR("Unknown synapse format " + name));
+    if (!fits(f, n)) throw(TCLAP_ERROR("Synapse format " + name + " cannot index " + std::to_string(n) + " neurons"));
+    return f;
+}
+
+std::string CompactSynapses::format_name(const Format &f) {
+    static const char *wnames[] = {"f32", "f16", "i8"};
+    return std::string(f.index == VARINT ? "varint-" : "u32-") + wnames[f.weight];
+}
+
+template<typename Real>
+void CompactSynapses::encode(const BasicSynapseTable<Real> &syn) {
+    *this = CompactSynapses(format);
+    std::vector<double> w;
+    for (size_t n=0; n<syn.size(); n++) {
+        w.assign(syn.weight_data()+syn.row_begin(n), syn.weight_data()+syn.row_end(n));
+        add_row(syn.source_data()+syn.row_begin(n), w.data(), w.size());
+    }
+}
+
+template void CompactSynapses::encode(const BasicSynapseTable<double>&);
+template void CompactSynapses::encode(const BasicSynapseTable<float>&);
+
+void CompactSynapses::add_row(const size_t *src, const double *w, const size_t k) {
+    row_start.push_back(num_links()+k);
+    if (format.index == INDEX32)
+        for (size_t i=0; i<k; i++) index32.push_back(src[i]);
+    else {
+        size_t prev = 0;
+        for (size_t i=0; i<k; i++) {
+            size_t delta = src[i]-prev;
+            prev = src[i];
+            for (; delta >= 128; delta >>= 7) varints.push_back((delta & 127) | 128);
+            varints.push_back(delta);
+        }
+        index_start.push_back(varints.size());
+    }
+    float scale = 0;
+    if (format.weight == INT8) {
+        for (size_t i=0; i<k; i++) scale = std::max(scale, (float)std::abs(w[i]));
+        scale /= 127;
+        scales.push_back(scale);
+    }
+    for (size_t i=0; i<k; i++) {
+        float coded;
+        if (format.weight == FLOAT32) {
+            weight32.push_back(w[i]);
+            coded = w[i];
+        } else if (format.weight == FLOAT16) {
+            weight16.push_back(half_from_float(w[i]));
+            coded = float_from_half(weight16[weight16.size()-1]);
+        } else {
+            int q = scale > 0 ? (int)std::lround(w[i]/scale) : 0;
+            weight8.push_back(std::max(-127, std::min(127, q)));
+            coded = weight8[weight8.size()-1]*scale;
+        }
+        double err = std::abs(coded-w[i]);
+        err_max = std::max(err_max, err);
+        err_sq += err*err;
+    }
+}
+
+void CompactSynapses::append(CompactSynapses &part) {
+    size_t links = num_links(), bytes = varints.size();
+    for (size_t n=0; n<part.size(); n++) {
+        row_start.push_back(links+part.row_start[n+1]);
+        if (format.index == VARINT) index_start.push_back(bytes+part.index_start[n+1]);
+    }
+    concat(index32, part.index32);
+    concat(varints, part.varints);
+    concat(weight32, part.weight32);
+    concat(weight16, part.weight16);
+    concat(weight8, part.weight8);
+    concat(scales, part.scales);
+    err_max = std::max(err_max, part.err_max);
+    err_sq += part.err_sq;
+    part = CompactSynapses(format);
+}
+
+double CompactSynapses::weight(const size_t n, const size_t j) const {
+    if (format.weight == FLOAT32) return weight32[j];
+    if (format.weight == FLOAT16) return float_from_half(weight16[j]);
+    return weight8[j]*scales[n];
+}
+
+void CompactSynapses::row(const size_t n, std::vector<std::pair<size_t, double> > &links) const {
+    links.clear();
+    const size_t first = row_start[n], k = degree(n);
+    links.reserve(k);
+    if (format.index == INDEX32)
+        for (size_t i=0; i<k; i++) links.push_back({index32[first+i], weight(n, first+i)});
+    else {
+        IndexVarint ivar{varints.data()+index_start[n], 0};
+        for (size_t i=0; i<k; i++) links.push_back({ivar.next(), weight(n, first+i)});
+    }
+}
+
+double CompactSynapses::valence(const size_t n) const {
+// --- only the intensities are needed, the indices are not decoded
+    double val = 0;
+    for (size_t j=row_start[n]; j<row_start[n+1]; j++) val += weight(n, j);
+    return val;
+}
+
+template<typename Real>
+void CompactSynapses::pull(const size_t begin, const size_t end, const char *fired, Real *exc, Real *inh) const {
+    auto make32 = [this] (const size_t n) {return Index32{index32.data()+row_start[n]};};
+    auto makevar = [this] (const size_t n) {return IndexVarint{varints.data()+index_start[n], 0};};
+    auto makew32 = [this] (const size_t n) {return Weight32{weight32.data()+row_start[n]};};
+    auto makew16 = [this] (const size_t n) {return Weight16{weight16.data()+row_start[n]};};
+    auto makew8 = [this] (const size_t n) {return Weight8{weight8.data()+row_start[n], scales[n]};};
+    const size_t *rs = row_start.data();
+    if (format.index == INDEX32) {
+        if (format.weight == FLOAT32)
+            pull_rows<Real, Index32, Weight32>(rs, begin, end, fired, exc, inh, make32, makew32);
+        else if (format.weight == FLOAT16)
+            pull_rows<Real, Index32, Weight16>(rs, begin, end, fired, exc, inh, make32, makew16);
+        else pull_rows<Real, Index32, Weight8>(rs, begin, end, fired, exc, inh, make32, makew8);
+    } else {
+        if (format.weight == FLOAT32)
+            pull_rows<Real, IndexVarint, Weight32>(rs, begin, end, fired, exc, inh, makevar, makew32);
+        else if (format.weight == FLOAT16)
+            pull_rows<Real, IndexVarint, Weight16>(rs, begin, end, fired, exc, inh, makevar, makew16);
+        else pull_rows<Real, IndexVarint, Weight8>(rs, begin, end, fired, exc, inh, makevar, makew8);
+    }
+}
+
+template void CompactSynapses::pull(const size_t, const size_t, const char*, double*, double*) const;
+template void CompactSynapses::pull(const size_t, const size_t, const char*, float*, float*) const;
+
+size_t CompactSynapses::bytes() const {
+    return sizeof(size_t)*(row_start.size()+index_start.size()) + sizeof(uint32_t)*index32.size() + varints.size()
+        + sizeof(float)*(weight32.size()+scales.size()) + sizeof(uint16_t)*weight16.size() + weight8.size();
+}
@@ -0,0 +1,110 @@
+#ifndef COMPACT_H
+#define COMPACT_H
+
+#include "synapses.h"
+#include <cstdint>
+
+/*! \class CompactSynapses
+  A compressed, read-only version of the incoming links of a \ref SynapseTable, for networks too large
+  to hold a full table in memory (a \ref SynapseTable uses 32 bytes per link, counting the transposed table).
+
+  The rows are stored in the same order (by receiving neuron, increasing sending neurons),
+  each link is coded with an \ref IndexCoding and a \ref WeightCoding:
+  - INDEX32: sending neuron as a 32-bit integer (4 bytes),
+  - VARINT: difference from the previous sending neuron of the row, as a variable-length integer
+    (7 bits per byte, 1 or 2 bytes for a mean gap below 16384),
+  - FLOAT32: intensity in single precision (4 bytes),
+  - FLOAT16: intensity in half precision (2 bytes, relative error up to 2^-11),
+  - INT8: intensity as a multiple of a per-row scale (1 byte, absolute error up to the largest intensity of the row / 254).
+
+  The default format INDEX32 / INT8 takes 5 bytes per link plus 12 bytes per neuron, VARINT / INT8 about 2 or 3 plus 20 bytes per neuron.
+  There is no transposed table: \ref pull decodes the rows on the fly to compute the synaptic input (pull propagation).
+
+  The rows are appended with \ref add_row, the intensities are quantized at that time
+  and the quantization error is accumulated (\ref max_error, \ref rms_error).
+ */
+
+class CompactSynapses {
+
+public:
+    enum IndexCoding {INDEX32, VARINT};
+    enum WeightCoding {FLOAT32, FLOAT16, INT8};
+    struct Format {IndexCoding index; WeightCoding weight;};
+/*!
+  Format from its name *index-weight*, with index *u32* or *varint* and weight *f32*, *f16* or *i8* (for instance *u32-i8*).
+  Throws a TCLAP_ERROR for an unknown name, or for index *u32* when the \p n neurons cannot all be numbered on 32 bits.
+ */
+    static Format parse_format(const std::string&, const size_t n=0);
+/*! True if the sending neurons of a network of \p n neurons can be coded in format \p f. */
+    static bool fits(const Format &f, const size_t n) {return f.index != INDEX32 || n <= UINT32_MAX;}
+    static std::string format_name(const Format&);
+    CompactSynapses(const Format &f={INDEX32, INT8}) : format(f) {}
+/*!
+  Replaces the content by the links of table \p syn.
+ */
+    template<typename Real>
+    void encode(const BasicSynapseTable<Real> &syn);
+/*!
+  Appends a row of \p k links from sending neurons \p src (in increasing order) with intensities \p w.
+ */
+    void add_row(const size_t *src, const double *w, const size_t k);
+/*!
+  Appends all the rows of \p part, which must have the same format, and empties it.
+ */
+    void append(CompactSynapses &part);
+    const Format& get_format() const {return format;}
+    size_t size() const {return row_start.size()-1;}
+    size_t num_links() const {return row_start[size()];}
+    size_t degree(const size_t n) const {return row_start[n+1]-row_start[n];}
+    size_t row_begin(const size_t n) const {return row_start[n];}
+/*!
+  Decodes the row of neuron \p n as pairs {sending neuron, intensity}.
+ */
+    void row(const size_t n, std::vector<std::pair<size_t, double> > &links) const;
+/*!
+  Sum of the (decoded) intensities of the row of neuron \p n.
+ */
+    double valence(const size_t n) const;
+/*!
+  Synaptic input of neurons [\p begin, \p end) from the neurons flagged in \p fired,
+  computed as Network::pull_input: excitatory links are added to \p exc, inhibitory ones (negative intensity) subtracted from \p inh.
+ */
+    template<typename Real>
+    void pull(const size_t begin, const size_t end, const char *fired, Real *exc, Real *inh) const;
+/*! @name Size and accuracy
+  \ref bytes is the memory used by the arrays,
+  \ref max_error and \ref rms_error are the absolute errors of the coded intensities, over all links added.
+ */
+///@{
+    size_t bytes() const;
+    double max_error() const {return err_max;}
+    double rms_error() const {return num_links() ? std::sqrt(err_sq/num_links()) : 0;}
+///@}
+
+private:
+    Format format;
+/*! @name Rows
+  \ref row_start is the position of the first link of each row (as in a \ref SynapseTable),
+  \ref index_start the position of its first byte in \ref varints.
+ */
+///@{
+    ArrayStore<size_t> row_start{0}, index_start{0};
+///@}
+/*! @name Coded links
+  Only the arrays of the format are used: \ref index32 or \ref varints, and \ref weight32, \ref weight16 or \ref weight8
+  (with one \ref scales per row).
+ */
+///@{
+    ArrayStore<uint32_t> index32;
+    ArrayStore<unsigned char> varints;
+    ArrayStore<float> weight32, scales;
+    ArrayStore<uint16_t> weight16;
+    ArrayStore<int8_t> weight8;
+///@}
+/*! Decoded intensity of link \p j, which belongs to the row of neuron \p n. */
+    double weight(const size_t n, const size_t j) const;
+    double err_max = 0, err_sq = 0;
+
+};
+
+#endif //COMPACT_H
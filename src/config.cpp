@@ -0,0 +1,169 @@
+#include "config.h"
+#include "threadpool.h"
+#include <cctype>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t MIN_CHUNK_SIZE = 1<<16;
+
+size_t to_index(const char *s) {
+    char *end;
+    long x = strtol(s, &end, 10);
+    if (end == s) throw(std::invalid_argument(std::string("invalid index ") + s));
+    return x;
+}
+
+double to_double(const char *s) {
+    char *end;
+    double x = strtod(s, &end);
+    if (end == s) throw(std::invalid_argument(std::string("invalid value ") + s));
+    return x;
+}
+
+}
+
+ConfigReader::ConfigReader(const std::string &filename, const size_t nthreads) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) throw(CFILE_ERROR("Could not open configuration file " + filename));
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw(CFILE_ERROR("Could not open configuration file " + filename));
+    }
+    size_t fsize = st.st_size;
+    std::shared_ptr<void> mapping;
+    const char *base = "";
+    if (fsize) {
+        void *addr = mmap(nullptr, fsize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            throw(CFILE_ERROR("Could not map configuration file " + filename));
+        }
+        madvise(addr, fsize, MADV_SEQUENTIAL);
+        mapping.reset(addr, [fsize] (void *p) {munmap(p, fsize);});
+        base = static_cast<const char*>(addr);
+    }
+    close(fd);
+// --- chunk boundaries are moved forward to the beginning of a line
+    size_t nchunks = std::max((size_t)1, std::min(4*nthreads, fsize/MIN_CHUNK_SIZE));
+    if (nthreads < 2) nchunks = 1;
+    std::vector<const char*> bounds(1, base);
+    for (size_t c=1; c<nchunks; c++) {
+        const char *b = std::max(bounds.back(), base+c*fsize/nchunks);
+        if (b > base && b < base+fsize && b[-1] != '\n') {
+            b = static_cast<const char*>(memchr(b, '\n', base+fsize-b));
+            b = b ? b+1 : base+fsize;
+        }
+        if (b > bounds.back() && b < base+fsize) bounds.push_back(b);
+    }
+    bounds.push_back(base+fsize);
+    std::vector<Part> parts(bounds.size()-1);
+    auto task = [&] (size_t c) {parse(bounds[c], bounds[c+1], parts[c]);};
+    if (parts.size() > 1) ThreadPool(nthreads).run(parts.size(), task);
+    else task(0);
+    std::vector<size_t> index;
+    for (auto &P : parts) {
+        if (P.error.size()) throw(CFILE_ERROR("Error with configuration file " + filename + ": " + P.error));
+        index.insert(index.end(), P.index.begin(), P.index.end());
+        append(P);
+    }
+    remap(index);
+}
+
+void ConfigReader::parse(const char *p, const char *end, Part &part) {
+    std::string line;
+    try {
+        while (p < end) {
+            const char *eol = static_cast<const char*>(memchr(p, '\n', end-p));
+            if (!eol) eol = end;
+// --- this removes all spaces from the line
+            line.clear();
+            for (; p<eol; p++) if (!isspace((unsigned char)*p)) line.push_back(*p);
+            p = eol+1;
+// --- comment lines start with #
+            if (line.empty() || line[0] == '#') continue;
+            parse_line(line, part);
+        }
+    } catch(std::exception &e) {
+        part.error = e.what();
+    }
+}
+
+void ConfigReader::parse_line(const std::string &line, Part &part) {
+    const char *s = line.c_str(), *e = s+line.size();
+    const char *item_end = std::find(s, e, ';');
+    if (item_end-s >= 4 && strncasecmp(s, "link", 4) == 0) {
+        while (item_end < e) {
+            s = item_end+1;
+            item_end = std::find(s, e, ';');
+            if (s == item_end) continue;
+            const char *comma = std::find(s, item_end, ','), *colon = std::find(s, item_end, ':');
+            if (comma == item_end || colon == item_end)
+                throw(std::invalid_argument("invalid link " + std::string(s, item_end)));
+// --- optional delay after a second colon
+            const char *colon2 = std::find(colon+1, item_end, ':');
+            long delay = (colon2 == item_end) ? 1 : to_index(colon2+1);
+            if (delay < 1 || delay > _MAX_DELAY_)
+                throw(std::invalid_argument("invalid link delay " + std::string(s, item_end)));
+            part.links.push_back({to_index(s), to_index(comma+1), to_double(colon+1), (int)delay});
+        }
+        return;
+    }
+    part.index.push_back(to_index(s));
+    s = std::min(item_end+1, e);
+    item_end = std::find(s, e, ';');
+    part.types.push_back(std::string(s, item_end));
+    NeuronParams nparams = Neuron::type_default(part.types.back());
+    double poten = _REST_VAL_;
+    while (item_end < e) {
+        s = item_end+1;
+        item_end = std::find(s, e, ';');
+        if (s == item_end) continue;
+        const char *eq = std::find(s, item_end, '=');
+        if (eq == item_end) throw(std::invalid_argument("invalid parameter " + std::string(s, item_end)));
+        double value = to_double(eq+1);
+        char key = (eq > s) ? tolower(*s) : 0;
+        if      (key == 'a') nparams.a = value;
+        else if (key == 'b') nparams.b = value;
+        else if (key == 'c') nparams.c = value;
+        else if (key == 'd') nparams.d = value;
+        else if (key == 'i') nparams.inhib = (value>0);
+        else if (key == 'v') poten = value;
+    }
+    part.params.push_back(nparams);
+    part.poten.push_back(poten);
+}
+
+void ConfigReader::append(Part &P) {
+    std::move(P.types.begin(), P.types.end(), std::back_inserter(neuron_types));
+    neuron_params.insert(neuron_params.end(), P.params.begin(), P.params.end());
+    neuron_poten.insert(neuron_poten.end(), P.poten.begin(), P.poten.end());
+    link_list.insert(link_list.end(), P.links.begin(), P.links.end());
+    P = Part();
+}
+
+void ConfigReader::remap(const std::vector<size_t> &index) {
+    size_t n = size();
+    bool identity = true;
+    for (size_t k=0; k<n && identity; k++) identity = (index[k] == k);
+    if (identity) return;
+// --- sorted (file index, position) pairs, a repeated file index refers to its last neuron
+    std::vector<std::pair<size_t, size_t> > pos(n);
+    for (size_t k=0; k<n; k++) pos[k] = {index[k], k};
+    std::sort(pos.begin(), pos.end());
+    auto position = [&] (const size_t i) {
+        auto I = std::upper_bound(pos.begin(), pos.end(), std::make_pair(i, n));
+        return (I != pos.begin() && (--I)->first == i) ? I->second : n;
+    };
+    for (auto &e : link_list) {
+        e.target = position(e.target);
+        e.source = position(e.source);
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "neuron.h"
+#include "synapses.h"
+
+/*! \class ConfigReader
+  Reads a network configuration file (format described in Simulation::load_configuration).
+
+  The file is memory-mapped and parsed in place: each line is stripped of its white spaces into a reused buffer
+  and its numbers are converted with strtol and strtod, without streams or temporary strings.
+  With several threads, the file is split at line boundaries into chunks parsed in parallel 
+  and the results are concatenated in the order of the file, so they do not depend on the number of threads.
+
+  Neurons are numbered by their order in the file. The links are collected in a flat \ref edgelist 
+  whose neuron indices are translated from the indices given in the file to these positions
+  (links to indices which are not defined in the file are given an invalid index \ref size).
+ */
+
+class ConfigReader {
+
+public:
+/*!
+  Parses file \p filename with \p nthreads threads, throws a CFILE_ERROR if the file cannot be read or has a syntax error.
+ */
+    ConfigReader(const std::string &filename, const size_t nthreads=1);
+/*! @name Getters
+  Number of neurons, their types (as written in the file), parameters and initial membrane potentials, and the links.
+ */
+///@{
+    size_t size() const {return neuron_types.size();}
+    const std::vector<std::string>& types() const {return neuron_types;}
+    const std::vector<NeuronParams>& params() const {return neuron_params;}
+    const std::vector<double>& potentials() const {return neuron_poten;}
+    edgelist& links() {return link_list;}
+///@}
+
+private:
+/*!
+  Content of a part of the file, with the indices of neurons and links as written in the file.
+ */
+    struct Part {
+        std::vector<size_t> index;
+        std::vector<std::string> types;
+        std::vector<NeuronParams> params;
+        std::vector<double> poten;
+        edgelist links;
+        std::string error;
+    };
+    static void parse(const char*, const char*, Part&);
+    static void parse_line(const std::string&, Part&);
+    void append(Part&);
+    void remap(const std::vector<size_t>&);
+
+    std::vector<std::string> neuron_types;
+    std::vector<NeuronParams> neuron_params;
+    std::vector<double> neuron_poten;
+    edgelist link_list;
+
+};
+
+#endif //CONFIG_H
@@ -12,6 +12,7 @@
 #include <map>
 #include <string>
 #include <cmath>
+#include <cstdint>
 
 class SimulError : public std::runtime_error {
 
@@ -33,6 +34,7 @@ protected:
 _SIMULERR_(TCLAP_ERROR, 10)
 _SIMULERR_(OUTPUT_ERROR, 20)
 _SIMULERR_(CFILE_ERROR, 30)
+_SIMULERR_(RANK_ERROR, 40)
 
 #undef _SIMULERR_
 
@@ -50,6 +52,12 @@ _SIMULERR_(CFILE_ERROR, 30)
 #define _BVAR_ .25
 #define _CVAR_ 0.2307692
 #define _DVAR_ .75
+#define _QUEUE_SIZE_ 64
+#define _CKPT_EVERY_ 10000
+#define _MAX_DELAY_ 255
+#define _STATS_WINDOW_ 100
+#define _ISI_BINS_ 1000
+#define _TRAJ_BLOCK_ 1024
 
 /// * text messages *
 #define _PRGRM_TEXT_ "Simulation of the Izhikevich neuron model"
@@ -62,5 +70,33 @@ _SIMULERR_(CFILE_ERROR, 30)
 #define _TYPES_TEXT_ "Proportions of each type of neurons as a list like 'IB:0.4,CH:0.35'. If total is less than 1, it will be completed with RS neurons"
 #define _OUTPUT_TEXT_ "Output file name (default is output to screen)"
 #define _CFILE_TEXT_ "Configuration file name"
+#define _THREADS_TEXT_ "Number of threads used for the time-steps"
+#define _SEED_TEXT_ "Seed of the random number generator (default is random)"
+#define _RFORMAT_TEXT_ "Format of the raster output: 'text' (one line per time-step), 'aer' (binary spike events, see NeuronNet_aer2txt) or 'none' (no raster, e.g. with --stats)"
+#define _SAVE_TEXT_ "Save the constructed network to a binary snapshot file"
+#define _LOAD_TEXT_ "Load the network from a binary snapshot file (see --save-network) instead of constructing it"
+#define _PROFILE_TEXT_ "Write a JSON report of the time spent in each phase of the run (to the file <output>_profile.json, or to the error stream)"
+#define _CHECKPOINT_TEXT_ "Checkpoint file, written periodically during the run (see --checkpoint-every and --resume)"
+#define _CKEVERY_TEXT_ "Number of time-steps between two checkpoints"
+#define _RESUME_TEXT_ "Resume the run saved in a checkpoint file: the outputs are continued after the time-step of the checkpoint"
+#define _TRIALS_TEXT_ "Number of independent trials of the same network, with seeds <seed>, <seed>+1, ...: the raster of trial k is written to <output>_trial<k>"
+#define _DELAY_TEXT_ "Maximal delay of the random links in time-steps: each link gets a delay drawn uniformly between 1 and this value"
+#define _COMPACT_TEXT_ "Keep the links in compact form during the run (pull propagation): 'u32' or 'varint' sending neuron indices with 'f32', 'f16' or 'i8' intensities, e.g. 'u32-i8' (5 bytes per link); the size and quantization error are reported on the standard error"
+#define _PRECISION_TEXT_ "Floating-point precision of the neuron state and link intensities during the run: 'double' or 'float' (half the memory traffic, slightly different trajectories)"
+#define _STATS_TEXT_ "Write statistics of the activity (rates, inter-spike intervals, rate series and synchrony per neuron type) computed during the run, to the file <output>_stats.json or to the error stream (not with --resume)"
+#define _SWINDOW_TEXT_ "Number of time-steps of the windows of the population rate series (see --stats)"
+#define _TRAJN_TEXT_ "Neurons whose trajectories are recorded: 'types' (one per neuron type), 'random:K' (K neurons drawn at random) or a list of indices such as '0,15,200'"
+#define _TRAJE_TEXT_ "Record the trajectories every this number of time-steps"
+#define _REORDER_TEXT_ "Renumber the neurons for memory locality before the run: 'type' (grouped by type) or 'rcm' (reverse Cuthill-McKee order of the links), the outputs keep the original indices"
+#define _RANKS_TEXT_ "Number of local processes which share the run, each one simulating a slice of the neurons (not with trials, checkpoints or reordering)"
+#define _TFORMAT_TEXT_ "Format of the trajectory output: 'text' (one line per recorded time-step) or 'binary' (blocks of columns of doubles, see Recorder)"
+#define _PULL_TEXT_ "Compute synaptic input by scanning all incoming links instead of propagating spikes along outgoing links"
+
+#define _BENCH_SEED_ 20200501
+#define _BENCH_TEXT_ "Micro-benchmarks of NeuronNet, results are written as JSON"
+#define _BOUTPUT_TEXT_ "Output file name for the JSON results (default is output to screen)"
+#define _BSIZE_TEXT_ "Largest network size, sizes are swept from 1000 by factors of 10"
+#define _BLINKS_TEXT_ "Largest number of links, larger networks are skipped"
+#define _BTIME_TEXT_ "Minimum duration of each benchmark in seconds"
 
 #endif //GLOBALS_H
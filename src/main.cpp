@@ -18,6 +18,33 @@
  - test1000_traj: one representative time trajectory for each neuron type,
  - test1000_pars: all neuron parameters.
 
+  With `--raster-format=aer`, the raster file only contains the spike events in a compact binary format (see AerWriter), 
+  it can be converted to the text raster with `NeuronNet_aer2txt test1000 test1000.txt`.
+
+  With `--trials 8 --seed 5`, eight trials of the same network with the seeds 5 to 12 are run together (see TrialBatch), 
+  their rasters are written to test1000_trial0 ... test1000_trial7.
+
+  With `--stats --raster-format=none`, no raster is written: the firing rates, inter-spike interval histograms, 
+  population rate series and synchrony of each neuron type are computed during the run and written to test1000_stats.json 
+  (see PopulationStats).
+
+  With `--traj-neurons random:50 --traj-every 10 --traj-format binary`, the trajectories of 50 random neurons are recorded 
+  every 10 time-steps in test1000_traj, in blocks of columns of doubles (see Recorder).
+
+  With `--reorder rcm`, the neurons are renumbered so that linked neurons are close in memory (see Network::reorder), 
+  the raster, trajectories and parameters are still written with the original indices.
+  With `--ranks 4`, the run is shared by 4 processes which each simulate a quarter of the neurons and exchange their spikes 
+  at every time-step (see RankGroup), the outputs are the same as with a single process. 
+  Comparing the *steps_per_second* of `--profile` with `--ranks 1`, `2` and `4` shows how the run scales 
+  (the spike and synaptic event counts of the report are the totals of all ranks), 
+  the *network_step_ranks* cases of `NeuronNet_bench` measure it for a range of network sizes.
+
+  With `--compact-synapses u32-i8`, a network of several hundred million links fits in memory: 
+  the links take 5 bytes each instead of 32 (see CompactSynapses), at the price of a quantization error which is printed.
+
+  The performance of the main operations can be measured with `NeuronNet_bench -o bench.json` (see bench.cpp), 
+  which writes its results as JSON so that builds can be compared.
+
  */
 
 RandomNumbers *_RNG;
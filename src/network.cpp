@@ -1,212 +1,780 @@
 #include "network.h"
 #include "random.h"
+#include <numeric>
 
-void Network::resize(const size_t &n, double inhib) {
+template<typename Real> template<typename Other>
+BasicNetwork<Real>::BasicNetwork(const BasicNetwork<Other> &other) 
+    : compact(other.compact), event_driven(other.event_driven), 
+      slice_first(other.slice_first), slice_last(other.slice_last) {
+    other.index_links();
+    neurons = BasicNeuronPopulation<Real>(other.neurons);
+    synapses = BasicSynapseTable<Real>(other.synapses);
+    set_threads(other.num_threads());
+    init_buffers();
+// --- the input in transit through delayed links
+    ring_slots = other.ring_slots;
+    ring_pos = other.ring_pos;
+    exc_input.assign(other.exc_input.begin(), other.exc_input.end());
+    inh_input.assign(other.inh_input.begin(), other.inh_input.end());
+    external_ids = other.external_ids;
+    internal_ids = other.internal_ids;
+}
+
+template<typename Real>
+BasicNetwork<Real>& BasicNetwork<Real>::operator=(const BasicNetwork &other) {
+    if (this == &other) return *this;
+    neurons = other.neurons;
+    links = other.links;
+    synapses = other.synapses;
+    compact = other.compact;
+    exc_input = other.exc_input;
+    inh_input = other.inh_input;
+    thal_noise = other.thal_noise;
+    external_noise = other.external_noise;
+    fired = other.fired;
+    ring_slots = other.ring_slots;
+    ring_pos = other.ring_pos;
+    event_driven = other.event_driven;
+    external_ids = other.external_ids;
+    internal_ids = other.internal_ids;
+    slice_first = other.slice_first;
+    slice_last = other.slice_last;
+    in_degrees = other.in_degrees;
+    out_degrees = other.out_degrees;
+    valences = other.valences;
+    exc_valences = other.exc_valences;
+    inh_valences = other.inh_valences;
+    summarized = other.summarized;
+// --- a new pool, partitioned again at the next step
+    profiler = nullptr;
+    set_threads(other.num_threads());
+    return *this;
+}
+
+template<typename Real>
+void BasicNetwork<Real>::resize(const size_t &n, double inhib) {
     size_t old = size();
     neurons.resize(n);
+    init_buffers();
+    if (is_reordered()) {
+// --- new neurons keep their index, the external indices of the remaining neurons stay in the same order
+        std::vector<size_t> kept(std::min(n, old));
+        std::iota(kept.begin(), kept.end(), 0);
+        std::sort(kept.begin(), kept.end(), [this] (const size_t i, const size_t j) {return external_ids[i] < external_ids[j];});
+        external_ids.resize(n);
+        internal_ids.resize(n);
+        for (size_t e=0; e<n; e++) {
+            const size_t k = (e < kept.size()) ? kept[e] : e;
+            external_ids[k] = e;
+            internal_ids[e] = k;
+        }
+    }
+    if (compact) {
+        if (!CompactSynapses::fits(compact->get_format(), n))
+            throw(TCLAP_ERROR("Synapse format " + CompactSynapses::format_name(compact->get_format()) + " cannot index " + std::to_string(n) + " neurons"));
+// --- new neurons have no links, shrinking a compact network drops all links
+        if (n < compact->size()) compact = std::make_shared<CompactSynapses>(compact->get_format());
+        for (size_t k=compact->size(); k<n; k++) compact->add_row(nullptr, nullptr, 0);
+    }
     if (n <= old) return;
     size_t nfs(inhib*(n-old)+.5);
     set_default_params({{"FS", nfs}}, old);
 }
 
-void Network::set_default_params(const std::map<std::string, size_t> &types,
-                                 const size_t start) {
+template<typename Real>
+void BasicNetwork<Real>::init_buffers() {
+    exc_input.assign(ring_slots*size(), 0.0);
+    inh_input.assign(ring_slots*size(), 0.0);
+    fired.assign(size(), 0);
+    partitioned = false;
+    summarized = false;
+}
+
+template<typename Real>
+void BasicNetwork<Real>::set_default_params(const std::map<std::string, size_t> &types,
+                                            const size_t start) {
     size_t k(0), ssize(size()-start), kmax(0);
     std::vector<double> noise(ssize);
     _RNG->uniform_double(noise);
+    Neuron nrn;
     for (auto I : types) 
         if (Neuron::type_exists(I.first)) 
-            for (kmax+=I.second; k<kmax && k<ssize; k++) 
-                neurons[start+k].set_default_params(I.first, noise[k]);
-    for (; k<ssize; k++) neurons[start+k].set_default_params("RS", noise[k]);
+            for (kmax+=I.second; k<kmax && k<ssize; k++) {
+                nrn = neurons.neuron(start+k);
+                nrn.set_default_params(I.first, noise[k]);
+                neurons.set(start+k, nrn);
+            }
+    for (; k<ssize; k++) {
+        nrn = neurons.neuron(start+k);
+        nrn.set_default_params("RS", noise[k]);
+        neurons.set(start+k, nrn);
+    }
 }
 
-void Network::set_types_params(const std::vector<std::string> &_types,
-                               const std::vector<NeuronParams> &_par,
-                               const size_t start) {
+template<typename Real>
+void BasicNetwork<Real>::set_types_params(const std::vector<std::string> &_types,
+                                          const std::vector<NeuronParams> &_par,
+                                          const size_t start) {
     for (size_t k=0; k<_par.size(); k++) {
-        neurons[start+k].set_type(_types[k]);
-        neurons[start+k].set_params(_par[k]);
+        Neuron nrn = neurons.neuron(start+k);
+        nrn.set_type(_types[k]);
+        nrn.set_params(_par[k]);
+        neurons.set(start+k, nrn);
     }
 }
 
-void Network::set_values(const std::vector<double> &_poten, const size_t start) {
+template<typename Real>
+void BasicNetwork<Real>::set_values(const std::vector<double> &_poten, const size_t start) {
     for (size_t k=0; k<_poten.size(); k++) 
-        neurons[start+k].potential(_poten[k]);
+        neurons.potential(start+k, _poten[k]);
 }
 
-bool Network::add_link(const size_t &a, const size_t &b, double str) {
-    if (a==b || a>=size() || b>=size() || str<1e-6) return false;
-    if (links.count({a,b})) return false;
-    if (neurons[b].is_inhibitory()) str *= -2.0;
+template<typename Real>
+bool BasicNetwork<Real>::add_link(const size_t &a, const size_t &b, double str) {
+    if (compact || a==b || a>=size() || b>=size() || str<1e-6 || !owns(a)) return false;
+    if (links.count({a,b}) || synapses.contains(a,b)) return false;
+    if (neurons.is_inhibitory(b)) str *= -2.0;
     links.insert({{a,b}, str});
     return true;
 }
 
-size_t Network::random_connect(const double &mean_deg, const double &mean_streng) {
+template<typename Real>
+size_t BasicNetwork<Real>::set_links(edgelist &el) {
+    el.erase(std::remove_if(el.begin(), el.end(), [this] (const Synapse &e) {
+                return e.target==e.source || e.target>=size() || e.source>=size() || e.weight<1e-6 || !owns(e.target);}),
+             el.end());
+    for (auto &e : el) if (neurons.is_inhibitory(e.source)) e.weight *= -2.0;
+    links.clear();
+    synapses.build(size(), el);
+    partitioned = false;
+    summarized = false;
+    if (!compact) return synapses.num_links();
+    set_compact(compact->get_format());
+    return compact->num_links();
+}
+
+template<typename Real>
+void BasicNetwork<Real>::set_compact(const CompactSynapses::Format &f) {
+    index_links();
+    if (synapses.max_delay() > 1) throw(TCLAP_ERROR("Compact links have no delays"));
+    if (!CompactSynapses::fits(f, size()))
+        throw(TCLAP_ERROR("Synapse format " + CompactSynapses::format_name(f) + " cannot index " + std::to_string(size()) + " neurons"));
+    std::shared_ptr<CompactSynapses> coded = std::make_shared<CompactSynapses>(f);
+    if (compact && synapses.size() != size()) {
+// --- recoding: go through a full table
+        for (size_t n=0; n<compact->size(); n++) {
+            std::vector<std::pair<size_t, double> > row;
+            compact->row(n, row);
+            std::vector<size_t> src;
+            std::vector<double> w;
+            for (auto &l : row) {
+                src.push_back(l.first);
+                w.push_back(l.second);
+            }
+            coded->add_row(src.data(), w.data(), src.size());
+        }
+    } else coded->encode(synapses);
+    compact = coded;
+    synapses = BasicSynapseTable<Real>();
+    partitioned = false;
+    summarized = false;
+}
+
+template<typename Real>
+size_t BasicNetwork<Real>::random_connect(const double &mean_deg, const double &mean_streng, const int max_delay) {
+    if (compact && max_delay > 1) throw(TCLAP_ERROR("Compact links have no delays"));
+    links.clear();
+    const size_t n = size(), nchunks = pool ? 4*pool->size() : 1;
+// --- all draws are indexed by this key and by neuron or link position, whatever the number of threads
+    const uint64_t key = (*_RNG)();
+    std::vector<int> degrees(n);
+    std::function<void(size_t)> draw_degrees = [&](size_t c) {
+        size_t begin = c*n/nchunks, end = (c+1)*n/nchunks;
+        if (end == begin) return;
+        _RNG->poisson(degrees.data()+begin, begin, end-begin, key, RandomNumbers::DEGREE, mean_deg);
+        for (size_t a=begin; a<end; a++) degrees[a] = std::min(degrees[a], (int)n-1);
+    };
+// --- Floyd's algorithm: k distinct sending neurons among the n-1 others with k uniform draws
+// --- in compact mode, each chunk codes its rows in its own part, the parts are then concatenated
+    std::vector<size_t> row_first;
+    std::vector<CompactSynapses> parts;
+    std::function<void(size_t)> draw_links = [&](size_t c) {
+        size_t begin = c*n/nchunks, end = (c+1)*n/nchunks;
+        std::vector<char> chosen(n, 0);
+        std::vector<double> u, wbuf;
+        std::vector<size_t> sbuf;
+        for (size_t a=begin; a<end; a++) {
+            size_t k = compact ? degrees[a] : synapses.degree(a), first = row_first[a], pos = compact ? 0 : synapses.row_begin(a);
+            if (compact) {
+                sbuf.resize(k);
+                wbuf.resize(k);
+            }
+            size_t *src = compact ? sbuf.data() : synapses.source_data()+pos;
+            Real *w = compact ? nullptr : synapses.weight_data()+pos;
+            u.resize(k);
+            _RNG->uniform_double(u.data(), first, k, key, RandomNumbers::CONNECT);
+            for (size_t i=0, j=n-1-k; i<k; i++, j++) {
+                size_t t = std::min((size_t)(u[i]*(j+1)), j);
+                if (chosen[t]) t = j;
+                chosen[t] = 1;
+                src[i] = t;
+            }
+            for (size_t i=0; i<k; i++) {
+                chosen[src[i]] = 0;
+                if (src[i] >= a) src[i]++;
+            }
+            std::sort(src, src+k);
+            if (compact) {
+                _RNG->uniform_double(wbuf.data(), first, k, key, RandomNumbers::STRENGTH, 1e-6, 2*mean_streng);
+                for (size_t i=0; i<k; i++)
+                    if (neurons.is_inhibitory(src[i])) wbuf[i] *= -2.0;
+                parts[c].add_row(src, wbuf.data(), k);
+                continue;
+            }
+            _RNG->uniform_double(w, first, k, key, RandomNumbers::STRENGTH, 1e-6, 2*mean_streng);
+            for (size_t i=0; i<k; i++)
+                if (neurons.is_inhibitory(src[i])) w[i] *= -2.0;
+            if (max_delay < 2) continue;
+            uint8_t *dl = synapses.delay_data()+pos;
+            _RNG->uniform_double(u.data(), first, k, key, RandomNumbers::DELAY, 0, max_delay);
+            for (size_t i=0; i<k; i++) dl[i] = 1+std::min((int)u[i], max_delay-1);
+        }
+    };
+    if (pool) pool->run(nchunks, draw_degrees);
+    else draw_degrees(0);
+    partitioned = false;
+    summarized = false;
+// --- the draws of a link are indexed by its position in the whole network, a slice only keeps its rows
+    row_first.assign(n+1, 0);
+    for (size_t a=0; a<n; a++) row_first[a+1] = row_first[a]+degrees[a];
+    for (size_t a=0; a<n; a++) 
+        if (!owns(a)) degrees[a] = 0;
+    if (compact) {
+        parts.assign(nchunks, CompactSynapses(compact->get_format()));
+        if (pool) pool->run(nchunks, draw_links);
+        else draw_links(0);
+        compact = std::make_shared<CompactSynapses>(compact->get_format());
+        for (auto &part : parts) compact->append(part);
+        return compact->num_links();
+    }
+    synapses.allocate(degrees, max_delay > 1);
+    if (pool) pool->run(nchunks, draw_links);
+    else draw_links(0);
+    synapses.index_outgoing();
+    return synapses.num_links();
+}
+
+template<typename Real>
+void BasicNetwork<Real>::index_links() const {
+    if (compact) return;
+    if (links.empty() && synapses.size()==size()) return;
+    synapses.merge(size(), links);
     links.clear();
-    std::vector<int> degrees(size());
-    _RNG->poisson(degrees, mean_deg);
-    size_t num_links = 0;
-    std::vector<size_t> nodeidx(size());
-    std::iota(nodeidx.begin(), nodeidx.end(), 0);
-    for (size_t node=0; node<size(); node++) {
-        _RNG->shuffle(nodeidx);
-        std::vector<double> strength(degrees[node]);
-        _RNG->uniform_double(strength, 1e-6, 2*mean_streng);
-        int nl = 0;
-        for (size_t nn=0; nn<size() && nl<degrees[node]; nn++)
-            if (add_link(node, nodeidx[nn], strength[nl])) nl++;
-        num_links += nl;
-    }
-    return num_links;
-}
-
-std::vector<double> Network::potentials() const {
+    partitioned = false;
+    summarized = false;
+}
+
+template<typename Real>
+void BasicNetwork<Real>::reorder(const std::vector<size_t> &order) {
+    if (compact) throw(TCLAP_ERROR("Compact links cannot be reordered"));
+    if (is_sliced()) throw(TCLAP_ERROR("A sliced network cannot be reordered"));
+    const size_t n = size();
+    std::vector<size_t> position(n, n);
+    for (size_t k=0; k<order.size() && k<n; k++) 
+        if (order[k] < n) position[order[k]] = k;
+    if (order.size() != n || std::count(position.begin(), position.end(), n))
+        throw(TCLAP_ERROR("The order of the neurons is not a permutation"));
+    index_links();
+// --- the links are relabeled in an edge list, then indexed again with sorted rows
+    edgelist el;
+    el.reserve(synapses.num_links());
+    for (size_t a=0; a<n; a++)
+        for (size_t k=synapses.row_begin(a); k<synapses.row_end(a); k++)
+            el.push_back({position[a], position[synapses.source(k)], (double)synapses.weight(k), synapses.delay(k)});
+    synapses.build(n, el);
+    neurons.permute(order);
+    for (auto ring : {&exc_input, &inh_input}) {
+        std::vector<Real> moved(ring->size());
+        for (size_t j=0; j+n<=ring->size(); j+=n)
+            for (size_t k=0; k<n; k++) moved[j+k] = (*ring)[j+order[k]];
+        ring->swap(moved);
+    }
+    ArrayStore<size_t> ext(n, 0);
+    internal_ids.resize(n);
+    for (size_t k=0; k<n; k++) {
+        ext[k] = external(order[k]);
+        internal_ids[ext[k]] = k;
+    }
+    external_ids.swap(ext);
+    partitioned = false;
+    summarized = false;
+}
+
+template<typename Real>
+std::vector<size_t> BasicNetwork<Real>::locality_order(const std::string &m) const {
+    const size_t n = size();
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    if (m == "type") {
+        std::stable_sort(order.begin(), order.end(), [this] (const size_t i, const size_t j) {return type(i) < type(j);});
+        return order;
+    }
+    if (m != "rcm") throw(TCLAP_ERROR("Unknown order of the neurons: " + m));
+    if (compact) throw(TCLAP_ERROR("Compact links cannot be reordered"));
+    index_links();
+    std::vector<size_t> deg(n);
+    for (size_t a=0; a<n; a++) deg[a] = synapses.degree(a) + synapses.out_degree(a);
+    auto by_degree = [&deg] (const size_t i, const size_t j) {return deg[i] < deg[j];};
+    std::vector<size_t> starts(order);
+    std::stable_sort(starts.begin(), starts.end(), by_degree);
+// --- breadth-first search from the unvisited neuron of lowest degree, 
+// --- the neighbors of each neuron are queued by increasing degree
+    std::vector<char> visited(n, 0);
+    std::vector<size_t> next;
+    const size_t *src = synapses.source_data(), *tgt = synapses.target_data();
+    order.clear();
+    for (auto s : starts) {
+        if (visited[s]) continue;
+        visited[s] = 1;
+        order.push_back(s);
+        for (size_t head=order.size()-1; head<order.size(); head++) {
+            const size_t a = order[head];
+            next.clear();
+            for (size_t k=synapses.row_begin(a); k<synapses.row_end(a); k++)
+                if (!visited[src[k]]) {
+                    visited[src[k]] = 1;
+                    next.push_back(src[k]);
+                }
+            for (size_t k=synapses.out_begin(a); k<synapses.out_end(a); k++)
+                if (!visited[tgt[k]]) {
+                    visited[tgt[k]] = 1;
+                    next.push_back(tgt[k]);
+                }
+            std::stable_sort(next.begin(), next.end(), by_degree);
+            order.insert(order.end(), next.begin(), next.end());
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+template<typename Real>
+void BasicNetwork<Real>::to_external(std::vector<size_t> &idx) const {
+    if (external_ids.empty()) return;
+    for (auto &nn : idx) nn = external_ids[nn];
+    std::sort(idx.begin(), idx.end());
+}
+
+template<typename Real>
+void BasicNetwork<Real>::set_slice(const size_t begin, const size_t end) {
+    if (is_reordered()) throw(TCLAP_ERROR("A reordered network cannot be sliced"));
+    if (compact && compact->num_links()) throw(TCLAP_ERROR("Compact links cannot be sliced once created"));
+    slice_first = begin;
+    slice_last = std::max(begin, end);
+    index_links();
+    if (!compact && synapses.num_links()) {
+        edgelist el;
+        for (size_t a=slice_begin(); a<slice_end(); a++)
+            for (size_t k=synapses.row_begin(a); k<synapses.row_end(a); k++)
+                el.push_back({a, synapses.source(k), (double)synapses.weight(k), synapses.delay(k)});
+        synapses.build(size(), el);
+    }
+    partitioned = false;
+    summarized = false;
+}
+
+template<typename Real>
+void BasicNetwork<Real>::next_spikes(std::vector<size_t> &spk) {
+    const std::vector<size_t> &all = neurons.spikes();
+    spk.assign(std::lower_bound(all.begin(), all.end(), slice_begin()), std::lower_bound(all.begin(), all.end(), slice_end()));
+}
+
+template<typename Real>
+std::vector<double> BasicNetwork<Real>::potentials() const {
     std::vector<double> vals;
     for (size_t nn=0; nn<size(); nn++)
-        vals.push_back(neurons[nn].potential());
+        vals.push_back(neurons.potential(nn));
     return vals;
 }
 
-std::vector<double> Network::recoveries() const {
+template<typename Real>
+std::vector<double> BasicNetwork<Real>::recoveries() const {
     std::vector<double> vals;
     for (size_t nn=0; nn<size(); nn++)
-        vals.push_back(neurons[nn].recovery());
+        vals.push_back(neurons.recovery(nn));
     return vals;
 }
 
-void Network::print_params(std::ostream *_out) {
-    (*_out) << "Type\ta\tb\tc\td\tInhibitory\tdegree\tvalence" << std::endl;
-    for (size_t nn=0; nn<size(); nn++) {
-        std::pair<size_t, double> dI = degree(nn);
-        (*_out) << neurons[nn].formatted_params() 
-                << '\t' << dI.first << '\t' << dI.second
-                << std::endl;
+template<typename Real>
+void BasicNetwork<Real>::print_params(std::ostream *_out, const bool head) {
+    summarize_links();
+    if (head) (*_out) << "Type\ta\tb\tc\td\tInhibitory\tdegree\tvalence\n";
+    for (size_t e=0; e<size(); e++) {
+        const size_t nn = internal(e);
+        if (!owns(nn)) continue;
+        neurons.neuron(nn).write_params(*_out) << '\t' << in_degrees[nn] << '\t' << valences[nn] << '\n';
     }
+    _out->flush();
 }
 
-void Network::print_head(const std::map<std::string, size_t> &_nt, 
-                         std::ostream *_out) {
+template<typename Real>
+void BasicNetwork<Real>::print_head(const std::map<std::string, size_t> &_nt, 
+                                    std::ostream *_out) {
+    for (auto nn : traj_neurons(_nt))
+        (*_out) << '\t' << type(nn) << ".v" << '\t' << type(nn) << ".u" << '\t' << type(nn) << ".I";
+    (*_out) << std::endl;
+}
+
+template<typename Real>
+void BasicNetwork<Real>::print_traj(const int time, const std::map<std::string, size_t> &_nt, 
+                                    std::ostream *_out) {
+    (*_out)  << time;
     size_t total = 0;
-    for (auto It : _nt) {
+    for (const auto &It : _nt) {
         total += It.second;
-        for (auto In : neurons)
-            if (In.is_type(It.first)) {
-                (*_out) << '\t' << It.first << ".v"
-                        << '\t' << It.first << ".u"
-                        << '\t' << It.first << ".I";
+        for (size_t e=0; e<size(); e++) 
+            if (neurons.is_type(internal(e), It.first)) {
+                const size_t nn = internal(e);
+                (*_out) << '\t' << neurons.potential(nn) << '\t' << neurons.recovery(nn) << '\t' << neurons.input(nn);
                 break;
             }
     }
     if (total<size())
-        for (auto In : neurons) 
-            if (In.is_type("RS")) {
-                (*_out) << '\t' << "RS.v" << '\t' << "RS.u" << '\t' << "RS.I";
+        for (size_t e=0; e<size(); e++) 
+            if (neurons.is_type(internal(e), "RS")) {
+                const size_t nn = internal(e);
+                (*_out) << '\t' << neurons.potential(nn) << '\t' << neurons.recovery(nn) << '\t' << neurons.input(nn);
                 break;
             }
     (*_out) << std::endl;
 }
 
-void Network::print_traj(const int time, const std::map<std::string, size_t> &_nt, 
-                         std::ostream *_out) {
-    (*_out)  << time;
+template<typename Real>
+std::vector<size_t> BasicNetwork<Real>::traj_neurons(const std::map<std::string, size_t> &_nt) const {
+    std::vector<size_t> idx;
     size_t total = 0;
     for (auto It : _nt) {
         total += It.second;
-        for (auto In : neurons) 
-            if (In.is_type(It.first)) {
-                (*_out) << '\t' << In.formatted_values();
+        for (size_t e=0; e<size(); e++) 
+            if (neurons.is_type(internal(e), It.first)) {
+                idx.push_back(internal(e));
                 break;
             }
     }
     if (total<size())
-        for (auto In : neurons) 
-            if (In.is_type("RS")) {
-                (*_out) << '\t' << In.formatted_values();
+        for (size_t e=0; e<size(); e++) 
+            if (neurons.is_type(internal(e), "RS")) {
+                idx.push_back(internal(e));
                 break;
             }
-    (*_out) << std::endl;
+    return idx;
+}
+
+template<typename Real>
+void BasicNetwork<Real>::state_values(const std::vector<size_t> &idx, std::vector<double> &vals) const {
+    for (auto nn : idx) {
+        vals.push_back(neurons.potential(nn));
+        vals.push_back(neurons.recovery(nn));
+        vals.push_back(neurons.input(nn));
+    }
+}
+
+template<typename Real>
+std::pair<size_t, double> BasicNetwork<Real>::degree(const size_t &n) const {
+    summarize_links();
+    return {in_degrees[n], valences[n]};
+}
+
+template<typename Real>
+size_t BasicNetwork<Real>::out_degree(const size_t &n) const {
+    summarize_links();
+    return out_degrees[n];
+}
+
+template<typename Real>
+std::pair<double, double> BasicNetwork<Real>::split_valence(const size_t &n) const {
+    summarize_links();
+    return {exc_valences[n], inh_valences[n]};
+}
+
+template<typename Real>
+void BasicNetwork<Real>::summarize_links() const {
+    index_links();
+    if (summarized) return;
+    const size_t n = size();
+    in_degrees.assign(n, 0);
+    out_degrees.assign(n, 0);
+    valences.assign(n, 0.);
+    exc_valences.assign(n, 0.);
+    inh_valences.assign(n, 0.);
+// --- one pass over the incoming links of each neuron, in the order of the table
+    std::vector<std::pair<size_t, double> > row;
+    for (size_t a=0; a<n; a++) {
+        if (compact) compact->row(a, row);
+        else {
+            row.clear();
+            for (size_t k=synapses.row_begin(a); k<synapses.row_end(a); k++)
+                row.push_back({synapses.source(k), synapses.weight(k)});
+        }
+        in_degrees[a] = row.size();
+        for (auto &l : row) {
+            out_degrees[l.first]++;
+            valences[a] += l.second;
+            if (l.second < 0) inh_valences[a] -= l.second;
+            else exc_valences[a] += l.second;
+        }
+    }
+    summarized = true;
+}
+
+template<typename Real>
+std::vector<std::pair<size_t, double> > BasicNetwork<Real>::neighbors(const size_t &n) const {
+    std::vector<std::pair<size_t, double> > neigh;
+    if (compact) {
+        compact->row(n, neigh);
+        return neigh;
+    }
+    index_links();
+    neigh.reserve(synapses.degree(n));
+    for (size_t k=synapses.row_begin(n); k<synapses.row_end(n); k++)
+        neigh.push_back({synapses.source(k), synapses.weight(k)});
+    return neigh;
+}
+
+template<typename Real>
+std::vector<int> BasicNetwork<Real>::delays(const size_t &n) const {
+    if (compact) return std::vector<int>(compact->degree(n), 1);
+    index_links();
+    std::vector<int> dl;
+    for (size_t k=synapses.row_begin(n); k<synapses.row_end(n); k++) dl.push_back(synapses.delay(k));
+    return dl;
+}
+
+template<typename Real>
+int BasicNetwork<Real>::max_delay() const {
+    if (compact) return 1;
+    index_links();
+    return synapses.max_delay();
+}
+
+template<typename Real>
+void BasicNetwork<Real>::set_threads(const size_t n) {
+    if (n > 1) pool = std::make_shared<ThreadPool>(n);
+    else pool.reset();
+    if (profiler && pool)
+        for (auto tid : pool->thread_ids()) profiler->add_thread(tid);
+    partitioned = false;
 }
 
-std::pair<size_t, double> Network :: degree(const size_t& index) const{
-	
-	double total_intensity(0.0);
-	size_t nb_of_index(0);
-	
-	for(auto& link : links ){
-		if(link.first.first == index or link.first.second == index ){
-			total_intensity +=link.second;
-			nb_of_index +=1;
-			}
-		}
-	return {nb_of_index,total_intensity};
-	
-	}
-	
-std::vector<std::pair<size_t, double> > Network :: neighbors(const size_t& index) const{
-	
-	std::vector<std::pair<size_t, double> > voisins;
-	
-	for(auto link : links ){
-		if(link.first.first == index){
-			voisins.push_back({link.first.second, link.second});
-		}	
-	}
-	return voisins;
-}
-
-
-
-std::set<size_t> Network :: step(const std::vector<double>& thalamic_input){
-	std :: set<size_t> firing_neurons_index;
-	double w;
-	for(size_t i(0) ; i < this->size() ; ++i){
-			
-		
-		
-		
-		
-		
-		
-		if(neurons[i].is_inhibitory()){
-			w = 0.4;
-		}else{
-			w = 1;
-		}
-		
-		double i_exc(0.0), i_inh(0.0);
-		std::vector<std::pair<size_t, double> > neighbors(i);
-		
-		for(size_t n(0); n < neighbors.size() ; ++n){
-				
-				if(neurons[n].is_inhibitory()){
-					i_inh += neighbors[n].second;
-				}else{
-					i_exc += neighbors[n].second;
-					}
-			
-			}
-		
-		if(neurons[i].firing()){
-			
-			neurons[i].reset();
-			firing_neurons_index.insert(i);
-			
-		}
-		
-		neurons[i].input(w*thalamic_input[i]+0.5*i_exc-i_inh);
-		
-		neurons[i].step();
-	}
-	
-	return firing_neurons_index;
+template<typename Real>
+size_t BasicNetwork<Real>::num_threads() const {
+    return pool ? pool->size() : 1;
 }
 
+template<typename Real>
+void BasicNetwork<Real>::partition() {
+    index_links();
+    size_t nthreads = num_threads(), nchunks = (nthreads>1) ? 4*nthreads : 1;
+// --- the cost of a neuron is its in-degree plus a fixed cost for the neuron update;
+// --- boundaries are multiples of 8 neurons (one cache line of doubles)
+    const size_t neuron_cost = 8, align = 8;
+    const size_t first = slice_begin(), last = slice_end();
+    auto cost = [&] (const size_t b) {
+        return (compact ? compact->row_begin(b)-compact->row_begin(first) : synapses.row_begin(b)-synapses.row_begin(first)) 
+            + neuron_cost*(b-first);
+    };
+    double total = cost(last);
+    chunk_bounds.assign(1, first);
+    for (size_t c=1; c<nchunks; c++) {
+        size_t b = chunk_bounds.back();
+        while (b<last && cost(b) < c*total/nchunks) b++;
+        b -= b % align;
+        if (b > chunk_bounds.back()) chunk_bounds.push_back(b);
+    }
+    if (chunk_bounds.back() < last || chunk_bounds.size() < 2) chunk_bounds.push_back(last);
+    chunk_spikes.resize(chunk_bounds.size()-1);
+    for (size_t c=0; c+1<chunk_bounds.size(); c++)
+        chunk_spikes[c].resize(chunk_bounds[c+1]-chunk_bounds[c]);
+    chunk_counts.assign(chunk_spikes.size(), 0);
+// --- a change of the largest delay drops the input in transit
+    const size_t slots = max_delay();
+    if (slots != ring_slots || exc_input.size() != slots*size()) {
+        ring_slots = slots;
+        ring_pos = 0;
+        init_buffers();
+    }
+    partitioned = true;
+}
 
+template<typename Real>
+void BasicNetwork<Real>::step(const std::vector<double> &thalamic_input, SpikeList &firing) {
+    thal_noise.assign(thalamic_input.begin(), thalamic_input.end());
+    advance(thal_noise.data(), 0, 0, firing);
+}
+
+template<typename Real>
+void BasicNetwork<Real>::step(const double thalam, const uint64_t time, SpikeList &firing) {
+    thal_noise.resize(size());
+    advance(nullptr, thalam, time, firing);
+}
 
+template<typename Real>
+void BasicNetwork<Real>::step(const double thalam, const uint64_t time, const std::vector<size_t> &spikes, SpikeList &firing) {
+    thal_noise.resize(size());
+    advance(nullptr, thalam, time, firing, &spikes);
+}
 
+template<typename Real>
+std::set<size_t> BasicNetwork<Real>::step(const std::vector<double> &thalamic_input) {
+    SpikeList firing;
+    step(thalamic_input, firing);
+    return std::set<size_t>(firing.begin(), firing.end());
+}
 
+template<typename Real>
+std::set<size_t> BasicNetwork<Real>::step(const double thalam, const uint64_t time) {
+    SpikeList firing;
+    step(thalam, time, firing);
+    return std::set<size_t>(firing.begin(), firing.end());
+}
 
+template<typename Real>
+void BasicNetwork<Real>::advance(const Real *thalamic_input, const double thalam, const uint64_t time, 
+                                 SpikeList &firing, const std::vector<size_t> *all_spikes) {
+    index_links();
+    if (!partitioned) partition();
+    if (!neurons.is_classified()) neurons.classify();
+    const std::vector<size_t> &spikes = all_spikes ? *all_spikes : neurons.spikes();
+    if (firing.num_neurons() != size()) firing.resize(size());
+    firing.assign(spikes.begin(), spikes.end());
+    const bool delayed = ring_slots > 1, push = (event_driven || delayed) && !compact;
+    const bool reordered = !thalamic_input && is_reordered();
+    Real *exc = exc_input.data()+ring_pos*size(), *inh = inh_input.data()+ring_pos*size();
+    if (!push) 
+        for (auto nn : spikes) fired[nn] = 1;
+    auto chunk_step = [&](size_t c) {
+        size_t begin = chunk_bounds[c], end = chunk_bounds[c+1];
+        Profiler::clock::time_point lap;
+        auto timer = [&] (const int p) {
+            if (!profiler) return;
+            if (p >= 0) chunk_times[c][p] += Profiler::seconds_since(lap);
+            lap = Profiler::clock::now();
+        };
+        timer(-1);
+        const Real *thal = thalamic_input;
+        if (!thal && reordered)
+            for (size_t nn=begin; nn<end; nn++) thal_noise[nn] = external_noise[external_ids[nn]];
+        else if (!thal)
+            _RNG->normal(thal_noise.data()+begin, begin, end-begin, time, RandomNumbers::THALAMIC, 0, thalam);
+        if (!thal) thal = thal_noise.data();
+        timer(0);
+        if (push) push_input(spikes, begin, end);
+        else pull_input(begin, end);
+        timer(1);
+        chunk_counts[c] = neurons.step_range(begin, end, thal, exc, inh, chunk_spikes[c].data());
+        if (delayed) {
+            std::fill(exc+begin, exc+end, 0.0);
+            std::fill(inh+begin, inh+end, 0.0);
+        }
+        timer(2);
+    };
+    if (profiler) chunk_times.assign(chunk_spikes.size(), {{0, 0, 0}});
+// --- a reordered network draws its input by external index in a first pass, which each chunk then gathers
+    if (reordered) {
+        Profiler::clock::time_point lap = Profiler::clock::now();
+        external_noise.resize(size());
+        auto draw_noise = [&](size_t c) {
+            size_t begin = chunk_bounds[c], end = chunk_bounds[c+1];
+            _RNG->normal(external_noise.data()+begin, begin, end-begin, time, RandomNumbers::THALAMIC, 0, thalam);
+        };
+        if (pool) pool->run(chunk_spikes.size(), std::ref(draw_noise));
+        else for (size_t c=0; c<chunk_spikes.size(); c++) draw_noise(c);
+        if (profiler) profiler->add(Profiler::NOISE, Profiler::seconds_since(lap));
+    }
+// --- the pool gets a reference to the lambda: a std::function holding a reference_wrapper does not allocate
+    if (pool) pool->run(chunk_spikes.size(), std::ref(chunk_step));
+    else for (size_t c=0; c<chunk_spikes.size(); c++) chunk_step(c);
+    if (profiler) {
+        size_t nspikes = 0, events = 0;
+        if (!compact)
+            for (auto nn : spikes) events += synapses.out_degree(nn);
+        for (size_t c=0; c<chunk_times.size(); c++) {
+            profiler->add(Profiler::NOISE, chunk_times[c][0]);
+            profiler->add(Profiler::INPUT, chunk_times[c][1]);
+            profiler->add(Profiler::UPDATE, chunk_times[c][2]);
+            nspikes += chunk_counts[c];
+        }
+        profiler->count_step(nspikes, events);
+        profiler->count_neurons(size(), neurons.typed_neurons());
+    }
+    if (!push)
+        for (auto nn : spikes) fired[nn] = 0;
+    neurons.set_spikes(chunk_spikes, chunk_counts);
+    if (delayed) ring_pos = (ring_pos+1) % ring_slots;
+}
 
+template<typename Real>
+void BasicNetwork<Real>::pull_input(const size_t begin, const size_t end) {
+    if (compact) {
+        compact->pull(begin, end, fired.data(), exc_input.data(), inh_input.data());
+        return;
+    }
+    const size_t *src = synapses.source_data();
+    const Real *wgt = synapses.weight_data();
+    for (size_t nn=begin; nn<end; nn++) {
+        Real i_exc(0.0), i_inh(0.0);
+// --- inhibitory links carry a negative intensity (see add_link)
+        for (size_t k=synapses.row_begin(nn); k<synapses.row_end(nn); k++)
+            if (fired[src[k]]) {
+                if (wgt[k]<0) i_inh -= wgt[k];
+                else i_exc += wgt[k];
+            }
+        exc_input[nn] = i_exc;
+        inh_input[nn] = i_inh;
+    }
+}
+
+template<typename Real>
+void BasicNetwork<Real>::push_input(const std::vector<size_t> &spikes, const size_t begin, const size_t end) {
+    if (ring_slots > 1) {
+        push_delayed(spikes, begin, end);
+        return;
+    }
+    std::fill(exc_input.begin()+begin, exc_input.begin()+end, 0.0);
+    std::fill(inh_input.begin()+begin, inh_input.begin()+end, 0.0);
+    const size_t *tgt = synapses.target_data();
+    const Real *wgt = synapses.out_weight_data();
+// --- spikes are in increasing order, so each neuron sums its inputs in the same order as pull_input;
+// --- targets are sorted, so only the part of each outgoing row within [begin, end) is visited
+    for (auto nn : spikes) {
+        size_t k = synapses.out_begin(nn), kend = synapses.out_end(nn);
+        if (begin > 0) k = std::lower_bound(tgt+k, tgt+kend, begin) - tgt;
+        for (; k<kend && tgt[k]<end; k++) {
+            if (wgt[k]<0) inh_input[tgt[k]] -= wgt[k];
+            else exc_input[tgt[k]] += wgt[k];
+        }
+    }
+}
+
+template<typename Real>
+void BasicNetwork<Real>::push_delayed(const std::vector<size_t> &spikes, const size_t begin, const size_t end) {
+    const size_t *tgt = synapses.target_data();
+    const Real *wgt = synapses.out_weight_data();
+    const uint8_t *dl = synapses.out_delay_data();
+    const size_t n = size();
+    for (auto nn : spikes) {
+        size_t k = synapses.out_begin(nn), kend = synapses.out_end(nn);
+        if (begin > 0) k = std::lower_bound(tgt+k, tgt+kend, begin) - tgt;
+        for (; k<kend && tgt[k]<end; k++) {
+            size_t slot = ring_pos+dl[k]-1;
+            if (slot >= ring_slots) slot -= ring_slots;
+            const size_t i = slot*n+tgt[k];
+            if (wgt[k]<0) inh_input[i] -= wgt[k];
+            else exc_input[i] += wgt[k];
+        }
+    }
+}
 
+template class BasicNetwork<double>;
+template class BasicNetwork<float>;
+template BasicNetwork<float>::BasicNetwork(const BasicNetwork<double>&);
@@ -1,35 +1,83 @@
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include "compact.h"
 #include "globals.h"
 #include "neuron.h"
+#include "population.h"
+#include "profiler.h"
+#include "spikes.h"
+#include "synapses.h"
+#include "threadpool.h"
+#include <memory>
 
-/*! \class Network
+/*! \class BasicNetwork
   A neuron network is a \ref neurons "set" of neurons and a \ref links "set" of directional links between them.
 
-  Neurons are objects of class Neuron (they are identified by their index in the vector \ref neurons).
+  Neurons are objects of class Neuron (they are identified by their index in \ref neurons). 
+  They are stored as a \ref NeuronPopulation (one array per variable and parameter) and \ref neuron returns a copy of one of them.
   A link is an ordered pair of indices in \ref neurons with an intensity value, 
   collected in a \ref linkmap. This is a [std::map](https://en.cppreference.com/w/cpp/container/map) 
   therefore only one connection can exist between two neurons. 
+  The links are then frozen into a \ref SynapseTable (compressed-sparse-row index of incoming links),
+  which is what \ref degree, \ref neighbors and \ref step use. New links in \ref links are merged
+  into the table by \ref index_links, or automatically the next time the table is needed.
 
   To create a network, you need to \ref resize it and optionally \ref set_default_params for each neuron. 
   Then you can either call \ref add_link for each connection or generate a random network with \ref random_connect.
 
+  A network can also be saved to and loaded from a binary file with \ref Snapshot.
+
+  The neurons can be renumbered by \ref reorder, for instance in the \ref locality_order of the links,
+  so that the neurons linked together are close in memory (and their input and flags in the same cache lines).
+  All accessors then use the new (*internal*) indices, \ref external and \ref internal convert them from and to the
+  original (*external*) ones, which Simulation uses in its outputs.
+
+  A network too large for one process can be split between the processes of a \ref RankGroup: each one holds all the neurons
+  but updates only its \ref set_slice "slice" of them and keeps only their incoming links; 
+  the firing neurons of all the slices are given to \ref step at each time-step.
+
+  For very large networks, the links can be kept in \ref set_compact "compact" form (\ref CompactSynapses, 2 to 8 bytes per link
+  instead of 32) once the neurons are set: they are then frozen (\ref add_link fails, \ref set_links and \ref random_connect replace them) 
+  and \ref step always sums the incoming links (pull propagation), the network cannot be saved in a \ref Snapshot.
+
+  The neuron state and the link intensities are stored as \p Real: \ref Network (double) is the reference,
+  a network in single precision (*float*) is obtained by converting one, and runs with half the memory traffic.
+  Construction (random links, draws of parameters) is done in double precision in both cases.
+
   The dynamics of the network proceeds by calling \ref step. 
   The state of the network can be printed to output streams with \ref print_params (to print all parameters of all neurons), \ref print_traj to print the full state of one neuron of each type. 
   The helper function \ref print_head will print a header line with the variable names for the the \ref print_traj lines.
+  \ref print_traj looks for the neurons of each type at every call: to record trajectories during a run, 
+  a \ref Recorder holds the list of neurons and reads their values in O(recorded neurons).
 
   This class provides accessors to the following Neuron properties
   - \ref degree : returns the degree of a neuron (number of incoming connections) and valence (sum of weights of these links)
+  - \ref out_degree and \ref split_valence : number of outgoing connections, excitatory and inhibitory parts of the valence,
   - \ref neighbors : returns the indices of neurons with incoming links to a given neuron,
   - \ref potentials : returns the values of membrane potentials for all neurons,
   - \ref recoveries : returns the values of recovery variables for all neurons,
-  - \ref neuron : returns a const reference to a given neuron object.
+  - \ref neuron : returns a copy of a given neuron object.
 
  */
 
-typedef std::map<std::pair<size_t, size_t>, double> linkmap;
-
-class Network {
+template<typename Real>
+class BasicNetwork {
 
 public:
+    BasicNetwork() {}
+/*!
+  Copy of a network of another scalar type (the values are converted), 
+  with the same propagation mode and number of threads.
+ */
+    template<typename Other>
+    explicit BasicNetwork(const BasicNetwork<Other>&);
+/*!
+  Copies have their own \ref ThreadPool of the same size (so that they can be stepped concurrently)
+  and no \ref set_profiler "profiler"; only the \ref set_compact "compact" links are shared.
+ */
+    BasicNetwork(const BasicNetwork &other) {*this = other;}
+    BasicNetwork& operator=(const BasicNetwork&);
 /*! 
   Resizes a network (grow or shrink). 
   \param n (size_t): new size of the network. If growing it will be filled with default excitatory and inhibitory neurons.
@@ -62,47 +110,278 @@ public:
   \param a (size_t): receiving neuron,
   \param b (size_t): sending neuron,
   \param str (double): link intensity (will be multiplied by -2 for inhibitory source).
-  \return true if the link could be created.
+  \return true if the link could be created (false for the links to a neuron outside the \ref set_slice "slice").
  */
     bool add_link(const size_t&, const size_t&, double);
+/*!
+  Replaces all links of the network by the list \p el (\ref Synapse::target is the receiving neuron), 
+  with the same rules as \ref add_link: self-links, links to unknown neurons or outside the slice, links weaker than 1e-6 and repeated links are dropped,
+  intensities of inhibitory sources are multiplied by -2. 
+  The links are indexed directly in the \ref SynapseTable, which is much faster than \ref add_link for large lists.
+  \return the number of links created.
+ */
+    size_t set_links(edgelist &el);
 /*! 
   Creates random links in the network. Each neuron will expect to receive *n* connections (RandomNumbers::poisson with mean \p mean_deg) of intensity *s* (RandomNumbers::uniform_double with mean \p mean_streng).
-  Sending neurons will be picked at random and since there can be only one connection from each neuron, the expected degree is not always achieved.
+  Sending neurons are distinct and picked at random among the other neurons with Floyd's algorithm, in time proportional to the number of links.
+  The links are written directly in the \ref SynapseTable, in parallel over receiving neurons when there are several \ref num_threads "threads".
+  All draws come from counter-based streams (RandomNumbers::DEGREE, RandomNumbers::CONNECT and RandomNumbers::STRENGTH) indexed by neuron or link position
+  and by one sequential draw of \ref _RNG, so the network only depends on the seed, not on the number of threads.
+  In a \ref set_slice "sliced" network, only the links to the neurons of the slice are drawn (they are the same as in the whole network).
   \param mean_deg (double): mean value of Poisson distribution.
   \param mean_streng (double): mean value of the uniform distribution (with bounds 0 and 2*mean_streng).
+  \param max_delay (int): if larger than 1, each link gets a delay drawn uniformly in [1, \p max_delay] time-steps 
+  (RandomNumbers::DELAY stream, at most \ref _MAX_DELAY_).
   \return the number of links created.
  */
-    size_t random_connect(const double&, const double &s=_STRENG_);
+    size_t random_connect(const double&, const double &s=_STRENG_, const int max_delay=1);
+/*! 
+  Merges the links created by \ref add_link into the \ref SynapseTable.
+  This should be called once all links have been added.
+ */
+    void index_links() const;
     size_t size() const {return neurons.size();}
+/*!
+  Renumbers the neurons and their links: neuron *k* of the reordered network is neuron \p order[k] of the current one.
+  The links are rebuilt in a new \ref SynapseTable, the input in transit through delayed links is kept.
+  The thalamic input of \ref step is drawn with the external index of each neuron, 
+  so that the reordered network receives the same input and fires the same neurons (up to the rounding of the sums of inputs).
+  Compact links cannot be reordered (TCLAP_ERROR).
+ */
+    void reorder(const std::vector<size_t> &order);
+/*!
+  Order of the neurons for \ref reorder by method \p m:
+  - *type*: neurons grouped by type (in alphabetical order), in their current order within a type,
+  - *rcm*: reverse Cuthill-McKee order of the graph of links (without direction), 
+  which gives linked neurons close indices, component by component starting from a neuron of lowest degree.
+ */
+    std::vector<size_t> locality_order(const std::string &m) const;
+/*! @name Slice
+  \ref set_slice restricts the network to the neurons [\p begin, \p end) for a run split between the processes of a \ref RankGroup:
+  the links to the other neurons are dropped, as are those created afterwards by \ref add_link, \ref set_links or \ref random_connect.
+  \ref step then only updates the neurons of the slice, and must be given the firing neurons of the whole network.
+  The other neurons keep their parameters (the types and degrees of the links are known for all) but their state is not updated.
+  A reordered network or compact links already created cannot be sliced (TCLAP_ERROR).
+  \ref next_spikes writes the neurons of the slice which will fire at the next \ref step.
+ */
+///@{
+    void set_slice(const size_t begin, const size_t end);
+    bool is_sliced() const {return slice_first > 0 || slice_last < size();}
+    bool owns(const size_t n) const {return n >= slice_first && n < slice_last;}
+    size_t slice_begin() const {return std::min(slice_first, size());}
+    size_t slice_end() const {return std::min(slice_last, size());}
+    void next_spikes(std::vector<size_t> &spk);
+///@}
+/*! @name Index permutation
+  External (original) index of neuron \p k and internal index of neuron \p e, the identity if the network has not been reordered.
+  \ref to_external converts a list of internal indices, which is then sorted.
+ */
+///@{
+    bool is_reordered() const {return !external_ids.empty();}
+    size_t external(const size_t k) const {return external_ids.empty() ? k : external_ids[k];}
+    size_t internal(const size_t e) const {return internal_ids.empty() ? e : internal_ids[e];}
+    void to_external(std::vector<size_t> &idx) const;
+///@}
 /*! 
-  Calculates the number and total intensity of connections to neuron \p n.
+  Number and total intensity of connections to neuron \p n.
+  The degrees and valences of all neurons are computed in one pass over the links the first time they are needed
+  after the links have changed (\ref summarize_links), queries are then O(1).
   \param n : the index of the receiving neuron.
   \return a pair {number of connections, sum of link intensities}.
  */
     std::pair<size_t, double> degree(const size_t&) const;
-    const Neuron& neuron(const size_t n) const {return neurons.at(n);}
+/*!
+  Number of connections from neuron \p n.
+ */
+    size_t out_degree(const size_t&) const;
+/*!
+  Total intensity of the excitatory and of the inhibitory connections to neuron \p n (both positive, 
+  the valence of \ref degree is their difference up to rounding).
+ */
+    std::pair<double, double> split_valence(const size_t&) const;
+    Neuron neuron(const size_t n) const {return neurons.neuron(n);}
+    const std::string& type(const size_t n) const {return neurons.type(n);}
 /*! 
   Finds the list of neurons with incoming connections to \p n.
   \param n : the index of the receiving neuron.
   \return a vector of pairs {neuron index, link intensity}.
  */
     std::vector<std::pair<size_t, double> > neighbors(const size_t&) const;
+/*!
+  Delays (in time-steps) of the links to neuron \p n, in the order of \ref neighbors.
+ */
+    std::vector<int> delays(const size_t&) const;
+/*!
+  Largest delay of the links, 1 if they have no delays.
+ */
+    int max_delay() const;
     std::vector<double> potentials() const;
     std::vector<double> recoveries() const;
 /*! 
   Performs one time-step of the simulation.
+  Firing neurons are reset, then each neuron receives its thalamic input plus the intensities of its incoming links 
+  from firing neurons (half of the excitatory ones, all of the inhibitory ones), read from the \ref SynapseTable.
+  In \ref set_event_driven "event-driven" mode (the default), each firing neuron adds its outgoing link intensities
+  to the input of its targets (\ref push_input), otherwise each neuron sums its incoming links from firing neurons (\ref pull_input).
+  Both give exactly the same result.
+  If links have \ref delays, the intensities are added to the input of the step at which they arrive 
+  (in a circular buffer, see \ref exc_input), always by the firing neurons (event-driven).
+  With \ref set_threads, the neurons are split into chunks of similar total in-degree, 
+  which are processed in parallel; the result does not depend on the number of threads.
   \param input : a vector of random values as thalamic input, one value for each neuron. The variance of these values corresponds to excitatory neurons.
-  \return the indices of firing neurons.
+  \param firing : replaced by the indices of firing neurons (it is resized to the network if needed), 
+  a list reused from step to step does not allocate memory.
+ */
+    void step(const std::vector<double>&, SpikeList &firing);
+/*! 
+  Same as above, the thalamic input is drawn from the RandomNumbers::THALAMIC stream of \ref _RNG 
+  (normal distribution with standard deviation \p thalam) at step \p time, in parallel by each thread
+  (the value of a neuron is indexed by its \ref external index).
  */
+    void step(const double thalam, const uint64_t time, SpikeList &firing);
+/*!
+  Same as above for a \ref set_slice "sliced" network: \p spikes are the firing neurons of the whole network 
+  (the \ref next_spikes of all the slices, in increasing order), they replace the neurons above threshold in this network,
+  \p firing is set to them.
+ */
+    void step(const double thalam, const uint64_t time, const std::vector<size_t> &spikes, SpikeList &firing);
+/*! @name Step with a new set
+  Same as above, returning the indices of firing neurons in a new std::set (allocated at each step).
+ */
+///@{
     std::set<size_t> step(const std::vector<double>&);
-    void print_params(std::ostream *_out=&std::cout);
+    std::set<size_t> step(const double thalam, const uint64_t time);
+///@}
+/*!
+  Converts the links to a \ref CompactSynapses of format \p f and releases the \ref SynapseTable.
+  Links created afterwards by \ref set_links or \ref random_connect are coded directly in this format 
+  (\ref random_connect never builds the full table). 
+  Neurons added by \ref resize have no links, shrinking the network drops all links.
+ */
+    void set_compact(const CompactSynapses::Format &f);
+    bool is_compact() const {return (bool)compact;}
+    const CompactSynapses* compact_synapses() const {return compact.get();}
+    void set_event_driven(const bool _e) {event_driven = _e;}
+    bool is_event_driven() const {return event_driven;}
+/*!
+  Sets the number of threads used by \ref step (the threads are created once, in a \ref ThreadPool).
+ */
+    void set_threads(const size_t);
+    size_t num_threads() const;
+/*!
+  Times the phases of \ref step and counts spikes and synaptic events in \p p (no profiling if null),
+  the hardware counters of \p p include the worker threads.
+ */
+    void set_profiler(Profiler *p) {
+        profiler = p;
+        if (profiler && pool) 
+            for (auto tid : pool->thread_ids()) profiler->add_thread(tid);
+    }
+/*!
+  Writes the parameters, degree and valence of all neurons, in the order of their \ref external indices,
+  after a header line if \p head. A sliced network only writes the neurons of its slice.
+ */
+    void print_params(std::ostream *_out=&std::cout, const bool head=true);
     void print_traj(const int, const std::map<std::string, size_t>&, 
                     std::ostream *_out=&std::cout);
     void print_head(const std::map<std::string, size_t>&, 
                     std::ostream *_out=&std::cout);
+/*! 
+  Indices of the neurons printed by \ref print_traj: the first neuron (by \ref external index) of each type in \p _nt, 
+  then the first *RS* neuron if \p _nt does not cover the whole network.
+ */
+    std::vector<size_t> traj_neurons(const std::map<std::string, size_t>&) const;
+/*! 
+  Appends the potential, recovery variable and input of each neuron in \p idx to \p vals 
+  (the values printed by \ref print_traj).
+ */
+    void state_values(const std::vector<size_t> &idx, std::vector<double> &vals) const;
 
 private:
-    std::vector<Neuron> neurons;
-    linkmap links;
+    BasicNeuronPopulation<Real> neurons;
+/*!
+  Links added since the last call to \ref index_links.
+ */
+    mutable linkmap links;
+    mutable BasicSynapseTable<Real> synapses;
+/*!
+  Links in compact form, which replace \ref synapses if set (shared by the copies of the network, as they are frozen).
+ */
+    std::shared_ptr<CompactSynapses> compact;
+/*! @name Step buffers
+  Synaptic input of each neuron and flags of firing neurons, reused at each \ref step.
+  With delays, \ref exc_input and \ref inh_input are circular buffers of \ref ring_slots (the largest delay) slots 
+  of one value per neuron: slot *(\ref ring_pos + d - 1) mod \ref ring_slots* accumulates the input arriving in *d* steps, 
+  the current slot is read then cleared by each step, so that a spike is delivered in O(1) per link.
+ */
+///@{
+    std::vector<Real> exc_input, inh_input, thal_noise, external_noise;
+    std::vector<char> fired;
+    size_t ring_slots = 1, ring_pos = 0;
+///@}
+    void init_buffers();
+    bool event_driven = true;
+/*!
+  Implementation of \ref step: if \p thalamic_input is null, the input is drawn in \ref thal_noise,
+  if \p all_spikes is not null, it replaces the list of firing neurons.
+ */
+    void advance(const Real *thalamic_input, const double thalam, const uint64_t time, SpikeList &firing,
+                 const std::vector<size_t> *all_spikes=nullptr);
+/*! @name Synaptic input
+  Fill \ref exc_input and \ref inh_input for the neurons in [\p begin, \p end) from the list of firing neurons:
+  \ref pull_input scans all incoming links (O(links)) using the flags in \ref fired, 
+  \ref push_input scans the outgoing links of firing neurons (O(spikes x out-degree)).
+ */
+///@{
+    void pull_input(const size_t begin, const size_t end);
+    void push_input(const std::vector<size_t>&, const size_t begin, const size_t end);
+/*!
+  \ref push_input through delayed links: adds each intensity to the slot of its arrival step, the buffers are not cleared.
+ */
+    void push_delayed(const std::vector<size_t>&, const size_t begin, const size_t end);
+///@}
+/*! @name Parallel chunks
+  \ref partition splits the neurons (of the slice) in consecutive chunks [\ref chunk_bounds[c], \ref chunk_bounds[c+1]) of similar cost.
+  Each chunk writes the indices of its firing neurons in its own buffer of \ref chunk_spikes, 
+  these are concatenated in order after each step.
+ */
+///@{
+    void partition();
+    std::shared_ptr<ThreadPool> pool;
+    std::vector<size_t> chunk_bounds, chunk_counts;
+    std::vector<std::vector<size_t> > chunk_spikes;
+    mutable bool partitioned = false;
+///@}
+/*! @name Link summaries
+  In-degree, out-degree, valence and its excitatory and inhibitory parts of each neuron, 
+  rebuilt by \ref summarize_links when \ref summarized has been reset by a change of the links.
+ */
+///@{
+    void summarize_links() const;
+    mutable std::vector<uint32_t> in_degrees, out_degrees;
+    mutable std::vector<double> valences, exc_valences, inh_valences;
+    mutable bool summarized = false;
+///@}
+/*! @name Permutation
+  \ref external_ids holds the external index of each neuron and \ref internal_ids its inverse, both empty if the network has not been reordered.
+  The thalamic input is then drawn in \ref external_noise by external index, then gathered by each neuron.
+ */
+///@{
+    ArrayStore<size_t> external_ids;
+    std::vector<size_t> internal_ids;
+///@}
+    size_t slice_first = 0, slice_last = SIZE_MAX;
+/*!
+  Times of the phases of \ref step (noise, input, update) in each chunk, collected if \ref profiler is set.
+ */
+    Profiler *profiler = nullptr;
+    std::vector<std::array<double, 3> > chunk_times;
+    template<typename> friend class BasicNetwork;
+    friend class Snapshot;
+    friend class TrialBatch;
 
 };
+
+typedef BasicNetwork<double> Network;
+
+#endif //NETWORK_H
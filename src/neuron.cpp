@@ -1,15 +1,11 @@
 #include "globals.h"
 #include "neuron.h"
 
+#define _TYPE_ENTRY_(_N, _a, _b, _c, _d, _i) {#_N, {_a, _b, _c, _d, _i}},
 const std::map<std::string, NeuronParams> Neuron::NeuronTypes{
-    {"RS",  {.02, .2,  -65, 8,   false}},
-    {"IB",  {.02, .2,  -55, 4,   false}},
-    {"CH",  {.02, .2,  -50, 2,   false}},
-    {"FS",  {.1,  .2,  -65, 2,   true }},
-    {"LTS", {.02, .25, -65, 2,   true }},
-    {"TC",  {.02, .25, -65, .05, false}},
-    {"RZ",  {.1,  .26, -65, 2,   false}}
+    _NEURON_TYPES_(_TYPE_ENTRY_)
 };
+#undef _TYPE_ENTRY_
 
 double Neuron::firing_thresh = _FIRING_TH_;
 
@@ -54,17 +50,25 @@ void Neuron::step() {
 
 std::string Neuron::formatted_params() const {
     std::stringstream ss;
-    ss << _type->first << '\t'
-       << params.a << '\t'
-       << params.b << '\t'
-       << params.c << '\t'
-       << params.d << '\t'
-       << (int)params.inhib;
+    write_params(ss);
     return ss.str();
 }
 
+std::ostream& Neuron::write_params(std::ostream &out) const {
+    return out << _type->first << '\t'
+               << params.a << '\t'
+               << params.b << '\t'
+               << params.c << '\t'
+               << params.d << '\t'
+               << (int)params.inhib;
+}
+
 std::string Neuron::formatted_values() const {
     std::stringstream ss;
-    ss << _poten << '\t' << _recov << '\t' << _input;
+    write_values(ss);
     return ss.str();
 }
+
+std::ostream& Neuron::write_values(std::ostream &out) const {
+    return out << _poten << '\t' << _recov << '\t' << _input;
+}
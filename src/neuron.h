@@ -1,3 +1,6 @@
+#ifndef NEURON_H
+#define NEURON_H
+
 #include "globals.h"
 
 /*! \class Neuron
@@ -10,6 +13,16 @@
 
 struct NeuronParams {double a, b, c, d; bool inhib;};
 
+/// * standard neuron types (name, a, b, c, d, inhibitory), expanded by Neuron::NeuronTypes and by the per-type kernels of BasicNeuronPopulation *
+#define _NEURON_TYPES_(_X) \
+    _X(RS,  .02, .2,  -65, 8,   false) \
+    _X(IB,  .02, .2,  -55, 4,   false) \
+    _X(CH,  .02, .2,  -50, 2,   false) \
+    _X(FS,  .1,  .2,  -65, 2,   true ) \
+    _X(LTS, .02, .25, -65, 2,   true ) \
+    _X(TC,  .02, .25, -65, .05, false) \
+    _X(RZ,  .1,  .26, -65, 2,   false)
+
 class Neuron {
     static const std::map<std::string, NeuronParams> NeuronTypes;
     static double firing_thresh;
@@ -23,7 +36,8 @@ public:
     void set_type(std::string);
     void set_default_params(const std::string&, double n=0);
     bool is_type(const std::string&);
-    std::string type() {return _type->first;}
+    std::string type() const {return _type->first;}
+    NeuronParams parameters() const {return params;}
     bool is_inhibitory() const {return params.inhib;}
     void set_inhibitory() {params.inhib=true;}
 /*!
@@ -41,22 +55,28 @@ public:
     void potential(const double &_p) {_poten = _p;}
     double potential() const {return _poten;}
     double recovery() const {return _recov;}
+    void recovery(const double &_r) {_recov = _r;}
     void input(const double i) {_input=i;}
     double input() const {return _input;}
 /*! @name Output strings
   For printing purposes: all parameters and dynamic values are returned as a formatted string (tab-delimited concatenation of values).
+  \ref write_params and \ref write_values write them directly to stream \p out, without a temporary string.
  */
 ///@{
     std::string formatted_params() const;
     std::string formatted_values() const;
+    std::ostream& write_params(std::ostream &out) const;
+    std::ostream& write_values(std::ostream &out) const;
 ///@}
 
 /*! @name Static helpers
   \ref type_exists checks if the string \p s exists in the map \ref NeuronTypes and 
-  \ref type_default returns the corresponding \ref NeuronParams from \ref NeuronTypes.
+  \ref type_default returns the corresponding \ref NeuronParams from \ref NeuronTypes,
+  \ref firing_threshold returns \ref firing_thresh.
  */
 ///@{
     static bool type_exists(const std::string &s) {return NeuronTypes.count(s);}
+    static double firing_threshold() {return firing_thresh;}
     static NeuronParams type_default(const std::string &s) {
         if (type_exists(s)) return NeuronTypes.at(s);
         return NeuronTypes.at("RS");
@@ -80,3 +100,4 @@ private:
 
 };
 
+#endif //NEURON_H
@@ -0,0 +1,411 @@
+#include "population.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define _POP_X86_ 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+template<typename Real>
+struct Arrays {
+    Real *v, *u, *I;
+    const Real *a, *b, *c, *d, *w;
+};
+
+constexpr double thalamic_weight(const bool inhib) {return inhib ? 0.4 : 1.0;}
+
+/// * entry k of the permuted array is entry order[k] of the array *
+template<typename T>
+void permute_array(ArrayStore<T> &arr, const std::vector<size_t> &order) {
+    ArrayStore<T> res(order.size(), T());
+    for (size_t k=0; k<order.size(); k++) res[k] = arr[order[k]];
+    arr.swap(res);
+}
+
+/*
+  Parameters of a kernel: read from the arrays (RuntimeParams), or the compile-time constants of a standard type, 
+  the kernels test P::fixed which is a constant too.
+ */
+struct RuntimeParams {
+    static constexpr bool fixed = false;
+    static constexpr double a = 0, b = 0, c = 0, d = 0, w = 0;
+};
+
+#define _TYPE_PARAMS_(_N, _a, _b, _c, _d, _i) struct Params##_N { \
+    static constexpr bool fixed = true; \
+    static constexpr double a = _a, b = _b, c = _c, d = _d, w = thalamic_weight(_i); };
+_NEURON_TYPES_(_TYPE_PARAMS_)
+#undef _TYPE_PARAMS_
+
+#define _TYPE_ENUM_(_N, ...) KERNEL_##_N,
+enum {KERNEL_RUNTIME, _NEURON_TYPES_(_TYPE_ENUM_) NUM_KERNELS};
+#undef _TYPE_ENUM_
+
+struct TypeKernel {const char *name; NeuronParams par; double w;};
+#define _TYPE_KERNEL_(_N, _a, _b, _c, _d, _i) {#_N, {_a, _b, _c, _d, _i}, thalamic_weight(_i)},
+const TypeKernel kernel_types[] = {{"", {0, 0, 0, 0, false}, 0}, _NEURON_TYPES_(_TYPE_KERNEL_)};
+#undef _TYPE_KERNEL_
+
+/// * segments shorter than this are stepped by the generic kernel *
+const size_t MIN_SEGMENT = 64;
+
+template<typename Real, class P>
+size_t kernel_scalar(const Arrays<Real> &p, size_t k, const size_t end, const Real *thal,
+                     const Real *exc, const Real *inh, size_t *spk) {
+    const Real th = Neuron::firing_threshold();
+    size_t ns = 0;
+    for (; k<end; k++)
+        if (BasicNeuronPopulation<Real>::update(p.v[k], p.u[k], p.I[k], 
+                                                P::fixed ? Real(P::a) : p.a[k], P::fixed ? Real(P::b) : p.b[k],
+                                                P::fixed ? Real(P::c) : p.c[k], P::fixed ? Real(P::d) : p.d[k],
+                                                P::fixed ? Real(P::w) : p.w[k],
+                                                thal[k], exc[k], inh[k], th))
+            spk[ns++] = k;
+    return ns;
+}
+
+#ifdef _POP_X86_
+// The vector kernels use separate multiplications and additions (no FMA) in the same order
+// as NeuronPopulation::update, so that they produce exactly the same values
+// (the build uses -ffp-contract=off so that the compiler does not fuse them either).
+
+template<class P> __attribute__((target("avx2")))
+size_t kernel_avx2(const Arrays<double> &p, size_t k, const size_t end, const double *thal,
+                   const double *exc, const double *inh, size_t *spk) {
+    const __m256d th = _mm256_set1_pd(Neuron::firing_threshold()), half = _mm256_set1_pd(0.5),
+        c004 = _mm256_set1_pd(0.04), c5 = _mm256_set1_pd(5), c140 = _mm256_set1_pd(140);
+    const __m256d pa = _mm256_set1_pd(P::a), pb = _mm256_set1_pd(P::b), pc = _mm256_set1_pd(P::c),
+        pd = _mm256_set1_pd(P::d), pw = _mm256_set1_pd(P::w);
+    size_t ns = 0;
+    for (; k+4<=end; k+=4) {
+        __m256d v = _mm256_loadu_pd(p.v+k), u = _mm256_loadu_pd(p.u+k);
+        const __m256d a = P::fixed ? pa : _mm256_loadu_pd(p.a+k), b = P::fixed ? pb : _mm256_loadu_pd(p.b+k),
+            c = P::fixed ? pc : _mm256_loadu_pd(p.c+k), d = P::fixed ? pd : _mm256_loadu_pd(p.d+k),
+            w = P::fixed ? pw : _mm256_loadu_pd(p.w+k);
+        __m256d fired = _mm256_cmp_pd(v, th, _CMP_GT_OQ);
+        v = _mm256_blendv_pd(v, c, fired);
+        u = _mm256_blendv_pd(u, _mm256_add_pd(u, d), fired);
+        __m256d I = _mm256_add_pd(_mm256_mul_pd(w, _mm256_loadu_pd(thal+k)),
+                                  _mm256_mul_pd(half, _mm256_loadu_pd(exc+k)));
+        I = _mm256_sub_pd(I, _mm256_loadu_pd(inh+k));
+        for (int h=0; h<2; h++) {
+            __m256d dv = _mm256_mul_pd(_mm256_mul_pd(c004, v), v);
+            dv = _mm256_add_pd(dv, _mm256_mul_pd(c5, v));
+            dv = _mm256_sub_pd(_mm256_add_pd(dv, c140), u);
+            v = _mm256_add_pd(v, _mm256_mul_pd(half, _mm256_add_pd(dv, I)));
+        }
+        __m256d du = _mm256_sub_pd(_mm256_mul_pd(b, v), u);
+        u = _mm256_add_pd(u, _mm256_mul_pd(a, du));
+        _mm256_storeu_pd(p.v+k, v);
+        _mm256_storeu_pd(p.u+k, u);
+        _mm256_storeu_pd(p.I+k, I);
+        int mask = _mm256_movemask_pd(_mm256_cmp_pd(v, th, _CMP_GT_OQ));
+        for (; mask; mask &= mask-1) spk[ns++] = k+__builtin_ctz(mask);
+    }
+    return ns + kernel_scalar<double, P>(p, k, end, thal, exc, inh, spk+ns);
+}
+
+template<class P> __attribute__((target("avx512f")))
+size_t kernel_avx512(const Arrays<double> &p, size_t k, const size_t end, const double *thal,
+                     const double *exc, const double *inh, size_t *spk) {
+    const __m512d th = _mm512_set1_pd(Neuron::firing_threshold()), half = _mm512_set1_pd(0.5),
+        c004 = _mm512_set1_pd(0.04), c5 = _mm512_set1_pd(5), c140 = _mm512_set1_pd(140);
+    const __m512d pa = _mm512_set1_pd(P::a), pb = _mm512_set1_pd(P::b), pc = _mm512_set1_pd(P::c),
+        pd = _mm512_set1_pd(P::d), pw = _mm512_set1_pd(P::w);
+    size_t ns = 0;
+    for (; k+8<=end; k+=8) {
+        __m512d v = _mm512_loadu_pd(p.v+k), u = _mm512_loadu_pd(p.u+k);
+        const __m512d a = P::fixed ? pa : _mm512_loadu_pd(p.a+k), b = P::fixed ? pb : _mm512_loadu_pd(p.b+k),
+            c = P::fixed ? pc : _mm512_loadu_pd(p.c+k), d = P::fixed ? pd : _mm512_loadu_pd(p.d+k),
+            w = P::fixed ? pw : _mm512_loadu_pd(p.w+k);
+        __mmask8 fired = _mm512_cmp_pd_mask(v, th, _CMP_GT_OQ);
+        v = _mm512_mask_mov_pd(v, fired, c);
+        u = _mm512_mask_add_pd(u, fired, u, d);
+        __m512d I = _mm512_add_pd(_mm512_mul_pd(w, _mm512_loadu_pd(thal+k)),
+                                  _mm512_mul_pd(half, _mm512_loadu_pd(exc+k)));
+        I = _mm512_sub_pd(I, _mm512_loadu_pd(inh+k));
+        for (int h=0; h<2; h++) {
+            __m512d dv = _mm512_mul_pd(_mm512_mul_pd(c004, v), v);
+            dv = _mm512_add_pd(dv, _mm512_mul_pd(c5, v));
+            dv = _mm512_sub_pd(_mm512_add_pd(dv, c140), u);
+            v = _mm512_add_pd(v, _mm512_mul_pd(half, _mm512_add_pd(dv, I)));
+        }
+        __m512d du = _mm512_sub_pd(_mm512_mul_pd(b, v), u);
+        u = _mm512_add_pd(u, _mm512_mul_pd(a, du));
+        _mm512_storeu_pd(p.v+k, v);
+        _mm512_storeu_pd(p.u+k, u);
+        _mm512_storeu_pd(p.I+k, I);
+        unsigned mask = _mm512_cmp_pd_mask(v, th, _CMP_GT_OQ);
+        for (; mask; mask &= mask-1) spk[ns++] = k+__builtin_ctz(mask);
+    }
+    return ns + kernel_scalar<double, P>(p, k, end, thal, exc, inh, spk+ns);
+}
+
+// Single precision: the same kernels on 8 (AVX2) or 16 (AVX-512) neurons at a time.
+
+template<class P> __attribute__((target("avx2")))
+size_t kernel_avx2(const Arrays<float> &p, size_t k, const size_t end, const float *thal,
+                   const float *exc, const float *inh, size_t *spk) {
+    const __m256 th = _mm256_set1_ps(Neuron::firing_threshold()), half = _mm256_set1_ps(0.5f),
+        c004 = _mm256_set1_ps(0.04f), c5 = _mm256_set1_ps(5), c140 = _mm256_set1_ps(140);
+    const __m256 pa = _mm256_set1_ps(P::a), pb = _mm256_set1_ps(P::b), pc = _mm256_set1_ps(P::c),
+        pd = _mm256_set1_ps(P::d), pw = _mm256_set1_ps(P::w);
+    size_t ns = 0;
+    for (; k+8<=end; k+=8) {
+        __m256 v = _mm256_loadu_ps(p.v+k), u = _mm256_loadu_ps(p.u+k);
+        const __m256 a = P::fixed ? pa : _mm256_loadu_ps(p.a+k), b = P::fixed ? pb : _mm256_loadu_ps(p.b+k),
+            c = P::fixed ? pc : _mm256_loadu_ps(p.c+k), d = P::fixed ? pd : _mm256_loadu_ps(p.d+k),
+            w = P::fixed ? pw : _mm256_loadu_ps(p.w+k);
+        __m256 fired = _mm256_cmp_ps(v, th, _CMP_GT_OQ);
+        v = _mm256_blendv_ps(v, c, fired);
+        u = _mm256_blendv_ps(u, _mm256_add_ps(u, d), fired);
+        __m256 I = _mm256_add_ps(_mm256_mul_ps(w, _mm256_loadu_ps(thal+k)),
+                                 _mm256_mul_ps(half, _mm256_loadu_ps(exc+k)));
+        I = _mm256_sub_ps(I, _mm256_loadu_ps(inh+k));
+        for (int h=0; h<2; h++) {
+            __m256 dv = _mm256_mul_ps(_mm256_mul_ps(c004, v), v);
+            dv = _mm256_add_ps(dv, _mm256_mul_ps(c5, v));
+            dv = _mm256_sub_ps(_mm256_add_ps(dv, c140), u);
+            v = _mm256_add_ps(v, _mm256_mul_ps(half, _mm256_add_ps(dv, I)));
+        }
+        __m256 du = _mm256_sub_ps(_mm256_mul_ps(b, v), u);
+        u = _mm256_add_ps(u, _mm256_mul_ps(a, du));
+        _mm256_storeu_ps(p.v+k, v);
+        _mm256_storeu_ps(p.u+k, u);
+        _mm256_storeu_ps(p.I+k, I);
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(v, th, _CMP_GT_OQ));
+        for (; mask; mask &= mask-1) spk[ns++] = k+__builtin_ctz(mask);
+    }
+    return ns + kernel_scalar<float, P>(p, k, end, thal, exc, inh, spk+ns);
+}
+
+template<class P> __attribute__((target("avx512f")))
+size_t kernel_avx512(const Arrays<float> &p, size_t k, const size_t end, const float *thal,
+                     const float *exc, const float *inh, size_t *spk) {
+    const __m512 th = _mm512_set1_ps(Neuron::firing_threshold()), half = _mm512_set1_ps(0.5f),
+        c004 = _mm512_set1_ps(0.04f), c5 = _mm512_set1_ps(5), c140 = _mm512_set1_ps(140);
+    const __m512 pa = _mm512_set1_ps(P::a), pb = _mm512_set1_ps(P::b), pc = _mm512_set1_ps(P::c),
+        pd = _mm512_set1_ps(P::d), pw = _mm512_set1_ps(P::w);
+    size_t ns = 0;
+    for (; k+16<=end; k+=16) {
+        __m512 v = _mm512_loadu_ps(p.v+k), u = _mm512_loadu_ps(p.u+k);
+        const __m512 a = P::fixed ? pa : _mm512_loadu_ps(p.a+k), b = P::fixed ? pb : _mm512_loadu_ps(p.b+k),
+            c = P::fixed ? pc : _mm512_loadu_ps(p.c+k), d = P::fixed ? pd : _mm512_loadu_ps(p.d+k),
+            w = P::fixed ? pw : _mm512_loadu_ps(p.w+k);
+        __mmask16 fired = _mm512_cmp_ps_mask(v, th, _CMP_GT_OQ);
+        v = _mm512_mask_mov_ps(v, fired, c);
+        u = _mm512_mask_add_ps(u, fired, u, d);
+        __m512 I = _mm512_add_ps(_mm512_mul_ps(w, _mm512_loadu_ps(thal+k)),
+                                 _mm512_mul_ps(half, _mm512_loadu_ps(exc+k)));
+        I = _mm512_sub_ps(I, _mm512_loadu_ps(inh+k));
+        for (int h=0; h<2; h++) {
+            __m512 dv = _mm512_mul_ps(_mm512_mul_ps(c004, v), v);
+            dv = _mm512_add_ps(dv, _mm512_mul_ps(c5, v));
+            dv = _mm512_sub_ps(_mm512_add_ps(dv, c140), u);
+            v = _mm512_add_ps(v, _mm512_mul_ps(half, _mm512_add_ps(dv, I)));
+        }
+        __m512 du = _mm512_sub_ps(_mm512_mul_ps(b, v), u);
+        u = _mm512_add_ps(u, _mm512_mul_ps(a, du));
+        _mm512_storeu_ps(p.v+k, v);
+        _mm512_storeu_ps(p.u+k, u);
+        _mm512_storeu_ps(p.I+k, I);
+        unsigned mask = _mm512_cmp_ps_mask(v, th, _CMP_GT_OQ);
+        for (; mask; mask &= mask-1) spk[ns++] = k+__builtin_ctz(mask);
+    }
+    return ns + kernel_scalar<float, P>(p, k, end, thal, exc, inh, spk+ns);
+}
+#endif
+
+template<typename Real, class P>
+size_t run_kernel(const Arrays<Real> &p, const size_t begin, const size_t end, const Real *thal,
+                  const Real *exc, const Real *inh, size_t *spk) {
+#ifdef _POP_X86_
+    if (SimdDispatch::simd_level() == SimdDispatch::AVX512) 
+        return kernel_avx512<P>(p, begin, end, thal, exc, inh, spk);
+    if (SimdDispatch::simd_level() == SimdDispatch::AVX2)
+        return kernel_avx2<P>(p, begin, end, thal, exc, inh, spk);
+#endif
+    return kernel_scalar<Real, P>(p, begin, end, thal, exc, inh, spk);
+}
+
+template<typename Real>
+size_t run_kernel(const int kernel, const Arrays<Real> &p, const size_t begin, const size_t end, 
+                  const Real *thal, const Real *exc, const Real *inh, size_t *spk) {
+    switch (kernel) {
+#define _TYPE_CASE_(_N, ...) case KERNEL_##_N: return run_kernel<Real, Params##_N>(p, begin, end, thal, exc, inh, spk);
+        _NEURON_TYPES_(_TYPE_CASE_)
+#undef _TYPE_CASE_
+    default: return run_kernel<Real, RuntimeParams>(p, begin, end, thal, exc, inh, spk);
+    }
+}
+
+SimdDispatch::SimdLevel best_level() {
+#ifdef _POP_X86_
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return SimdDispatch::AVX512;
+    if (__builtin_cpu_supports("avx2")) return SimdDispatch::AVX2;
+#endif
+    return SimdDispatch::SCALAR;
+}
+
+}
+
+SimdDispatch::SimdLevel SimdDispatch::level = best_level();
+bool SimdDispatch::use_types = true;
+
+SimdDispatch::SimdLevel SimdDispatch::simd_level() {
+    return level;
+}
+
+void SimdDispatch::set_simd_level(SimdLevel l) {
+    level = std::min(l, best_level());
+}
+
+template<typename Real> template<typename Other>
+BasicNeuronPopulation<Real>::BasicNeuronPopulation(const BasicNeuronPopulation<Other> &other)
+    : inhib(other.inhib), type_id(other.type_id), type_names(other.type_names) {
+    v.assign(other.v.begin(), other.v.end());
+    u.assign(other.u.begin(), other.u.end());
+    I.assign(other.I.begin(), other.I.end());
+    a.assign(other.a.begin(), other.a.end());
+    b.assign(other.b.begin(), other.b.end());
+    c.assign(other.c.begin(), other.c.end());
+    d.assign(other.d.begin(), other.d.end());
+    w.assign(other.w.begin(), other.w.end());
+}
+
+template<typename Real>
+void BasicNeuronPopulation<Real>::resize(const size_t n) {
+    size_t old = size();
+    for (auto vec : {&v, &u, &I, &a, &b, &c, &d, &w}) vec->resize(n);
+    inhib.resize(n);
+    type_id.resize(n);
+    if (n > old) {
+        Neuron nrn;
+        nrn.set_default_params("RS");
+        nrn.input(0);
+        for (size_t k=old; k<n; k++) set(k, nrn);
+    }
+    spikes_valid = false;
+    classified = false;
+}
+
+template<typename Real>
+void BasicNeuronPopulation<Real>::permute(const std::vector<size_t> &order) {
+    for (auto vec : {&v, &u, &I, &a, &b, &c, &d, &w}) permute_array(*vec, order);
+    permute_array(inhib, order);
+    permute_array(type_id, order);
+    spikes_valid = false;
+    classified = false;
+}
+
+template<typename Real>
+Neuron BasicNeuronPopulation<Real>::neuron(const size_t k) const {
+    Neuron nrn;
+    nrn.set_type(type(k));
+    nrn.set_params({a[k], b[k], c[k], d[k], (bool)inhib[k]});
+    nrn.potential(v[k]);
+    nrn.recovery(u[k]);
+    nrn.input(I[k]);
+    return nrn;
+}
+
+template<typename Real>
+void BasicNeuronPopulation<Real>::set(const size_t k, const Neuron &nrn) {
+    NeuronParams par = nrn.parameters();
+    a[k] = par.a;
+    b[k] = par.b;
+    c[k] = par.c;
+    d[k] = par.d;
+    w[k] = thalamic_weight(par.inhib);
+    inhib[k] = par.inhib;
+    v[k] = nrn.potential();
+    u[k] = nrn.recovery();
+    I[k] = nrn.input();
+    size_t id = std::find(type_names.begin(), type_names.end(), nrn.type()) - type_names.begin();
+    if (id == type_names.size()) type_names.push_back(nrn.type());
+    type_id[k] = id;
+    spikes_valid = false;
+    classified = false;
+}
+
+template<typename Real>
+const std::vector<size_t>& BasicNeuronPopulation<Real>::spikes() {
+    if (!spikes_valid) {
+        spike_list.clear();
+        for (size_t k=0; k<size(); k++)
+            if (firing(k)) spike_list.push_back(k);
+        spikes_valid = true;
+    }
+    return spike_list;
+}
+
+template<typename Real>
+void BasicNeuronPopulation<Real>::step(const Real *thal, const Real *exc, const Real *inh) {
+    if (!classified) classify();
+    spike_list.resize(size());
+    spike_list.resize(step_range(0, size(), thal, exc, inh, spike_list.data()));
+    spikes_valid = true;
+}
+
+template<typename Real>
+void BasicNeuronPopulation<Real>::set_spikes(const std::vector<std::vector<size_t> > &parts, 
+                                             const std::vector<size_t> &counts) {
+    spike_list.clear();
+    for (size_t c=0; c<parts.size(); c++)
+        spike_list.insert(spike_list.end(), parts[c].begin(), parts[c].begin()+counts[c]);
+    spikes_valid = true;
+}
+
+template<typename Real>
+void BasicNeuronPopulation<Real>::classify() {
+// --- kernel of each type name: the type of the same name if it is a standard type
+    std::vector<int> type_kernel(type_names.size(), KERNEL_RUNTIME);
+    for (size_t t=0; t<type_names.size(); t++)
+        for (int kr=KERNEL_RUNTIME+1; kr<NUM_KERNELS; kr++)
+            if (type_names[t] == kernel_types[kr].name) type_kernel[t] = kr;
+    auto kernel_of = [&] (const size_t k) {
+        int kr = type_kernel[type_id[k]];
+        const TypeKernel &tk = kernel_types[kr];
+        if (kr == KERNEL_RUNTIME || a[k] != Real(tk.par.a) || b[k] != Real(tk.par.b) || c[k] != Real(tk.par.c)
+            || d[k] != Real(tk.par.d) || w[k] != Real(tk.w)) return (int)KERNEL_RUNTIME;
+        return kr;
+    };
+    segments.clear();
+    for (size_t k=0; k<size(); ) {
+        size_t end = k+1;
+        int kr = kernel_of(k);
+        while (end<size() && kernel_of(end) == kr) end++;
+        if (end-k < MIN_SEGMENT) kr = KERNEL_RUNTIME;
+        if (!segments.empty() && segments.back().kernel == kr) segments.back().end = end;
+        else segments.push_back({k, end, kr});
+        k = end;
+    }
+    classified = true;
+}
+
+template<typename Real>
+size_t BasicNeuronPopulation<Real>::typed_neurons() const {
+    size_t n = 0;
+    for (auto &sg : segments) if (sg.kernel != KERNEL_RUNTIME) n += sg.end-sg.begin;
+    return n;
+}
+
+template<typename Real>
+size_t BasicNeuronPopulation<Real>::step_range(const size_t begin, const size_t end, const Real *thal,
+                                               const Real *exc, const Real *inh, size_t *spk) {
+    Arrays<Real> p{v.data(), u.data(), I.data(), a.data(), b.data(), c.data(), d.data(), w.data()};
+    if (!classified || !use_types) return run_kernel(KERNEL_RUNTIME, p, begin, end, thal, exc, inh, spk);
+    size_t ns = 0;
+    auto sg = std::upper_bound(segments.begin(), segments.end(), begin,
+                               [] (const size_t k, const Segment &x) {return k < x.end;});
+    for (; sg!=segments.end() && sg->begin<end; ++sg)
+        ns += run_kernel(sg->kernel, p, std::max(begin, sg->begin), std::min(end, sg->end), 
+                         thal, exc, inh, spk+ns);
+    return ns;
+}
+
+template class BasicNeuronPopulation<double>;
+template class BasicNeuronPopulation<float>;
+template BasicNeuronPopulation<float>::BasicNeuronPopulation(const BasicNeuronPopulation<double>&);
@@ -0,0 +1,191 @@
+#ifndef POPULATION_H
+#define POPULATION_H
+
+#include "globals.h"
+#include "neuron.h"
+#include "storage.h"
+
+typedef ArrayStore<double> aligned_vector;
+
+/*! \class SimdDispatch
+  Selection of the vectorized kernels of \ref BasicNeuronPopulation, shared by all scalar types.
+ */
+
+class SimdDispatch {
+
+public:
+/*!
+  The kernel implementations, see \ref simd_level.
+ */
+    enum SimdLevel {SCALAR=0, AVX2=1, AVX512=2};
+/*! @name Kernel selection
+  \ref simd_level returns the kernel used by \ref BasicNeuronPopulation::step. By default it is the best one supported by the CPU,
+  \ref set_simd_level can force a lower one (a level that the CPU does not support is ignored).
+  \ref set_type_kernels enables or disables the per-type kernels (enabled by default).
+ */
+///@{
+    static SimdLevel simd_level();
+    static void set_simd_level(SimdLevel);
+    static bool type_kernels() {return use_types;}
+    static void set_type_kernels(const bool _t) {use_types = _t;}
+///@}
+
+protected:
+    static SimdLevel level;
+    static bool use_types;
+};
+
+/*! \class BasicNeuronPopulation
+  Structure-of-arrays storage of all the neurons of a \ref BasicNetwork.
+
+  Each dynamic variable (\ref v potential, \ref u recovery, \ref I input) and each parameter
+  (\ref a, \ref b, \ref c, \ref d, thalamic weight \ref w) is a contiguous aligned array with one entry per neuron
+  (an \ref ArrayStore, which can also be mapped from a \ref Snapshot file).
+  A \ref Neuron object can still be obtained (by value) with \ref neuron, or written back with \ref set.
+
+  The arrays hold values of type \p Real: \ref NeuronPopulation (double) is the reference,
+  *float* halves the memory traffic and doubles the width of the vector kernels.
+
+  The time evolution is done by \ref step, a single kernel that fuses for each neuron:
+  - the reset of firing neurons (Neuron::reset),
+  - the composition of the input from thalamic and synaptic input,
+  - the two half-steps of the potential and the update of the recovery variable (Neuron::step),
+  - the threshold test that produces the list of \ref spikes for the next step.
+
+  This kernel is vectorized with AVX-512 or AVX2 when the CPU supports it (the instruction set is detected at run time),
+  and falls back to a scalar loop otherwise. For a given \p Real, all versions perform the same floating-point operations 
+  in the same order, so their results are bit-identical.
+
+  The kernel is also instantiated once per standard type of Neuron::NeuronTypes, with the parameters of the type 
+  as compile-time constants instead of arrays. \ref classify finds the ranges of consecutive neurons 
+  which have exactly the default parameters of their type (as set by Neuron::set_default_params without noise),
+  these are stepped by the kernel of their type; the other neurons use the generic kernel. 
+  The results are the same.
+  The typed kernels therefore only apply to noise-free populations (\ref resize, Neuron::set_default_params with no noise):
+  Network::set_default_params, used for the random networks of \ref Simulation, perturbs the parameters of every neuron
+  and leaves almost no neuron to them. The number of typed neurons of a run is reported by --profile (see \ref Profiler).
+ */
+
+template<typename Real>
+class BasicNeuronPopulation : public SimdDispatch {
+
+public:
+    typedef Real value_type;
+    BasicNeuronPopulation() {}
+/*!
+  Copy of a population of another scalar type, the values are converted.
+ */
+    template<typename Other>
+    explicit BasicNeuronPopulation(const BasicNeuronPopulation<Other>&);
+/*!
+  Resizes the population, new neurons are default (*RS*) neurons at rest.
+ */
+    void resize(const size_t);
+    size_t size() const {return v.size();}
+/*!
+  Renumbers the neurons: neuron *k* of the permuted population is neuron \p order[k] of the current one (\p order is a permutation).
+ */
+    void permute(const std::vector<size_t> &order);
+/*! @name Neuron access
+  \ref neuron returns a copy of neuron \p k as a \ref Neuron object,
+  \ref set copies the parameters, type and dynamic state of a \ref Neuron into position \p k.
+ */
+///@{
+    Neuron neuron(const size_t k) const;
+    void set(const size_t k, const Neuron&);
+///@}
+    void potential(const size_t k, const double &_p) {v[k] = Real(_p); spikes_valid = false;}
+    double potential(const size_t k) const {return v[k];}
+    double recovery(const size_t k) const {return u[k];}
+    double input(const size_t k) const {return I[k];}
+    bool is_inhibitory(const size_t k) const {return inhib[k];}
+    bool is_type(const size_t k, const std::string &_t) const {return type_names[type_id[k]] == _t;}
+    const std::string& type(const size_t k) const {return type_names[type_id[k]];}
+    bool firing(const size_t k) const {return v[k] > Neuron::firing_threshold();}
+/*!
+  Indices (in increasing order) of the neurons whose potential is above the firing threshold,
+  i.e. the neurons that will be reset at the next \ref step.
+ */
+    const std::vector<size_t>& spikes();
+/*!
+  One time-step for all neurons (see the class description).
+  \param thal : thalamic input (multiplied by the weight \ref w of each neuron),
+  \param exc : excitatory synaptic input (multiplied by 0.5),
+  \param inh : inhibitory synaptic input (subtracted).
+ */
+    void step(const Real *thal, const Real *exc, const Real *inh);
+/*!
+  Same as \ref step on neurons [\p begin, \p end) only, the indices of neurons above threshold after the update
+  are written to \p spk.
+  \return the number of indices written to \p spk.
+ */
+    size_t step_range(const size_t begin, const size_t end, const Real *thal,
+                      const Real *exc, const Real *inh, size_t *spk);
+/*!
+  Replaces the list of \ref spikes after calls to \ref step_range on consecutive ranges covering all neurons:
+  \p parts[c] holds the \p counts[c] indices found in range *c*.
+ */
+    void set_spikes(const std::vector<std::vector<size_t> > &parts, const std::vector<size_t> &counts);
+/*!
+  Splits the neurons into ranges stepped by a per-type or by the generic kernel (see the class description).
+  This is done by \ref step when the parameters have changed, it must be called before \ref step_range.
+ */
+    void classify();
+    bool is_classified() const {return classified;}
+/*!
+  Number of neurons stepped by a per-type kernel.
+ */
+    size_t typed_neurons() const;
+/*!
+  Update of one neuron, in the order of Neuron::reset, Neuron::input and Neuron::step:
+  this is the reference arithmetic of all the kernels.
+  \return true if the neuron is above the firing threshold \p th after the update.
+ */
+    static bool update(Real &v, Real &u, Real &I, const Real a, const Real b,
+                       const Real c, const Real d, const Real w,
+                       const Real thal, const Real exc, const Real inh, const Real th) {
+        const Real half(0.5), c004(0.04), c5(5), c140(140);
+        if (v > th) {
+            v = c;
+            u += d;
+        }
+        I = w*thal + half*exc - inh;
+        v += half*(c004*v*v+c5*v+c140-u+I);
+        v += half*(c004*v*v+c5*v+c140-u+I);
+        u += a*(b*v-u);
+        return v > th;
+    }
+
+private:
+/*! @name Dynamic variables */
+///@{
+    ArrayStore<Real> v, u, I;
+///@}
+/*! @name Neuron parameters */
+///@{
+    ArrayStore<Real> a, b, c, d, w;
+    ArrayStore<char> inhib;
+///@}
+/*! @name Neuron types
+  \ref type_id indexes the list of names \ref type_names.
+ */
+///@{
+    ArrayStore<unsigned char> type_id;
+    std::vector<std::string> type_names;
+///@}
+    std::vector<size_t> spike_list;
+    bool spikes_valid = false;
+/*!
+  Consecutive ranges [\p begin, \p end) of neurons with the same \p kernel (0 for the generic kernel), see \ref classify.
+ */
+    struct Segment {size_t begin, end; int kernel;};
+    std::vector<Segment> segments;
+    bool classified = false;
+    template<typename> friend class BasicNeuronPopulation;
+    friend class Snapshot;
+    friend class TrialBatch;
+};
+
+typedef BasicNeuronPopulation<double> NeuronPopulation;
+
+#endif //POPULATION_H
@@ -0,0 +1,111 @@
+#include "profiler.h"
+#include <cstring>
+#include <sys/resource.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+const char *PHASE_NAMES[Profiler::NUM_PHASES] = {"thalamic_noise", "synaptic_input", "neuron_update", "network_step",
+                                                 "record", "raster_output", "trajectory_output", "writer_stall",
+                                                 "spike_exchange"};
+const char *COUNTER_NAMES[] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+
+}
+
+Profiler::Profiler() {
+    open_counters(0, true);
+}
+
+Profiler::~Profiler() {
+    for (auto fd : counter_fd)
+        if (fd >= 0) close(fd);
+}
+
+void Profiler::open_counters(const long tid, const bool inherit) {
+#ifdef __linux__
+    const uint64_t config[NUM_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                           PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    for (int k=0; k<NUM_COUNTERS; k++) {
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = config[k];
+        attr.disabled = 1;
+        attr.inherit = inherit;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        counter_fd.push_back(tid >= 0 ? syscall(__NR_perf_event_open, &attr, tid, -1, -1, 0) : -1);
+    }
+#else
+    for (int k=0; k<NUM_COUNTERS; k++) counter_fd.push_back(-1);
+#endif
+}
+
+void Profiler::add_thread(const long tid) {
+// --- an unknown thread (id 0 would be the calling thread) leaves the counters incomplete
+    open_counters(tid > 0 ? tid : -1, false);
+}
+
+void Profiler::start() {
+#ifdef __linux__
+    for (auto fd : counter_fd)
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    start_time = clock::now();
+}
+
+void Profiler::stop() {
+    wall_time = seconds_since(start_time);
+#ifdef __linux__
+    counters_read = true;
+    for (int k=0; k<NUM_COUNTERS; k++) counter_value[k] = 0;
+    for (size_t j=0; j<counter_fd.size(); j++) {
+        uint64_t val = 0;
+        if (counter_fd[j] < 0) {
+            counters_read = false;
+            continue;
+        }
+        ioctl(counter_fd[j], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(counter_fd[j], &val, sizeof(uint64_t)) != sizeof(uint64_t)) counters_read = false;
+        counter_value[j % NUM_COUNTERS] += val;
+    }
+#endif
+}
+
+long Profiler::peak_memory() {
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+    return ru.ru_maxrss;
+}
+
+void Profiler::write_json(std::ostream *_out) const {
+    double steps_rate = wall_time>0 ? num_steps/wall_time : 0;
+    (*_out) << "{\n  \"steps\": " << num_steps
+            << ",\n  \"wall_seconds\": " << wall_time
+            << ",\n  \"steps_per_second\": " << steps_rate
+            << ",\n  \"spikes_per_step\": " << (num_steps ? (double)num_spikes/num_steps : 0)
+            << ",\n  \"synaptic_events_per_second\": " << (wall_time>0 ? num_events/wall_time : 0)
+            << ",\n  \"neurons\": " << num_neurons
+            << ",\n  \"typed_neurons\": " << num_typed
+            << ",\n  \"peak_rss_kib\": " << peak_memory()
+            << ",\n  \"phase_seconds\": {";
+    for (int p=0; p<NUM_PHASES; p++)
+        (*_out) << (p ? ", " : "") << "\"" << PHASE_NAMES[p] << "\": " << phase_time[p];
+    (*_out) << "},\n  \"hardware_counters\": ";
+    if (counters_read) {
+        (*_out) << "{";
+        for (int k=0; k<NUM_COUNTERS; k++)
+            (*_out) << (k ? ", " : "") << "\"" << COUNTER_NAMES[k] << "\": " << counter_value[k];
+        (*_out) << "}";
+    } else (*_out) << "null";
+    (*_out) << "\n}" << std::endl;
+}
@@ -0,0 +1,98 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "globals.h"
+#include <chrono>
+#include <vector>
+
+/*! \class Profiler
+  Collects the performance figures of a simulation run (option --profile of \ref Simulation) and writes them as JSON.
+
+  The time spent in each \ref Phase is measured with a steady clock and accumulated with \ref add.
+  The phases of \ref Network::step (thalamic noise, synaptic input, neuron update) are timed per parallel chunk, 
+  their sum is a thread time which can exceed the wall time with several threads.
+  The output phases run on the writer thread (see \ref OutputWriter), concurrently with the simulation.
+  In a run split between the ranks of a \ref RankGroup, each rank profiles its own part and rank 0 writes the report:
+  the spikes and synaptic events are the totals of all ranks (see \ref set_counts), the times and counters those of rank 0,
+  the time of the spike exchange includes the wait for the other ranks.
+  The report also gives the number of neurons stepped by the kernels of their type (see NeuronPopulation::classify).
+
+  Where `perf_event_open` is available (Linux), hardware counters (cycles, instructions, cache and branch misses)
+  are also read between \ref start and \ref stop, for the calling thread and the threads it creates afterwards.
+  Threads which already exist, such as the workers of the ThreadPool of the network, are counted with \ref add_thread 
+  (called by Network::set_profiler). The counters are not reported if one of them could not be opened.
+ */
+
+class Profiler {
+
+public:
+    typedef std::chrono::steady_clock clock;
+    enum Phase {NOISE, INPUT, UPDATE, NETWORK_STEP, RECORD, RASTER, TRAJ, WRITER_STALL, EXCHANGE, NUM_PHASES};
+    Profiler();
+    ~Profiler();
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+/*!
+  Start and end of the profiled run (wall time and hardware counters).
+ */
+///@{
+    void start();
+    void stop();
+///@}
+    void add(const Phase p, const double seconds) {phase_time[p] += seconds;}
+/*!
+  Adds the hardware counters of the existing thread \p tid (a system thread id, see ThreadPool::thread_ids), before \ref start.
+ */
+    void add_thread(const long tid);
+    static double seconds_since(const clock::time_point &t) {
+        return std::chrono::duration<double>(clock::now()-t).count();
+    }
+/*!
+  Counts one time-step with \p spikes firing neurons and \p events synaptic transmissions.
+ */
+    void count_step(const size_t spikes, const size_t events) {
+        num_steps++;
+        num_spikes += spikes;
+        num_events += events;
+    }
+/*!
+  Records that \p typed of the \p n neurons are stepped by the kernel of their type (see NeuronPopulation::classify).
+ */
+    void count_neurons(const size_t n, const size_t typed) {
+        num_neurons = n;
+        num_typed = typed;
+    }
+    double time(const Phase p) const {return phase_time[p];}
+    size_t steps() const {return num_steps;}
+    size_t spikes() const {return num_spikes;}
+    size_t events() const {return num_events;}
+/*!
+  Replaces the spike and synaptic event counts, with the totals of all ranks in a run split by a \ref RankGroup.
+ */
+    void set_counts(const size_t spikes, const size_t events) {
+        num_spikes = spikes;
+        num_events = events;
+    }
+/*!
+  Peak resident memory of the process in KiB.
+ */
+    static long peak_memory();
+    void write_json(std::ostream *_out) const;
+
+private:
+    enum {NUM_COUNTERS = 4};
+    double phase_time[NUM_PHASES] = {};
+    double wall_time = 0;
+    size_t num_steps = 0, num_spikes = 0, num_events = 0, num_neurons = 0, num_typed = 0;
+    clock::time_point start_time;
+/*!
+  Descriptors of the counters: \ref NUM_COUNTERS for the calling thread (inherited by its new threads), then as many per added thread.
+ */
+    std::vector<int> counter_fd;
+    uint64_t counter_value[NUM_COUNTERS] = {};
+    bool counters_read = false;
+    void open_counters(const long tid, const bool inherit);
+
+};
+
+#endif //PROFILER_H
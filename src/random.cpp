@@ -1,62 +1,276 @@
 #include "random.h"
+#include <cmath>
 
-using namespace std;
-
-RandomNumbers :: RandomNumbers(unsigned long int s){
-		if(s == 0){
-			seed = random_device()();
-		}else{
-		seed = s;
-		rng = std::mt19937(seed);
-	}}
-
-void RandomNumbers ::  uniform_double(std::vector<double>& vecteur, double lower, double upper){
-	
-for(auto&  coord :  vecteur ){
-	coord = uniform_double(lower, upper);
-}	
-	
-	};
-  
-  
-  
-double RandomNumbers :: uniform_double(double lower, double upper){
-	
-	
-	uniform_real_distribution <double> u_distrib  (lower,upper);
-	
-	return u_distrib(rng);
-	
-	};
-
-
-
-void RandomNumbers :: normal(std::vector<double>& vecteur, double mean, double sd){
-	
-	for(auto&  coord :  vecteur ){
-	coord = normal(mean, sd);
-}	
-	
-	};
-
-
-double RandomNumbers :: normal(double mean, double sd){
-	normal_distribution <double> n_distrib (mean, sd);
-	return n_distrib(rng);
-	};
-
-
-void RandomNumbers :: poisson(std::vector<int>& vecteur, double mean){
-	
-	for(auto&  coord :  vecteur ){
-	coord = poisson(mean);
-}	
-	
-	};
-
-
-int RandomNumbers :: poisson(double mean){
-	
-	poisson_distribution<int> p_distrib (mean);
-	return p_distrib(rng);
-	};
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define _RNG_X86_ 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/// * Philox4x32 constants *
+const uint32_t PHILOX_M0 = 0xD2511F53, PHILOX_M1 = 0xCD9E8D57;
+const uint32_t PHILOX_W0 = 0x9E3779B9, PHILOX_W1 = 0xBB67AE85;
+const int PHILOX_ROUNDS = 10;
+const size_t TILE = 64;
+
+/// * counter layout: (index bits 0-31, stream | index bits 32-39 | attempt, step low, step high) *
+inline uint32_t counter_word1(const uint64_t index, const int stream, const uint32_t attempt) {
+    return (uint32_t)stream | (uint32_t)((index>>32) & 0xff)<<8 | attempt<<16;
+}
+
+inline void philox(uint32_t c[4], uint32_t k0, uint32_t k1) {
+    for (int r=0; r<PHILOX_ROUNDS; r++) {
+        uint64_t p0 = (uint64_t)PHILOX_M0*c[0], p1 = (uint64_t)PHILOX_M1*c[2];
+        uint32_t n0 = (uint32_t)(p1>>32)^c[1]^k0, n2 = (uint32_t)(p0>>32)^c[3]^k1;
+        c[1] = (uint32_t)p1;
+        c[3] = (uint32_t)p0;
+        c[0] = n0;
+        c[2] = n2;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+}
+
+struct Block {uint64_t lo, hi;};
+
+inline Block philox_block(const uint64_t seed, const uint64_t index, const uint64_t step,
+                          const int stream, const uint32_t attempt=0) {
+    uint32_t c[4] = {(uint32_t)index, counter_word1(index, stream, attempt),
+                     (uint32_t)step, (uint32_t)(step>>32)};
+    philox(c, (uint32_t)seed, (uint32_t)(seed>>32));
+    return {c[0] | (uint64_t)c[1]<<32, c[2] | (uint64_t)c[3]<<32};
+}
+
+/// * uniform in [0,1) and (0,1] from the 53 high bits *
+const double TWO_M53 = 1.0/(UINT64_C(1)<<53);
+inline double unit_closed_open(const uint64_t x) {return (x>>11)*TWO_M53;}
+inline double unit_open_closed(const uint64_t x) {return ((x>>11)+1)*TWO_M53;}
+
+inline double box_muller(const uint64_t x, const uint64_t y) {
+    return std::sqrt(-2.0*std::log(unit_open_closed(x)))*std::cos(2*M_PI*unit_closed_open(y));
+}
+
+void blocks_scalar(Block *out, const uint64_t seed, const uint64_t first, const size_t n,
+                   const uint64_t step, const int stream) {
+    for (size_t j=0; j<n; j++) out[j] = philox_block(seed, first+j, step, stream);
+}
+
+#ifdef _RNG_X86_
+__attribute__((target("avx2")))
+void blocks_avx2(Block *out, const uint64_t seed, const uint64_t first, const size_t n,
+                 const uint64_t step, const int stream) {
+    const __m256i mask = _mm256_set1_epi64x(0xffffffff), m0 = _mm256_set1_epi64x(PHILOX_M0),
+        m1 = _mm256_set1_epi64x(PHILOX_M1), lane = _mm256_setr_epi64x(0, 1, 2, 3),
+        w1 = _mm256_set1_epi64x(counter_word1(0, stream, 0));
+    size_t j = 0;
+    for (; j+4<=n; j+=4) {
+        __m256i idx = _mm256_add_epi64(_mm256_set1_epi64x(first+j), lane);
+        __m256i c0 = _mm256_and_si256(idx, mask),
+            c1 = _mm256_or_si256(w1, _mm256_slli_epi64(_mm256_and_si256(_mm256_srli_epi64(idx, 32),
+                                                                         _mm256_set1_epi64x(0xff)), 8)),
+            c2 = _mm256_set1_epi64x((uint32_t)step), c3 = _mm256_set1_epi64x((uint32_t)(step>>32));
+        uint32_t k0 = (uint32_t)seed, k1 = (uint32_t)(seed>>32);
+        for (int r=0; r<PHILOX_ROUNDS; r++) {
+            __m256i p0 = _mm256_mul_epu32(c0, m0), p1 = _mm256_mul_epu32(c2, m1);
+            c0 = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p1, 32), c1), _mm256_set1_epi64x(k0));
+            c2 = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p0, 32), c3), _mm256_set1_epi64x(k1));
+            c1 = _mm256_and_si256(p1, mask);
+            c3 = _mm256_and_si256(p0, mask);
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+        __m256i lo = _mm256_or_si256(c0, _mm256_slli_epi64(c1, 32)),
+            hi = _mm256_or_si256(c2, _mm256_slli_epi64(c3, 32));
+        __m256i t0 = _mm256_unpacklo_epi64(lo, hi), t1 = _mm256_unpackhi_epi64(lo, hi);
+        _mm256_storeu_si256((__m256i*)(out+j), _mm256_permute2x128_si256(t0, t1, 0x20));
+        _mm256_storeu_si256((__m256i*)(out+j+2), _mm256_permute2x128_si256(t0, t1, 0x31));
+    }
+    blocks_scalar(out+j, seed, first+j, n-j, step, stream);
+}
+
+// GCC 12 warns about the undefined source operand used inside some AVX-512 intrinsics (GCC bug 105593)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+__attribute__((target("avx512f")))
+void blocks_avx512(Block *out, const uint64_t seed, const uint64_t first, const size_t n,
+                   const uint64_t step, const int stream) {
+    const __m512i mask = _mm512_set1_epi64(0xffffffff), m0 = _mm512_set1_epi64(PHILOX_M0),
+        m1 = _mm512_set1_epi64(PHILOX_M1), lane = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7),
+        w1 = _mm512_set1_epi64(counter_word1(0, stream, 0)),
+        perm_lo = _mm512_setr_epi64(0, 8, 1, 9, 2, 10, 3, 11),
+        perm_hi = _mm512_setr_epi64(4, 12, 5, 13, 6, 14, 7, 15);
+    size_t j = 0;
+    for (; j+8<=n; j+=8) {
+        __m512i idx = _mm512_add_epi64(_mm512_set1_epi64(first+j), lane);
+        __m512i c0 = _mm512_and_si512(idx, mask),
+            c1 = _mm512_or_si512(w1, _mm512_slli_epi64(_mm512_and_si512(_mm512_srli_epi64(idx, 32),
+                                                                         _mm512_set1_epi64(0xff)), 8)),
+            c2 = _mm512_set1_epi64((uint32_t)step), c3 = _mm512_set1_epi64((uint32_t)(step>>32));
+        uint32_t k0 = (uint32_t)seed, k1 = (uint32_t)(seed>>32);
+        for (int r=0; r<PHILOX_ROUNDS; r++) {
+            __m512i p0 = _mm512_mul_epu32(c0, m0), p1 = _mm512_mul_epu32(c2, m1);
+            c0 = _mm512_xor_si512(_mm512_xor_si512(_mm512_srli_epi64(p1, 32), c1), _mm512_set1_epi64(k0));
+            c2 = _mm512_xor_si512(_mm512_xor_si512(_mm512_srli_epi64(p0, 32), c3), _mm512_set1_epi64(k1));
+            c1 = _mm512_and_si512(p1, mask);
+            c3 = _mm512_and_si512(p0, mask);
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+        __m512i lo = _mm512_or_si512(c0, _mm512_slli_epi64(c1, 32)),
+            hi = _mm512_or_si512(c2, _mm512_slli_epi64(c3, 32));
+        _mm512_storeu_si512((void*)(out+j), _mm512_permutex2var_epi64(lo, perm_lo, hi));
+        _mm512_storeu_si512((void*)(out+j+4), _mm512_permutex2var_epi64(lo, perm_hi, hi));
+    }
+    blocks_scalar(out+j, seed, first+j, n-j, step, stream);
+}
+#pragma GCC diagnostic pop
+#endif
+
+typedef void (*blocks_fn)(Block*, const uint64_t, const uint64_t, const size_t, const uint64_t, const int);
+
+blocks_fn best_blocks() {
+#ifdef _RNG_X86_
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return blocks_avx512;
+    if (__builtin_cpu_supports("avx2")) return blocks_avx2;
+#endif
+    return blocks_scalar;
+}
+
+const blocks_fn philox_blocks = best_blocks();
+
+template<typename Real>
+void fill_uniform(Real *out, const uint64_t seed, const size_t first, const size_t n, const uint64_t step,
+                  const int stream, const double lower, const double upper) {
+    Block tile[TILE];
+    for (size_t j=0; j<n; j+=TILE) {
+        size_t m = std::min(TILE, n-j);
+        philox_blocks(tile, seed, first+j, m, step, stream);
+        for (size_t i=0; i<m; i++) out[j+i] = lower + (upper-lower)*unit_closed_open(tile[i].lo);
+    }
+}
+
+template<typename Real>
+void fill_normal(Real *out, const uint64_t seed, const size_t first, const size_t n, const uint64_t step,
+                 const int stream, const double mean, const double sd) {
+    Block tile[TILE];
+    for (size_t j=0; j<n; j+=TILE) {
+        size_t m = std::min(TILE, n-j);
+        philox_blocks(tile, seed, first+j, m, step, stream);
+        for (size_t i=0; i<m; i++) out[j+i] = mean + sd*box_muller(tile[i].lo, tile[i].hi);
+    }
+}
+
+/*
+  Poisson variate from a source of uniforms in [0,1):
+  inversion by sequential search for small means,
+  transformed rejection with squeeze (PTRS, Hormann 1993) for larger ones.
+ */
+template<typename UniformSource>
+int poisson_draw(const double mean, UniformSource &unif) {
+    if (mean <= 0) return 0;
+    if (mean < 10) {
+        double u = unif(), p = std::exp(-mean), F = p;
+        int k = 0;
+        while (u > F && k < 1000) {
+            k++;
+            p *= mean/k;
+            F += p;
+        }
+        return k;
+    }
+    const double slam = std::sqrt(mean), loglam = std::log(mean),
+        b = 0.931 + 2.53*slam, a = -0.059 + 0.02483*b,
+        invalpha = 1.1239 + 1.1328/(b-3.4), vr = 0.9277 - 3.6224/(b-2);
+    while (true) {
+        double U = unif()-0.5, V = unif(), us = 0.5-std::abs(U);
+        double k = std::floor((2*a/us + b)*U + mean + 0.43);
+        if (us >= 0.07 && V <= vr) return (int)k;
+        if (k < 0 || (us < 0.013 && V > us)) continue;
+        if (std::log(V) + std::log(invalpha) - std::log(a/(us*us)+b) <= -mean + k*loglam - std::lgamma(k+1))
+            return (int)k;
+    }
+}
+
+}
+
+RandomNumbers::RandomNumbers(unsigned long int s) : seed(s) {
+    if (seed == 0) seed = std::random_device()();
+}
+
+RandomNumbers::result_type RandomNumbers::operator()() {
+    uint64_t k = counter++;
+    Block B = philox_block(seed, (k>>1) & 0xffffffffff, k>>41, SEQUENTIAL);
+    return (k & 1) ? B.hi : B.lo;
+}
+
+void RandomNumbers::uniform_double(std::vector<double> &vec, double lower, double upper) {
+    for (auto &x : vec) x = uniform_double(lower, upper);
+}
+
+double RandomNumbers::uniform_double(double lower, double upper) {
+    return lower + (upper-lower)*unit_closed_open((*this)());
+}
+
+void RandomNumbers::normal(std::vector<double> &vec, double mean, double sd) {
+    for (auto &x : vec) x = normal(mean, sd);
+}
+
+double RandomNumbers::normal(double mean, double sd) {
+    uint64_t x = (*this)(), y = (*this)();
+    return mean + sd*box_muller(x, y);
+}
+
+void RandomNumbers::poisson(std::vector<int> &vec, double mean) {
+    for (auto &x : vec) x = poisson(mean);
+}
+
+int RandomNumbers::poisson(double mean) {
+    auto unif = [this] () {return unit_closed_open((*this)());};
+    return poisson_draw(mean, unif);
+}
+
+void RandomNumbers::uniform_double(double *out, const size_t first, const size_t n, const uint64_t step,
+                                   const Stream stream, double lower, double upper) const {
+    fill_uniform(out, seed, first, n, step, stream, lower, upper);
+}
+
+void RandomNumbers::uniform_double(float *out, const size_t first, const size_t n, const uint64_t step,
+                                   const Stream stream, double lower, double upper) const {
+    fill_uniform(out, seed, first, n, step, stream, lower, upper);
+}
+
+void RandomNumbers::normal(double *out, const size_t first, const size_t n, const uint64_t step,
+                           const Stream stream, double mean, double sd) const {
+    fill_normal(out, seed, first, n, step, stream, mean, sd);
+}
+
+void RandomNumbers::normal(float *out, const size_t first, const size_t n, const uint64_t step,
+                           const Stream stream, double mean, double sd) const {
+    fill_normal(out, seed, first, n, step, stream, mean, sd);
+}
+
+void RandomNumbers::poisson(int *out, const size_t first, const size_t n, const uint64_t step,
+                            const Stream stream, double mean) const {
+    Block tile[TILE];
+    for (size_t j=0; j<n; j+=TILE) {
+        size_t m = std::min(TILE, n-j);
+        philox_blocks(tile, seed, first+j, m, step, stream);
+        for (size_t i=0; i<m; i++) {
+// --- the first two uniforms come from the tile, further ones from the next attempts of the same counter
+            uint64_t idx = first+j+i;
+            Block B = tile[i];
+            uint32_t attempt = 0;
+            int half = 0;
+            auto unif = [&] () {
+                if (half == 2) {
+                    B = philox_block(seed, idx, step, stream, ++attempt);
+                    half = 0;
+                }
+                return unit_closed_open(half++ ? B.hi : B.lo);
+            };
+            out[j+i] = poisson_draw(mean, unif);
+        }
+    }
+}
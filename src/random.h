@@ -1,9 +1,20 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
 #include <random>
 #include <vector>
 #include <algorithm>
+#include <cstdint>
 
 /*! \class RandomNumbers
-  This is a random number class based on standard c++-11 generators.
+  This is a random number class based on a counter-based generator, *Philox4x32-10*
+  (Salmon et al., Parallel random numbers: as easy as 1, 2, 3, SC 2011).
+
+  A random block of 128 bits is a pure function of a key (the \ref seed) and a counter.
+  Sequential draws use an internal counter which is incremented at each draw.
+  *Stream* draws are indexed by a (stream, step, index) triplet instead,
+  for instance the thalamic input of neuron *n* at time-step *t*:
+  they can be computed for any element independently, on any thread, in any order, with identical results.
 
   This headers declares the global variable \ref main.cpp "_RNG", a pointer to the unique instance of this class.
  */
@@ -12,18 +23,24 @@ class RandomNumbers {
 
 public:
 /*! @name Initializing
-  The generator \ref rng is a Mersenne twister *mt19937* engine. 
+  The key of the generator is the \ref seed.
 
   A seed *s>0* can be provided, by default it is seeded with a *random_device*.
  */
 ///@{
     RandomNumbers(unsigned long int s=0);
+    unsigned long int get_seed() const {return seed;}
+/*!
+  Position of the sequential counter, can be saved and restored to resume the sequence of draws.
+ */
+    uint64_t position() const {return counter;}
+    void position(const uint64_t &_c) {counter = _c;}
 ///@}
 
 /*! @name Distributions
-  These functions either return a single number 
-  or fill a given vector with random numbers distributed 
-  according the specified distributions. 
+  These functions either return a single number
+  or fill a given vector with random numbers distributed
+  according the specified distributions.
 
   The additional parameters are the standard parameters of these distributions.
  */
@@ -35,17 +52,47 @@ public:
     void poisson(std::vector<int>&, double mean=1);
     int poisson(double mean=1);
 ///@}
+
+/*! @name Streams
+  Counter-based draws for elements [\p first, \p first + \p n) of a \ref Stream at time-step \p step.
+  The value of element *k* only depends on (\ref seed, stream, \p step, *k*):
+  a range can be split in any way between threads without changing the values.
+  The random bits are produced by a loop over blocks that is vectorized (AVX2 or AVX-512, selected at run time).
+  The *float* versions round the double precision values, for single precision networks.
+ */
+///@{
+    enum Stream {SEQUENTIAL=0, THALAMIC=1, CONNECT=2, STRENGTH=3, DEGREE=4, PARAMS=5, DELAY=6, RECORD=7};
+    void uniform_double(double*, const size_t first, const size_t n, const uint64_t step,
+                        const Stream, double lower=0, double upper=1) const;
+    void uniform_double(float*, const size_t first, const size_t n, const uint64_t step,
+                        const Stream, double lower=0, double upper=1) const;
+    void normal(double*, const size_t first, const size_t n, const uint64_t step,
+                const Stream, double mean=0, double sd=1) const;
+    void normal(float*, const size_t first, const size_t n, const uint64_t step,
+                const Stream, double mean=0, double sd=1) const;
+    void poisson(int*, const size_t first, const size_t n, const uint64_t step,
+                 const Stream, double mean=1) const;
+///@}
+
 /*! @name Auxiliary function
   This takes a vector of indices and re-orders it randomly.
+  The class also satisfies the *UniformRandomBitGenerator* requirements (with the sequential counter),
+  so that it can be used with standard algorithms.
  */
 ///@{
-    void shuffle(std::vector<size_t> &_v) {std::shuffle(_v.begin(), _v.end(), rng);}
+    void shuffle(std::vector<size_t> &_v) {std::shuffle(_v.begin(), _v.end(), *this);}
+    typedef uint64_t result_type;
+    static constexpr result_type min() {return 0;}
+    static constexpr result_type max() {return UINT64_MAX;}
+    result_type operator()();
 ///@}
-     
+
 private:
-    std::mt19937 rng;
-    long int seed;
+    uint64_t seed;
+    uint64_t counter = 0;
 
 };
 
 extern RandomNumbers* _RNG;
+
+#endif //RANDOM_H
@@ -0,0 +1,175 @@
+#include "ranks.h"
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <cstdio>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+  Lock-free atomics are address-free, they work in memory shared by processes.
+ */
+struct RankGroup::Control {
+    std::atomic<int> arrived, generation, aborted;
+};
+
+namespace {
+
+/// * a waiting rank checks every this number of milliseconds that the other processes are still running *
+const long POLL_MS = 200;
+/// * number of checks of a barrier before a waiting rank yields the processor *
+const int SPINS = 4000;
+
+}
+
+RankGroup::RankGroup(const int n) : num_ranks(std::max(n, 1)), parent(getpid()) {
+// --- the control block is followed by the partial sums of each rank (see sum)
+    control_bytes = (sizeof(Control)+63)/64*64 + num_ranks*SUM_SLOTS*sizeof(uint64_t);
+    void *p = mmap(nullptr, control_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) throw(RANK_ERROR("Cannot map the shared memory of the ranks"));
+    control = new (p) Control;
+    partials = reinterpret_cast<uint64_t*>(static_cast<char*>(p) + (sizeof(Control)+63)/64*64);
+    control->arrived = 0;
+    control->generation = 0;
+    control->aborted = 0;
+// --- the file is created before the fork so that all ranks share it, it is sized later by allocate
+    memfd = syscall(SYS_memfd_create, "NeuronNet_ranks", 0);
+    if (memfd < 0) throw(RANK_ERROR("Cannot create the shared memory of the ranks"));
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+    for (int r=1; r<num_ranks; r++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            abort();
+            for (auto child : children) waitpid(child, nullptr, 0);
+            throw(RANK_ERROR("Cannot start rank " + std::to_string(r)));
+        }
+        if (pid == 0) {
+            my_rank = r;
+            children.clear();
+            return;
+        }
+        children.push_back(pid);
+    }
+    statuses.assign(children.size(), -1);
+}
+
+RankGroup::~RankGroup() {
+    if (!finished) {
+        abort();
+        for (size_t k=0; k<children.size(); k++)
+            if (statuses[k] < 0) waitpid(children[k], &statuses[k], 0);
+    }
+    if (mapping) munmap(mapping, mapped_bytes);
+    if (memfd >= 0) close(memfd);
+    if (control) munmap(control, control_bytes);
+}
+
+std::pair<size_t, size_t> RankGroup::slice(const size_t n, int r) const {
+    if (r < 0) r = my_rank;
+    return {r*n/num_ranks, (r+1)*n/num_ranks};
+}
+
+void RankGroup::allocate(const size_t _n, const size_t _m) {
+    if (mapping) munmap(mapping, mapped_bytes);
+    mapping = nullptr;
+    num_neurons = _n;
+    num_values = _m;
+    mapped_bytes = 2*(num_ranks+num_neurons)*sizeof(uint64_t) + 2*num_values*sizeof(double);
+// --- every rank extends the file to the same size before mapping it, the content is kept
+    if (ftruncate(memfd, mapped_bytes) != 0) throw(RANK_ERROR("Cannot size the shared memory of the ranks"));
+    void *p = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (p == MAP_FAILED) throw(RANK_ERROR("Cannot map the shared memory of the ranks"));
+    mapping = p;
+    counts = static_cast<uint64_t*>(mapping);
+    spikes = counts + 2*num_ranks;
+    values = reinterpret_cast<double*>(spikes + 2*num_neurons);
+    parity = 0;
+}
+
+void RankGroup::exchange(const std::vector<size_t> &local, std::vector<size_t> &all) {
+    const std::pair<size_t, size_t> own = slice(num_neurons);
+    if (local.size() > own.second-own.first) throw(RANK_ERROR("Too many firing neurons in the slice of a rank"));
+    uint64_t *cnt = counts + parity*num_ranks, *spk = spikes + parity*num_neurons;
+    cnt[my_rank] = local.size();
+    std::copy(local.begin(), local.end(), spk+own.first);
+    barrier();
+    all.clear();
+    for (int r=0; r<num_ranks; r++) {
+        const uint64_t *first = spk + slice(num_neurons, r).first;
+        all.insert(all.end(), first, first+cnt[r]);
+    }
+    parity ^= 1;
+}
+
+void RankGroup::sum(uint64_t *vals, const size_t m) {
+    if (m > SUM_SLOTS) throw(RANK_ERROR("Too many values to sum between the ranks"));
+    std::copy(vals, vals+m, partials+my_rank*SUM_SLOTS);
+    barrier();
+    for (size_t k=0; k<m; k++) {
+        vals[k] = 0;
+        for (int r=0; r<num_ranks; r++) vals[k] += partials[r*SUM_SLOTS+k];
+    }
+// --- nobody writes the partial sums again before all ranks have read them
+    barrier();
+}
+
+double* RankGroup::send_values() {
+    return values + parity*num_values;
+}
+
+const double* RankGroup::received_values() const {
+    return values + (parity^1)*num_values;
+}
+
+void RankGroup::barrier() {
+// --- the last rank to arrive resets the counter before it opens the barrier, so that the next one starts from 0
+    const int gen = control->generation.load(std::memory_order_acquire);
+    if (control->arrived.fetch_add(1, std::memory_order_acq_rel) == num_ranks-1) {
+        control->arrived.store(0, std::memory_order_relaxed);
+        control->generation.store(gen+1, std::memory_order_release);
+        return;
+    }
+    typedef std::chrono::steady_clock clock;
+    clock::time_point next_poll = clock::now() + std::chrono::milliseconds(POLL_MS);
+    for (int spins=0; control->generation.load(std::memory_order_acquire) == gen; spins++) {
+        if (control->aborted.load(std::memory_order_relaxed)) 
+            throw(RANK_ERROR("Rank " + std::to_string(my_rank) + ": the run was aborted by another rank"));
+        if (spins < SPINS) continue;
+        sched_yield();
+        if (clock::now() < next_poll) continue;
+// --- a process which has ended after the barrier opened has not failed
+        if (!peers_alive() && control->generation.load(std::memory_order_acquire) == gen) abort();
+        next_poll = clock::now() + std::chrono::milliseconds(POLL_MS);
+    }
+}
+
+bool RankGroup::peers_alive() {
+    if (my_rank) return getppid() == parent;
+// --- any process which ends before rank 0 has failed, its status is kept for finish
+    bool alive = true;
+    for (size_t k=0; k<children.size(); k++) {
+        int status;
+        if (statuses[k] < 0 && waitpid(children[k], &status, WNOHANG) == children[k]) statuses[k] = status;
+        if (statuses[k] >= 0) alive = false;
+    }
+    return alive;
+}
+
+void RankGroup::abort() {
+    control->aborted.store(1, std::memory_order_relaxed);
+}
+
+void RankGroup::finish() {
+    finished = true;
+    std::string failed;
+    for (size_t k=0; k<children.size(); k++) {
+        if (statuses[k] < 0) waitpid(children[k], &statuses[k], 0);
+        if (!WIFEXITED(statuses[k]) || WEXITSTATUS(statuses[k]) != 0) failed += " " + std::to_string(k+1);
+    }
+    if (failed.size()) throw(RANK_ERROR("Ranks failed:" + failed));
+}
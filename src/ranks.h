@@ -0,0 +1,104 @@
+#ifndef RANKS_H
+#define RANKS_H
+
+#include "globals.h"
+#include <sys/types.h>
+
+/*! \class RankGroup
+  A group of local processes (*ranks*) which run one simulation together (option --ranks of \ref Simulation).
+  Each rank owns a consecutive \ref slice of the neurons, with their incoming links (see Network::set_slice),
+  so that the links of the network are split between the processes.
+
+  The constructor forks the current process: it returns in each process of the group with its \ref rank,
+  rank 0 being the original process. It must be called before any thread is created.
+
+  The ranks communicate through a shared memory file (*memfd*) sized by \ref allocate:
+  at each time-step, \ref exchange writes the firing neurons of the slice at its place in a shared array of one entry per neuron,
+  waits for the other ranks at a \ref barrier, then reads the firing neurons of all slices, which are in increasing order.
+  The arrays are used alternately at even and odd steps, so that one barrier per step suffices.
+  The values (for instance the trajectories of recorded neurons) written in \ref send_values by their owners 
+  are read in \ref received_values after the exchange.
+
+  The barrier is a counter and a generation number, atomics shared by the processes: a waiting rank checks the generation, 
+  then yields the processor after a while. No lock is held, so that a process which ends does not block the others. 
+  If a rank fails, it \ref abort "aborts" the group
+  (this is done by the destructor of an unfinished group): the ranks waiting at a barrier then throw a RANK_ERROR instead of waiting forever.
+  Rank 0 also aborts the group if a process ends while it waits, a rank whose parent process has ended aborts too.
+ */
+
+class RankGroup {
+
+public:
+/*!
+  Forks \p n - 1 processes, which form a group of \p n ranks with the calling process.
+ */
+    RankGroup(const int n);
+    ~RankGroup();
+    RankGroup(const RankGroup&) = delete;
+    RankGroup& operator=(const RankGroup&) = delete;
+    int rank() const {return my_rank;}
+    int size() const {return num_ranks;}
+/*!
+  Neurons [first, second) of a network of \p n neurons owned by rank \p r (this rank by default).
+ */
+    std::pair<size_t, size_t> slice(const size_t n, int r=-1) const;
+/*!
+  Sizes the shared arrays for a network of \p num_neurons and \p num_values shared values per step,
+  called by all ranks with the same sizes before the first \ref exchange.
+ */
+    void allocate(const size_t num_neurons, const size_t num_values=0);
+/*!
+  Shares the firing neurons \p local of the slice of this rank (in increasing order) and the values written in \ref send_values, 
+  \p all is replaced by the firing neurons of all ranks, in increasing order.
+ */
+    void exchange(const std::vector<size_t> &local, std::vector<size_t> &all);
+/*!
+  Replaces the \p m values of \p vals (at most \ref SUM_SLOTS) by their sums over all ranks, called by all ranks together
+  (for instance the spike and event counts of the Profiler of each rank at the end of a run).
+ */
+    void sum(uint64_t *vals, const size_t m);
+    static const size_t SUM_SLOTS = 4;
+/*! @name Shared values
+  The values of the next \ref exchange are written in \ref send_values (each rank at its own positions),
+  those of the last exchange are read in \ref received_values.
+ */
+///@{
+    double* send_values();
+    const double* received_values() const;
+///@}
+/*!
+  Waits until all ranks have called it, throws a RANK_ERROR if the group has been aborted.
+ */
+    void barrier();
+    void abort();
+/*!
+  Ends the run of the group: rank 0 waits for the other processes and throws a RANK_ERROR if one of them failed.
+ */
+    void finish();
+
+private:
+    struct Control;
+    bool peers_alive();
+    Control *control = nullptr;
+    uint64_t *partials = nullptr;
+    size_t control_bytes = 0;
+    int my_rank = 0, num_ranks = 1, memfd = -1;
+    pid_t parent;
+    std::vector<pid_t> children;
+    std::vector<int> statuses;
+    bool finished = false;
+/*! @name Shared arrays
+  Mapping of the memfd: the spike counts of each rank, the firing neurons and the values, each twice (even and odd steps),
+  \ref parity selects the arrays of the next exchange.
+ */
+///@{
+    void *mapping = nullptr;
+    size_t mapped_bytes = 0, num_neurons = 0, num_values = 0;
+    uint64_t *counts = nullptr, *spikes = nullptr;
+    double *values = nullptr;
+    int parity = 0;
+///@}
+
+};
+
+#endif //RANKS_H
@@ -0,0 +1,240 @@
+#include "recorder.h"
+#include "random.h"
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+
+const char TRAJ_MAGIC[8] = {'N', 'N', 'T', 'R', 'A', 'J', 0, 0};
+const uint32_t TRAJ_VERSION = 1;
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+size_t parse_number(const std::string &s) {
+    char *end;
+    unsigned long k = strtoul(s.c_str(), &end, 10);
+    if (s.empty() || *end) throw(TCLAP_ERROR("Invalid number '" + s + "' in the list of recorded neurons"));
+    return k;
+}
+
+}
+
+template<typename Real>
+Recorder::Recorder(const BasicNetwork<Real> &net, const std::string &spec,
+                   const std::map<std::string, size_t> &ntypes, const int _every)
+    : stride(std::max(_every, 1)) {
+    const size_t n = net.size();
+    const bool representatives = (spec.empty() || spec == "types");
+// --- the specification and the outputs use external indices, idx holds the internal ones
+    if (representatives) idx = net.traj_neurons(ntypes);
+    else if (spec.compare(0, 7, "random:") == 0) {
+// --- Floyd's algorithm, as in Network::random_connect, with draws indexed by position only
+        const size_t k = std::min(parse_number(spec.substr(7)), n);
+        std::vector<double> u(k);
+        _RNG->uniform_double(u.data(), 0, k, 0, RandomNumbers::RECORD);
+        std::vector<char> chosen(n, 0);
+        for (size_t i=0, j=n-k; i<k; i++, j++) {
+            size_t t = std::min((size_t)(u[i]*(j+1)), j);
+            if (chosen[t]) t = j;
+            chosen[t] = 1;
+        }
+        for (size_t nn=0; nn<n; nn++) if (chosen[nn]) idx.push_back(net.internal(nn));
+    } else {
+        std::stringstream ss(spec);
+        for (std::string item; std::getline(ss, item, ','); ) {
+            const size_t nn = parse_number(item);
+            if (nn >= n) throw(TCLAP_ERROR("Recorded neuron " + item + " is not in the network"));
+            idx.push_back(net.internal(nn));
+        }
+    }
+    for (auto nn : idx) {
+        ids.push_back(net.external(nn));
+        names.push_back(representatives ? net.type(nn) : net.type(nn)+std::to_string(ids.back()));
+    }
+    block.assign(3*idx.size()*_TRAJ_BLOCK_, 0.);
+    pending.assign(block.size(), 0.);
+    block_times.reserve(_TRAJ_BLOCK_);
+    pending_times.reserve(_TRAJ_BLOCK_);
+    row.reserve(3*idx.size());
+}
+
+template Recorder::Recorder(const BasicNetwork<double>&, const std::string&, const std::map<std::string, size_t>&, const int);
+template Recorder::Recorder(const BasicNetwork<float>&, const std::string&, const std::map<std::string, size_t>&, const int);
+
+Recorder::~Recorder() {
+    if (!worker.joinable()) return;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+}
+
+void Recorder::write_head(std::ostream &out) const {
+    for (const auto &nm : names) out << '\t' << nm << ".v" << '\t' << nm << ".u" << '\t' << nm << ".I";
+    out << '\n';
+}
+
+template<typename Real>
+void Recorder::values(const BasicNetwork<Real> &net, std::vector<double> &vals) const {
+    net.state_values(idx, vals);
+}
+
+template void Recorder::values(const BasicNetwork<double>&, std::vector<double>&) const;
+template void Recorder::values(const BasicNetwork<float>&, std::vector<double>&) const;
+
+template<typename Real>
+void Recorder::slice_values(const BasicNetwork<Real> &net, double *vals) {
+    row.clear();
+    net.state_values(idx, row);
+    for (size_t k=0; k<idx.size(); k++)
+        if (net.owns(idx[k])) std::copy(row.begin()+3*k, row.begin()+3*k+3, vals+3*k);
+}
+
+template void Recorder::slice_values(const BasicNetwork<double>&, double*);
+template void Recorder::slice_values(const BasicNetwork<float>&, double*);
+
+void Recorder::open(const std::string &_file, const bool append) {
+    filename = _file;
+    outf.open(filename, append ? std::ios::binary | std::ios::app : std::ios::binary | std::ios::out);
+    if (!outf.is_open()) throw(OUTPUT_ERROR("Cannot write to file " + filename));
+    if (!worker.joinable()) worker = std::thread(&Recorder::run, this);
+    if (append) return;
+    Header head;
+    std::memset(&head, 0, sizeof(head));
+    std::memcpy(head.magic, TRAJ_MAGIC, 8);
+    head.version = TRAJ_VERSION;
+    head.byte_order = BYTE_ORDER_MARK;
+    head.num_neurons = idx.size();
+    head.every = stride;
+    outf.write((const char*)&head, sizeof(head));
+    for (uint64_t nn : ids) outf.write((const char*)&nn, sizeof(nn));
+    if (outf.bad()) throw(OUTPUT_ERROR("Cannot write to file " + filename));
+}
+
+template<typename Real>
+void Recorder::record(const int time, const BasicNetwork<Real> &net) {
+    if (!outf.is_open()) return;
+    row.clear();
+    net.state_values(idx, row);
+    record(time, row);
+}
+
+template void Recorder::record(const int, const BasicNetwork<double>&);
+template void Recorder::record(const int, const BasicNetwork<float>&);
+
+void Recorder::record(const int time, const std::vector<double> &vals) {
+    if (!outf.is_open()) return;
+    const size_t m = idx.size(), j = block_times.size();
+// --- value var of neuron k goes to column var*m+k
+    for (size_t k=0; k<m; k++)
+        for (size_t var=0; var<3; var++) block[(var*m+k)*_TRAJ_BLOCK_+j] = vals[3*k+var];
+    block_times.push_back(time);
+    if (block_times.size() == _TRAJ_BLOCK_) write_block();
+}
+
+void Recorder::write_block() {
+    finish();
+    block.swap(pending);
+    block_times.swap(pending_times);
+    block_times.clear();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        has_pending = true;
+    }
+    wake.notify_all();
+}
+
+void Recorder::run() {
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        wake.wait(guard, [this] () {return has_pending || stopping;});
+        if (!has_pending) return;
+        guard.unlock();
+        try {
+            const uint64_t count = pending_times.size();
+            outf.write((const char*)&count, sizeof(count));
+            outf.write((const char*)pending_times.data(), count*sizeof(int64_t));
+            for (size_t c=0; c<3*idx.size(); c++)
+                outf.write((const char*)(pending.data()+c*_TRAJ_BLOCK_), count*sizeof(double));
+            if (outf.bad()) throw(OUTPUT_ERROR("Cannot write to file " + filename));
+        } catch (...) {
+            error = std::current_exception();
+        }
+        guard.lock();
+        has_pending = false;
+        wake.notify_all();
+    }
+}
+
+void Recorder::finish() {
+    std::unique_lock<std::mutex> guard(lock);
+    wake.wait(guard, [this] () {return !has_pending;});
+    if (error) {
+        std::exception_ptr e = error;
+        error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+void Recorder::sync() {
+    if (!outf.is_open()) return;
+    if (!block_times.empty()) write_block();
+    finish();
+    outf.flush();
+    if (outf.bad()) throw(OUTPUT_ERROR("Cannot write to file " + filename));
+}
+
+Recorder::Header Recorder::read_header(std::istream &in, std::vector<size_t> &neurons) {
+    Header head;
+    in.read((char*)&head, sizeof(head));
+    if (!in || std::memcmp(head.magic, TRAJ_MAGIC, 8) != 0 || head.byte_order != BYTE_ORDER_MARK)
+        throw(CFILE_ERROR("Not a binary trajectory file"));
+    if (head.version != TRAJ_VERSION) throw(CFILE_ERROR("Unsupported binary trajectory file version"));
+    neurons.resize(head.num_neurons);
+    for (size_t k=0; k<head.num_neurons; k++) {
+        uint64_t nn;
+        in.read((char*)&nn, sizeof(nn));
+        neurons[k] = nn;
+    }
+    if (!in) throw(CFILE_ERROR("Truncated binary trajectory file"));
+    return head;
+}
+
+bool Recorder::read_block(std::istream &in, const size_t m, std::vector<int64_t> &times, std::vector<double> &columns) {
+    uint64_t count;
+    if (!in.read((char*)&count, sizeof(count))) return false;
+    times.resize(count);
+    columns.resize(3*m*count);
+    in.read((char*)times.data(), count*sizeof(int64_t));
+    in.read((char*)columns.data(), columns.size()*sizeof(double));
+    if (!in) throw(CFILE_ERROR("Truncated binary trajectory file"));
+    return true;
+}
+
+void Recorder::truncate(const std::string &filename, const int time) {
+    std::ifstream inf(filename, std::ios::binary);
+    if (!inf.is_open()) throw(CFILE_ERROR("Could not open file " + filename));
+    inf.seekg(0, std::ios::end);
+    const std::streamoff fsize = inf.tellg();
+    inf.seekg(0);
+    std::vector<size_t> neurons;
+    read_header(inf, neurons);
+    const size_t m = neurons.size();
+// --- blocks are kept up to the last one which is complete and ends before time
+    std::streamoff offset = inf.tellg();
+    uint64_t count;
+    std::vector<int64_t> times;
+    while (inf.read((char*)&count, sizeof(count))) {
+        if (count > (uint64_t)(fsize-inf.tellg())/sizeof(int64_t)) break;
+        times.resize(count);
+        if (!inf.read((char*)times.data(), count*sizeof(int64_t))) break;
+        if (count && times.back() > time) break;
+        std::streamoff end = (std::streamoff)inf.tellg() + 3*m*count*sizeof(double);
+        if (end > fsize) break;
+        inf.seekg(end);
+        offset = end;
+    }
+    inf.close();
+    if (::truncate(filename.c_str(), offset) != 0) throw(OUTPUT_ERROR("Cannot truncate file " + filename));
+}
@@ -0,0 +1,146 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "network.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/*! \class Recorder
+  Records the trajectories (potential, recovery variable and input) of a fixed list of neurons, chosen once
+  when the recorder is constructed, every \ref every time-steps (options --traj-neurons, --traj-every and --traj-format of \ref Simulation).
+
+  The neurons are given by a specification string:
+  - empty or *types*: one representative per neuron type, as Network::traj_neurons,
+  - *random:K*: K distinct neurons drawn from the RandomNumbers::RECORD stream (they only depend on the seed),
+  - a list of indices such as *0,15,200*.
+  The indices of the specification, of the labels and of the file are the external ones (see Network::reorder).
+
+  \ref values appends the recorded values of one time-step for the text trajectory file (written by the \ref OutputWriter),
+  in O(recorded neurons). In binary form, \ref record accumulates them in a block of \ref _TRAJ_BLOCK_ time-steps stored by column
+  (all values of one variable of one neuron are contiguous), which is handed to a background thread (started by \ref open) when full and written while the next one fills.
+  The file starts with a header (magic *NNTRAJ*, version, number of recorded neurons, \ref every and the neuron indices, see \ref Header),
+  followed by blocks: a 64-bit count *n*, *n* 64-bit time-steps, then the columns of *n* doubles, all potentials first (one column per neuron),
+  then all recovery variables, then all inputs. \ref read_block reads them back.
+ */
+
+class Recorder {
+
+public:
+    struct Header {
+        char magic[8];
+        uint32_t version, byte_order;
+        uint64_t num_neurons, every;
+    };
+/*!
+  Recorder of the neurons of \p net given by \p spec (see the class description), \p ntypes is the description
+  of the population used by Network::traj_neurons.
+ */
+    template<typename Real>
+    Recorder(const BasicNetwork<Real> &net, const std::string &spec,
+             const std::map<std::string, size_t> &ntypes, const int _every=1);
+    ~Recorder();
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+/*!
+  External indices of the recorded neurons.
+ */
+    const std::vector<size_t>& neurons() const {return ids;}
+/*!
+  Column labels of the recorded neurons: the type of the neuron for representatives, type and index (e.g. *RS17*) otherwise.
+ */
+    const std::vector<std::string>& labels() const {return names;}
+    int every() const {return stride;}
+    bool due(const int time) const {return time % stride == 0;}
+/*!
+  Writes the header line of the text trajectory file (a tab and *label.v*, *label.u*, *label.I* for each neuron).
+ */
+    void write_head(std::ostream &out) const;
+/*!
+  Appends the potential, recovery variable and input of each recorded neuron to \p vals.
+ */
+    template<typename Real>
+    void values(const BasicNetwork<Real> &net, std::vector<double> &vals) const;
+/*!
+  Writes the values of the recorded neurons of the \ref BasicNetwork::set_slice "slice" of \p net at their place in \p vals 
+  (3 values per recorded neuron, as in \ref values), the other places are not written: 
+  the ranks of a \ref RankGroup fill the shared values together.
+ */
+    template<typename Real>
+    void slice_values(const BasicNetwork<Real> &net, double *vals);
+/*! @name Binary file */
+///@{
+/*!
+  Opens the binary file \p filename, the header is written unless \p append (resumed run, see \ref truncate).
+ */
+    void open(const std::string &filename, const bool append=false);
+/*!
+  Adds the state of the recorded neurons at time-step \p time to the current block.
+ */
+    template<typename Real>
+    void record(const int time, const BasicNetwork<Real> &net);
+/*!
+  Same as above with the values \p vals of all recorded neurons (see \ref values).
+ */
+    void record(const int time, const std::vector<double> &vals);
+/*!
+  Writes the current block (even if not full) and waits until the file is flushed,
+  for a checkpoint at this time-step: blocks then never straddle a checkpoint.
+ */
+    void sync();
+    void close() {sync();}
+/*!
+  Removes the blocks of binary file \p filename which contain time-steps larger than \p time,
+  so that a resumed run can append to it. The blocks are cut at checkpoints (see \ref sync).
+ */
+    static void truncate(const std::string &filename, const int time);
+/*!
+  Reads the header of a binary file, the indices of the recorded neurons are written to \p neurons.
+ */
+    static Header read_header(std::istream &in, std::vector<size_t> &neurons);
+/*!
+  Reads the next block of a binary file with \p m recorded neurons into \p times and \p columns (3*\p m columns of times.size() values).
+  \return false at the end of the file.
+ */
+    static bool read_block(std::istream &in, const size_t m, std::vector<int64_t> &times, std::vector<double> &columns);
+///@}
+
+private:
+    void write_block();
+
+/*!
+  Internal indices of the recorded neurons (in the network), \ref ids their external indices.
+ */
+    std::vector<size_t> idx, ids;
+    std::vector<std::string> names;
+    int stride;
+/*! @name Current block
+  \ref block_times holds the time-steps of the block, \ref block the 3 x \ref idx size columns of \ref _TRAJ_BLOCK_ values,
+  \ref row the values of one time-step before they are spread over the columns.
+ */
+///@{
+    std::vector<int64_t> block_times;
+    std::vector<double> block, row;
+///@}
+/*! @name Background writing
+  A full block is swapped with \ref pending_times and \ref pending and \ref has_pending is set, 
+  \ref worker (the same thread for the whole run, \ref run) then writes it to \ref outf and resets \ref has_pending.
+  \ref finish waits for the pending block. No allocation is made once the file is open.
+ */
+///@{
+    std::ofstream outf;
+    std::vector<int64_t> pending_times;
+    std::vector<double> pending;
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool has_pending = false, stopping = false;
+    std::exception_ptr error;
+    void run();
+    void finish();
+///@}
+    std::string filename;
+
+};
+
+#endif //RECORDER_H
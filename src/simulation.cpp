@@ -1,6 +1,26 @@
 #include "globals.h"
+#include "batch.h"
+#include "config.h"
 #include "random.h"
+#include "ranks.h"
+#include "recorder.h"
+#include "checkpoint.h"
 #include "simulation.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "writer.h"
+
+namespace {
+
+/// * JSON reports go to file <output><suffix>, or to the error stream without output file name *
+std::ostream* open_report(std::ofstream &outf, const std::string &output, const std::string &suffix) {
+    if (output.empty()) return &std::cerr;
+    outf.open(output+suffix);
+    if (!outf.is_open()) throw(OUTPUT_ERROR(std::string("Cannot write to file ")+output+suffix));
+    return &outf;
+}
+
+}
 
 Simulation::Simulation(int argc, char **argv) {
     parse(argc, argv);
@@ -27,22 +47,155 @@ void Simulation::parse(int argc, char **argv) {
     cmd.add(thalamArg);
     TCLAP::ValueArg<std::string> cfile("c", "config", _CFILE_TEXT_, false, "", "string");
     cmd.add(cfile);
+    TCLAP::SwitchArg pullArg("", "pull", _PULL_TEXT_, false);
+    cmd.add(pullArg);
+    TCLAP::ValueArg<int> threadsArg("", "threads", _THREADS_TEXT_, false, 1, "int");
+    cmd.add(threadsArg);
+    TCLAP::ValueArg<unsigned long> seedArg("", "seed", _SEED_TEXT_, false, 0, "int");
+    cmd.add(seedArg);
+    std::vector<std::string> rformats{"text", "aer", "none"};
+    TCLAP::ValuesConstraint<std::string> rformatConstr(rformats);
+    TCLAP::ValueArg<std::string> rformatArg("", "raster-format", _RFORMAT_TEXT_, false, "text", &rformatConstr);
+    cmd.add(rformatArg);
+    TCLAP::ValueArg<std::string> saveArg("", "save-network", _SAVE_TEXT_, false, "", "string");
+    cmd.add(saveArg);
+    TCLAP::ValueArg<std::string> loadArg("", "load-network", _LOAD_TEXT_, false, "", "string");
+    cmd.add(loadArg);
+    TCLAP::SwitchArg profileArg("", "profile", _PROFILE_TEXT_, false);
+    cmd.add(profileArg);
+    TCLAP::SwitchArg statsArg("", "stats", _STATS_TEXT_, false);
+    cmd.add(statsArg);
+    TCLAP::ValueArg<int> swindowArg("", "stats-window", _SWINDOW_TEXT_, false, _STATS_WINDOW_, "int");
+    cmd.add(swindowArg);
+    TCLAP::ValueArg<std::string> trajnArg("", "traj-neurons", _TRAJN_TEXT_, false, "types", "string");
+    cmd.add(trajnArg);
+    TCLAP::ValueArg<int> trajeArg("", "traj-every", _TRAJE_TEXT_, false, 1, "int");
+    cmd.add(trajeArg);
+    std::vector<std::string> tformats{"text", "binary"};
+    TCLAP::ValuesConstraint<std::string> tformatConstr(tformats);
+    TCLAP::ValueArg<std::string> tformatArg("", "traj-format", _TFORMAT_TEXT_, false, "text", &tformatConstr);
+    cmd.add(tformatArg);
+    TCLAP::ValueArg<std::string> ckptArg("", "checkpoint", _CHECKPOINT_TEXT_, false, "", "string");
+    cmd.add(ckptArg);
+    TCLAP::ValueArg<int> ckeveryArg("", "checkpoint-every", _CKEVERY_TEXT_, false, _CKPT_EVERY_, "int");
+    cmd.add(ckeveryArg);
+    TCLAP::ValueArg<std::string> resumeArg("", "resume", _RESUME_TEXT_, false, "", "string");
+    cmd.add(resumeArg);
+    TCLAP::ValueArg<int> trialsArg("", "trials", _TRIALS_TEXT_, false, 1, "int");
+    cmd.add(trialsArg);
+    std::vector<std::string> precisions{"double", "float"};
+    TCLAP::ValuesConstraint<std::string> precisionConstr(precisions);
+    TCLAP::ValueArg<std::string> precisionArg("", "precision", _PRECISION_TEXT_, false, "double", &precisionConstr);
+    cmd.add(precisionArg);
+    TCLAP::ValueArg<int> delayArg("", "delay", _DELAY_TEXT_, false, 1, "int");
+    cmd.add(delayArg);
+    TCLAP::ValueArg<std::string> compactArg("", "compact-synapses", _COMPACT_TEXT_, false, "", "string");
+    cmd.add(compactArg);
+    std::vector<std::string> orders{"none", "type", "rcm"};
+    TCLAP::ValuesConstraint<std::string> orderConstr(orders);
+    TCLAP::ValueArg<std::string> reorderArg("", "reorder", _REORDER_TEXT_, false, "none", &orderConstr);
+    cmd.add(reorderArg);
+    TCLAP::ValueArg<int> ranksArg("", "ranks", _RANKS_TEXT_, false, 1, "int");
+    cmd.add(ranksArg);
 
     cmd.parse(argc, argv);
+    if (seedArg.getValue()) *_RNG = RandomNumbers(seedArg.getValue());
 
     endtime = timeArg.getValue();
     size = sizeArg.getValue();
     degree = degreeArg.getValue();
     output = outputArg.getValue();
+    raster_format = rformatArg.getValue();
+    precision = precisionArg.getValue();
+    profile = profileArg.getValue();
+    stats = statsArg.getValue();
+    stats_window = std::max(swindowArg.getValue(), 1);
+    traj_neurons = trajnArg.getValue();
+    traj_every = std::max(trajeArg.getValue(), 1);
+    traj_format = tformatArg.getValue();
+    checkpoint_file = ckptArg.getValue();
+    checkpoint_every = ckeveryArg.getValue();
+    trials = std::max(trialsArg.getValue(), 1);
+    if (trials > 1 && output.empty())
+        throw(OUTPUT_ERROR("Multiple trials need an output file name (option -o)"));
+    if (trials > 1 && (checkpoint_file.size() || resumeArg.getValue().size()))
+        throw(TCLAP_ERROR("Multiple trials cannot be combined with --checkpoint or --resume"));
+    if (stats && resumeArg.getValue().size())
+        throw(TCLAP_ERROR("The statistics of the interrupted part are not checkpointed: --stats excludes --resume"));
+    if (trials > 1 && precision != "double")
+        throw(TCLAP_ERROR("Multiple trials are only run in double precision"));
+    max_delay = std::max(1, std::min(delayArg.getValue(), _MAX_DELAY_));
+    const std::string compact_format = compactArg.getValue();
+    if (compact_format.size() && max_delay > 1)
+        throw(TCLAP_ERROR("Compact links have no delays: --compact-synapses excludes --delay"));
+    if (compact_format.size() && (saveArg.getValue().size() || checkpoint_file.size() || resumeArg.getValue().size()))
+        throw(TCLAP_ERROR("Compact links cannot be saved: --compact-synapses excludes --save-network, --checkpoint and --resume"));
+    if (compact_format.size() && trials > 1)
+        throw(TCLAP_ERROR("Multiple trials need the full link table, not --compact-synapses"));
+    const std::string order = reorderArg.getValue();
+    if (order != "none" && compact_format.size())
+        throw(TCLAP_ERROR("Compact links cannot be reordered: --compact-synapses excludes --reorder"));
+    if (order != "none" && (trials > 1 || resumeArg.getValue().size()))
+        throw(TCLAP_ERROR("--reorder cannot be combined with --trials or --resume"));
+    const int ranks = std::max(ranksArg.getValue(), 1);
+    if (ranks > 1 && (trials > 1 || checkpoint_file.size() || resumeArg.getValue().size() 
+                      || saveArg.getValue().size() || order != "none"))
+        throw(TCLAP_ERROR("--ranks cannot be combined with --trials, --checkpoint, --resume, --save-network or --reorder"));
     streng = strengthArg.getValue();
     thalam = thalamArg.getValue();
     inhib = inhibArg.getValue();
     if (inhib<=0. || inhib>1.) inhib = _PROP_INHIB_;
+// --- the ranks are forked before the threads are created, each one then constructs its slice of the network
+    if (ranks > 1) group = std::make_shared<RankGroup>(ranks);
+    net.set_event_driven(!pullArg.getValue());
+    net.set_threads(std::max(threadsArg.getValue(), 1));
     std::string conf(cfile.getValue()), types(typesArg.getValue());
-    if (conf.empty()) {
+// --- new links are coded directly, a loaded network is converted
+    if (compact_format.size() && loadArg.getValue().empty())
+        net.set_compact(CompactSynapses::parse_format(compact_format, conf.empty() ? size : 0));
+    if (resumeArg.getValue().size()) {
+        Snapshot::RunState rs = load_snapshot(resumeArg.getValue());
+        *_RNG = RandomNumbers(rs.seed);
+        _RNG->position(rs.rng_position);
+        start_time = rs.time;
+        resumed = true;
+    } else if (loadArg.getValue().size()) {
+        load_snapshot(loadArg.getValue());
+        slice_network();
+        if (compact_format.size()) net.set_compact(CompactSynapses::parse_format(compact_format, net.size()));
+    } else if (conf.empty()) {
         net.resize(size, inhib);
+        slice_network();
         parse_types(types);
     } else load_configuration(conf);
+    if (trials > 1 && net.max_delay() > 1)
+        throw(TCLAP_ERROR("Multiple trials are only run without link delays"));
+    if (net.is_compact() && (!group || group->rank() == 0)) {
+        const CompactSynapses &cs = *net.compact_synapses();
+        std::cerr << "Links: " << cs.num_links() << " in format " << CompactSynapses::format_name(cs.get_format())
+                  << ", " << (double)cs.bytes()/std::max(cs.num_links(), (size_t)1) << " bytes per link"
+                  << ", intensity error max " << cs.max_error() << " rms " << cs.rms_error() << std::endl;
+    }
+    if (order != "none") net.reorder(net.locality_order(order));
+    if (saveArg.getValue().size()) Snapshot::save(net, saveArg.getValue(), Snapshot::RunState(0, 0, 0, !ntypes.count("RS")));
+}
+
+void Simulation::slice_network() {
+    if (!group) return;
+    std::pair<size_t, size_t> own = group->slice(net.size());
+    net.set_slice(own.first, own.second);
+}
+
+Snapshot::RunState Simulation::load_snapshot(const std::string &infile) {
+    Snapshot::RunState rs = Snapshot::load(net, infile);
+    size = net.size();
+    ntypes.clear();
+// --- RS neurons are the complement as in parse_types, or a type as in load_configuration, like the saved run
+    for (size_t n=0; n<size; n++) {
+        std::string t = net.neuron(n).type();
+        if (t != "RS" || !rs.rs_complement) ntypes[t]++;
+    }
+    return rs;
 }
 
 void Simulation::parse_types(std::string types) {
@@ -68,7 +221,7 @@ void Simulation::parse_types(std::string types) {
         }
     }
     net.set_default_params(ntypes);
-    net.random_connect(degree, streng);
+    net.random_connect(degree, streng, max_delay);
 }
 
 size_t Simulation::size_type(const std::string &_s) const {
@@ -80,106 +233,214 @@ size_t Simulation::size_type(const std::string &_s) const {
 }
 
 void Simulation::load_configuration(const std::string &infile) {
+    ConfigReader conf(infile, net.num_threads());
+    size = conf.size();
     ntypes.clear();
-    std::vector<NeuronParams> neurons;
-    std::vector<std::string> neurtyp;
-    std::map<size_t, size_t> indexmap;
-    linkmap linklist;
-    std::vector<double> npoten;
-    size = 0;
-    try {
-        std::ifstream confstr(infile);
-        std::string item, key, line;
-        double value, poten;
-        size_t nindex;
-        NeuronParams nparams;
-        if (confstr.is_open()) {
-            while (std::getline(confstr, line)) {
-                // This removes all spaces from the string
-                line.erase(std::remove_if(line.begin(), line.end(), isspace), line.end());
-                // comment lines start with #
-                if (line[0] == '#') continue;
-                std::stringstream ss(line);
-                std::getline(ss, item, ';');
-                key = item.substr(0, 4);
-                std::transform(key.begin(), key.end(), key.begin(), ::tolower);
-                if (key.compare("link") == 0) {
-                    while (std::getline(ss, item, ';')) {
-                        size_t split = item.find(','),
-                            split2 = item.find(':');
-                        size_t from = stoi(item.substr(0, split)), 
-                            to = stoi(item.substr(split+1, split2));
-                        double str = stod(item.substr(split2+1));
-                        linklist.insert({{from, to}, str});
-                    }
-                } else {
-                    nindex = stoi(item);
-                    std::getline(ss, item, ';');
-                    nparams = Neuron::type_default(item);
-                    neurtyp.push_back(item);
-                    ntypes[item]++;
-                    poten = _REST_VAL_;
-                    while (std::getline(ss, item, ';')) {
-                        size_t split = item.find('=');
-                        key = item.substr(0, split);
-                        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
-                        value = stod(item.substr(split+1));
-                        if      (key[0] == 'a') nparams.a = value;
-                        else if (key[0] == 'b') nparams.b = value;
-                        else if (key[0] == 'c') nparams.c = value;
-                        else if (key[0] == 'd') nparams.d = value;
-                        else if (key[0] == 'i') nparams.inhib = (value>0);
-                        else if (key[0] == 'v') poten = value;
-                    }
-                    indexmap[nindex] = size;
-                    neurons.push_back(nparams);
-                    npoten.push_back(poten);
-                    size++;
-                }
-            }
-            confstr.close();
-        } else throw(CFILE_ERROR("Could not open configuration file " + infile));
-    } catch(std::ifstream::failure &e) {
-        throw(CFILE_ERROR("Error with configuration file " + infile + ": " + e.what()));
-    }
+    for (auto &t : conf.types()) ntypes[t]++;
     net.resize(size, inhib);
-    net.set_types_params(neurtyp, neurons);
-    net.set_values(npoten);
-    if (linklist.empty()) net.random_connect(degree, streng);
-    else for (auto I : linklist) 
-             net.add_link(indexmap[I.first.first], indexmap[I.first.second], I.second);
+    slice_network();
+    net.set_types_params(conf.types(), conf.params());
+    net.set_values(conf.potentials());
+    if (conf.links().empty()) net.random_connect(degree, streng);
+    else net.set_links(conf.links());
 }
 
 void Simulation::run() {
-    std::ofstream outf(output), outf2, outf3;
-    if (output.size() && outf.bad()) 
+    if (trials > 1) run_trials();
+    else if (precision == "float") {
+// --- the double precision network is released, only the converted one is kept during the run
+        BasicNetwork<float> single(net);
+        net = Network();
+        run_network(single);
+    } else run_network(net);
+    if (group) group->finish();
+}
+
+template<typename Real>
+void Simulation::run_network(BasicNetwork<Real> &nt) {
+    bool aer = (raster_format == "aer"), btraj = (traj_format == "binary");
+// --- with several ranks, rank 0 writes all outputs
+    const bool main_rank = !group || group->rank() == 0;
+    const std::string outname = main_rank ? output : "";
+    uint64_t aer_last = 0;
+    if (resumed && output.size()) {
+        if (aer) aer_last = AerReader::truncate(output, start_time);
+        else if (raster_format == "text") OutputWriter::truncate_text(output, start_time);
+        if (btraj) Recorder::truncate(output+"_traj", start_time);
+        else OutputWriter::truncate_text(output+"_traj", start_time);
+    }
+    std::ios::openmode mode = resumed ? std::ios::app : std::ios::out;
+    std::ofstream outf, outf2, outf3;
+    if (raster_format != "none" && outname.size()) outf.open(output, aer ? mode | std::ios::binary : mode);
+    if (outname.size() && outf.bad()) 
         throw(OUTPUT_ERROR(std::string("Cannot write to file ")+output));
     std::ostream *_outf = &std::cout;
     if (outf.is_open()) _outf = &outf;
-    if (output.size()) {
-        outf2.open(output+"_traj");
+    if (raster_format == "none" || !main_rank) _outf = nullptr;
+    Recorder recorder(nt, traj_neurons, ntypes, traj_every);
+    if (outname.size() && btraj) recorder.open(output+"_traj", resumed);
+    if (outname.size()) {
+        if (!btraj) outf2.open(output+"_traj", mode);
         if (outf2.bad())
             throw(OUTPUT_ERROR(std::string("Cannot write to file ")+output+"_traj"));
-        outf3.open(output+"_pars");
+        if (!resumed) outf3.open(output+"_pars");
         if (outf3.bad())
             throw(OUTPUT_ERROR(std::string("Cannot write to file ")+output+"_pars"));
     }
-    std::vector<double> thalinput(size);
-    net.print_params(&outf3);
-    if (outf3.is_open()) outf3.close();
-    if (outf2.is_open()) net.print_head(ntypes, &outf2);
-    int time = 0;
+    if (!resumed) {
+        if (main_rank) nt.print_params(&outf3);
+        if (outf3.is_open()) outf3.close();
+        if (outf2.is_open()) recorder.write_head(outf2);
+    }
+// --- the other ranks append the parameters of their slice in turn
+    for (int r=1; group && r<group->size(); r++) {
+        group->barrier();
+        if (group->rank() != r || output.empty()) continue;
+        std::ofstream outp(output+"_pars", std::ios::app);
+        if (!outp.is_open()) throw(OUTPUT_ERROR(std::string("Cannot write to file ")+output+"_pars"));
+        nt.print_params(&outp, false);
+    }
+    std::unique_ptr<Profiler> prof;
+    if (profile) prof.reset(new Profiler);
+    nt.set_profiler(prof.get());
+    OutputWriter writer(_outf, outf2.is_open() ? &outf2 : nullptr, size, aer, _QUEUE_SIZE_, resumed, aer_last);
+    std::unique_ptr<CheckpointWriter> ckpt;
+    if (checkpoint_file.size() && checkpoint_every > 0) ckpt.reset(new CheckpointWriter(checkpoint_file));
+    std::unique_ptr<PopulationStats> pstats;
+    if (stats && main_rank) {
+        pstats.reset(new PopulationStats(nt, stats_window));
+        pstats->reserve(endtime-start_time);
+    }
+// --- local holds the spikes of the slice, all those of the network gathered from the ranks (in increasing order)
+    std::vector<size_t> local, all;
+    std::vector<double> shared;
+    const size_t nvals = 3*recorder.neurons().size();
+    if (group) {
+        group->allocate(nt.size(), nvals);
+        local.reserve(nt.size());
+        all.reserve(nt.size());
+        shared.reserve(nvals);
+        nt.next_spikes(local);
+        group->exchange(local, all);
+    }
+    if (prof) prof->start();
+    Profiler::clock::time_point lap;
+    int time = start_time;
+    SpikeList firs(nt.size());
     while (time<endtime) {
-        _RNG->normal(thalinput, 0, thalam);
-        std::set<size_t> firs = net.step(thalinput);
+        if (prof) lap = Profiler::clock::now();
+        if (group) nt.step(thalam, time, all, firs);
+        else nt.step(thalam, time, firs);
         time++;
-        (*_outf) << time;
-        for (size_t nn=0; nn<size; nn++) (*_outf) << " " << firs.count(nn);
-        (*_outf) << std::endl;
-        if (outf2.is_open()) net.print_traj(time, ntypes, &outf2);
+        if (prof) {
+            prof->add(Profiler::NETWORK_STEP, Profiler::seconds_since(lap));
+            lap = Profiler::clock::now();
+        }
+        if (group) {
+            if (recorder.due(time)) recorder.slice_values(nt, group->send_values());
+            nt.next_spikes(local);
+            group->exchange(local, all);
+            if (prof) {
+                prof->add(Profiler::EXCHANGE, Profiler::seconds_since(lap));
+                lap = Profiler::clock::now();
+            }
+        }
+        if (pstats) pstats->record(time, firs);
+        OutputWriter::StepRecord &rec = writer.acquire();
+        rec.time = time;
+        rec.spikes.clear();
+        if (_outf) {
+            rec.spikes.assign(firs.begin(), firs.end());
+            nt.to_external(rec.spikes);
+        }
+        rec.values.clear();
+        if (recorder.due(time) && group) {
+            shared.assign(group->received_values(), group->received_values()+nvals);
+            if (outf2.is_open()) rec.values.assign(shared.begin(), shared.end());
+            recorder.record(time, shared);
+        } else if (recorder.due(time)) {
+            if (outf2.is_open()) recorder.values(nt, rec.values);
+            recorder.record(time, nt);
+        }
+// --- a checkpoint due while the previous one is still written is skipped, the run does not wait
+        rec.sync = ckpt && (time % checkpoint_every == 0) && ckpt->ready();
+        writer.publish();
+        if (rec.sync) {
+            recorder.sync();
+            ckpt->save(nt, Snapshot::RunState(time, _RNG->get_seed(), _RNG->position(), !ntypes.count("RS")), &writer);
+        }
+        if (prof) prof->add(Profiler::RECORD, Profiler::seconds_since(lap));
+    }
+    writer.close(endtime);
+    recorder.close();
+    if (ckpt) ckpt->finish();
+    if (ckpt && ckpt->skipped())
+        std::cerr << "Checkpoints: " << ckpt->skipped() << " skipped while the previous one was written" << std::endl;
+    if (pstats) {
+        std::ofstream statf;
+        pstats->write_json(open_report(statf, output, "_stats.json"));
     }
     if (outf2.is_open()) outf2.close();
     if (outf.is_open()) outf.close();        
+    if (prof) {
+        prof->stop();
+        nt.set_profiler(nullptr);
+        prof->add(Profiler::RASTER, writer.raster_seconds());
+        prof->add(Profiler::TRAJ, writer.traj_seconds());
+        prof->add(Profiler::WRITER_STALL, writer.stall_seconds());
+// --- each rank has counted the spikes of its slice and the events of its links
+        if (group) {
+            uint64_t counts[2] = {prof->spikes(), prof->events()};
+            group->sum(counts, 2);
+            prof->set_counts(counts[0], counts[1]);
+        }
+        std::ofstream proff;
+        if (main_rank) prof->write_json(open_report(proff, output, "_profile.json"));
+    }
+}
+
+void Simulation::run_trials() {
+    bool aer = (raster_format == "aer");
+    std::ofstream outf3(output+"_pars");
+    if (outf3.bad()) throw(OUTPUT_ERROR(std::string("Cannot write to file ")+output+"_pars"));
+    net.print_params(&outf3);
+    outf3.close();
+    std::vector<unsigned long> seeds;
+    for (int k=0; k<trials; k++) seeds.push_back(_RNG->get_seed()+k);
+    TrialBatch batch(net, seeds, net.num_threads());
+// --- one output file and writer thread per trial
+    std::vector<std::unique_ptr<std::ofstream> > outfs;
+    std::vector<std::unique_ptr<OutputWriter> > writers;
+    std::vector<std::unique_ptr<PopulationStats> > tstats;
+    for (int k=0; k<trials; k++) {
+        if (stats) {
+            tstats.emplace_back(new PopulationStats(net, stats_window));
+            tstats.back()->reserve(endtime);
+        }
+        if (raster_format == "none") continue;
+        std::string fname = output+"_trial"+std::to_string(k);
+        outfs.emplace_back(new std::ofstream(fname, aer ? std::ios::out | std::ios::binary : std::ios::out));
+        if (!outfs.back()->is_open()) throw(OUTPUT_ERROR(std::string("Cannot write to file ")+fname));
+        writers.emplace_back(new OutputWriter(outfs.back().get(), nullptr, size, aer));
+    }
+    for (int time=0; time<endtime; ) {
+        batch.step(thalam, time);
+        time++;
+        for (size_t k=0; k<tstats.size(); k++) tstats[k]->record(time, batch.spikes(k));
+        for (size_t k=0; k<writers.size(); k++) {
+            OutputWriter::StepRecord &rec = writers[k]->acquire();
+            rec.time = time;
+            rec.spikes = batch.spikes(k);
+            rec.values.clear();
+            writers[k]->publish();
+        }
+    }
+    for (auto &w : writers) w->close(endtime);
+    for (auto &f : outfs) f->close();
+    for (size_t k=0; k<tstats.size(); k++) {
+        std::ofstream statf;
+        tstats[k]->write_json(open_report(statf, output+"_trial"+std::to_string(k), "_stats.json"));
+    }
 }
 
 
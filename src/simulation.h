@@ -1,6 +1,8 @@
-#include "network.h"
+#include "snapshot.h"
 #include <tclap/CmdLine.h>
 
+class RankGroup;
+
 /*! \class Simulation
   This is the main class. 
   It manages user inputs, defines the simulation parameters and constructs the \ref Network \ref net.
@@ -15,6 +17,47 @@
   - \ref streng : average intensity of connections, 
   - \ref inhib : fraction of inhibitory neurons in the network, 
 
+  The raster is written either as text (one line per time-step with one value per neuron) or, 
+  with \ref raster_format "aer", as a binary list of spike events (see \ref AerWriter).
+
+  The network can be saved to a binary file (option --save-network) and loaded back (--load-network) 
+  much faster than it is constructed, see \ref Snapshot.
+
+  With --profile, \ref run measures the time spent in each phase (noise, synaptic input, neuron update, output)
+  and writes a JSON report, see \ref Profiler.
+
+  With --checkpoint, the state of the run is saved periodically (\ref CheckpointWriter), and
+  a run started with --resume continues from a checkpoint exactly as the interrupted run would have, 
+  appending to its outputs. The other options (duration, thalamic input, output) must be given again;
+  --stats cannot be resumed, the checkpoint does not hold the statistics.
+
+  With --trials, several independent trials of the same network (they only differ by the thalamic noise)
+  are run together by a \ref TrialBatch, see \ref run_trials.
+
+  With --precision=float, the network is constructed as usual then converted to single precision for the run 
+  (see \ref BasicNetwork), the outputs have the same format.
+
+  With --compact-synapses, the links are stored as a \ref CompactSynapses (see BasicNetwork::set_compact):
+  random links are coded as they are drawn, so the full table never exists.
+
+  With --reorder, the neurons are renumbered for memory locality once the network is constructed (see Network::reorder),
+  the outputs use the original indices.
+
+  With --ranks, the run is split between this number of local processes (a \ref RankGroup): each one simulates the neurons 
+  of its \ref BasicNetwork::set_slice "slice" and the spikes of each time-step are exchanged through shared memory.
+  The outputs are identical to those of a single process, they are written by rank 0. 
+  The throughput for 1, 2, 4... ranks can be compared with the *steps_per_second* of --profile 
+  (its spike and event counts are summed over the ranks) or the *network_step_ranks* cases of NeuronNet_bench.
+
+  With --delay, the random links have delays of up to this number of time-steps (see Network::step).
+
+  With --stats, the firing rates, inter-spike intervals, population rate series and synchrony of each neuron type
+  are computed during the run by a \ref PopulationStats and written as JSON (for each trial with --trials).
+  With --raster-format=none, the raster is not written at all.
+
+  The trajectories of the neurons chosen with --traj-neurons (one per type by default, a random sample or a list)
+  are recorded every --traj-every time-steps, as text or in the binary columnar format of \ref Recorder (--traj-format).
+
   The map \ref ntypes describes the neuron population: 
   its keys are the neuron types from \ref Neuron::NeuronTypes and values are the corresponding counts.
  */
@@ -29,16 +72,27 @@ public:
   \param _i (double): fraction of inhibitory neurons in the network
  */
     Simulation(const int _s, const int _t, const double _i=_PROP_INHIB_)
-        : endtime(_t), size(_s), degree(_DEGREE_), thalam(_THALAM_), streng(_STRENG_), inhib(_i) {}
+        : endtime(_t), size(_s), degree(_DEGREE_), thalam(_THALAM_), streng(_STRENG_), inhib(_i), 
+          raster_format("text"), precision("double") {}
 /*!
   Constructor based on user inputs, takes command-line arguments and passes them to \ref parse.
  */
     Simulation(int, char**);
 /*!
-  Construct a network as specified in a configuration file
+  Construct a network as specified in a configuration file, read with \ref ConfigReader.
+  Each line describes a neuron as `index; type; a=..; b=..; c=..; d=..; inhibitory=..; v=..` (parameters are optional),
+  or a list of links as `link; receiving,sending:intensity; ...`, lines starting with # are comments.
+  A link can have a delay in time-steps (between 1, the default, and \ref _MAX_DELAY_) as `receiving,sending:intensity:delay`.
+  If there are no links, the network is randomly connected.
   \param infile (string): filename
  */
     void load_configuration(const std::string &infile);
+/*!
+  Loads the network from a binary snapshot written with the option --save-network or --checkpoint (see \ref Snapshot).
+  \param infile (string): filename
+  \return the state of the run saved in the file.
+ */
+    Snapshot::RunState load_snapshot(const std::string &infile);
 /*!
   Parses a string such as **FS:0.2,IB:0.2,CH:0.15** and constructs the network accordingly (20% of *FS* neurons, 20% of *IB* and 15%of *CH*). 
   These neuron types are found in \ref Neuron::NeuronTypes. The neuron population is completed with default (*RS*) 
@@ -51,11 +105,23 @@ public:
     size_t size_type(const std::string &_s) const;
 /*!
   The main operation of this class: runs the simulation through a loop with \ref endtime steps. 
-  Each iteration calls \ref Network::step with a random value of thalamic input (RandomNumbers::normal distribution), then writes out the results. 
+  Each iteration calls \ref Network::step with a random value of thalamic input (RandomNumbers::normal distribution, drawn from the counter-based thalamic stream), 
+  then hands the results over to an \ref OutputWriter which writes them out on its own thread. 
  */
     void run();
 
 private:
+/*!
+  Implementation of \ref run on network \p nt, which is \ref net or its conversion to single \ref precision.
+ */
+    template<typename Real>
+    void run_network(BasicNetwork<Real> &nt);
+/*!
+  Runs \ref trials trials of the network with a \ref TrialBatch, trial *k* using the seed of \ref _RNG plus *k*.
+  The raster of each trial is written to its own file (\ref output with suffix *_trial<k>*, also the prefix of its statistics), the parameters are written once,
+  trajectories are not written.
+ */
+    void run_trials();
 /*!
   Constraint function for a TCLAP argument to restrict a double to [0,1].
  */
@@ -69,12 +135,52 @@ private:
   Uses [TCLAP](http://tclap.sourceforge.net/html/index.html) to parse user inputs.
  */
     void parse(int, char**);
+/*!
+  Restricts \ref net to the slice of this process when the run is split between ranks (see \ref group).
+ */
+    void slice_network();
 
     Network net;
     int endtime;
     size_t size;
     double degree, thalam, streng, inhib;
-    std::string output;
+    std::string output, raster_format, precision;
+/*!
+  If true, \ref run writes a \ref Profiler report.
+ */
+    bool profile = false;
+/*!
+  If true, \ref run writes the \ref PopulationStats of the run, with windows of \ref stats_window time-steps.
+ */
+    bool stats = false;
+    int stats_window = _STATS_WINDOW_;
+/*! @name Trajectories
+  Specification of the recorded neurons (see \ref Recorder), recording period and format (*text* or *binary*).
+ */
+///@{
+    std::string traj_neurons = "types";
+    int traj_every = 1;
+    std::string traj_format = "text";
+///@}
+/*! @name Checkpoints
+  \ref run saves a checkpoint in \ref checkpoint_file every \ref checkpoint_every time-steps.
+  A resumed run starts at \ref start_time.
+ */
+///@{
+    std::string checkpoint_file;
+    int checkpoint_every = _CKPT_EVERY_;
+    int start_time = 0;
+    bool resumed = false;
+///@}
+    int trials = 1;
+/*!
+  Processes of the run with --ranks (null for a single process), created by \ref parse.
+ */
+    std::shared_ptr<RankGroup> group;
+/*!
+  Random links get delays between 1 and \ref max_delay time-steps.
+ */
+    int max_delay = 1;
     std::map< std::string, size_t > ntypes; 
 };
 
@@ -0,0 +1,235 @@
+#include "snapshot.h"
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char SNAP_MAGIC[8] = {'N', 'N', 'S', 'N', 'A', 'P', 0, 0};
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+const size_t SECTION_ALIGN = 64;
+
+size_t align_up(const size_t x) {return (x+SECTION_ALIGN-1)/SECTION_ALIGN*SECTION_ALIGN;}
+
+}
+
+size_t Snapshot::section_bytes(const Header &h, const int s) {
+    switch (s) {
+    case TYPE_NAMES: return h.num_types*type_name_size;
+    case TYPE_ID: case INHIB: return h.num_neurons;
+    case ROW_START: case OUT_START: return 8*(h.num_neurons+1);
+    case SOURCES: case WEIGHTS: case TARGETS: case OUT_WEIGHTS: return 8*h.num_links;
+// --- sections of delayed links, empty without delays
+    case DELAYS: case OUT_DELAYS: return (h.ring_slots > 1) ? h.num_links : 0;
+    case PENDING_EXC: case PENDING_INH: return (h.ring_slots > 1) ? 8*h.num_neurons*h.ring_slots : 0;
+    case EXTERNAL_IDS: return h.reordered ? 8*h.num_neurons : 0;
+    default: return 8*h.num_neurons;
+    }
+}
+
+template<typename Real>
+void Snapshot::set_section(const int s, const ArrayStore<Real> &arr, const bool copy) {
+    if (copy || !std::is_same<Real, double>::value) {
+        copies[s].assign(arr.begin(), arr.end());
+        data[s] = copies[s].data();
+    } else data[s] = arr.data();
+}
+
+template<typename Real>
+Snapshot::Snapshot(const BasicNetwork<Real> &net, const RunState &rs, const bool copy_state) {
+    static_assert(sizeof(size_t) == 8 && sizeof(double) == 8, "Snapshots require 64-bit indices");
+    if (net.is_compact()) throw(OUTPUT_ERROR("Cannot save a network with compact links"));
+    net.index_links();
+    const BasicNeuronPopulation<Real> &pop = net.neurons;
+    const BasicSynapseTable<Real> &syn = net.synapses;
+    std::memset(&head, 0, sizeof(head));
+    std::memcpy(head.magic, SNAP_MAGIC, 8);
+    head.version = version;
+    head.byte_order = BYTE_ORDER_MARK;
+    head.num_neurons = pop.size();
+    head.num_links = syn.num_links();
+    head.num_types = pop.type_names.size();
+    head.time = rs.time;
+    head.seed = rs.seed;
+    head.rng_position = rs.rng_position;
+    head.rs_complement = rs.rs_complement;
+    head.ring_slots = syn.max_delay();
+    head.reordered = net.is_reordered();
+    names.assign(head.num_types*type_name_size, 0);
+    for (size_t k=0; k<head.num_types; k++)
+        pop.type_names[k].copy(&names[k*type_name_size], type_name_size-1);
+    data[TYPE_NAMES] = names.data();
+    data[TYPE_ID] = pop.type_id.data();
+    data[INHIB] = pop.inhib.data();
+    const ArrayStore<Real> *pars[5] = {&pop.a, &pop.b, &pop.c, &pop.d, &pop.w}, *vars[3] = {&pop.v, &pop.u, &pop.I};
+    for (int k=0; k<5; k++) set_section(PAR_A+k, *pars[k], false);
+    for (int k=0; k<3; k++) set_section(VAR_V+k, *vars[k], copy_state);
+    data[ROW_START] = syn.row_start.data();
+    data[SOURCES] = syn.sources.data();
+    set_section(WEIGHTS, syn.weights, false);
+    data[OUT_START] = syn.out_start.data();
+    data[TARGETS] = syn.targets.data();
+    set_section(OUT_WEIGHTS, syn.out_weights, false);
+    data[DELAYS] = syn.delays.data();
+    data[OUT_DELAYS] = syn.out_delays.data();
+    data[EXTERNAL_IDS] = net.external_ids.data();
+// --- the circular buffers are stored from the slot of the next step, and always copied
+    const size_t n = head.num_neurons, slots = head.ring_slots;
+    const std::vector<Real> *rings[2] = {&net.exc_input, &net.inh_input};
+    for (int k=0; k<2; k++) {
+        if (slots < 2) break;
+        copies[PENDING_EXC+k].assign(n*slots, 0.0);
+        if (net.ring_slots == slots && rings[k]->size() == n*slots)
+            for (size_t j=0; j<slots; j++) {
+                auto from = rings[k]->begin()+(net.ring_pos+j)%slots*n;
+                std::copy(from, from+n, copies[PENDING_EXC+k].begin()+j*n);
+            }
+        data[PENDING_EXC+k] = copies[PENDING_EXC+k].data();
+    }
+    size_t pos = align_up(sizeof(Header));
+    for (int s=0; s<NUM_SECTIONS; s++) {
+        head.offset[s] = pos;
+        pos = align_up(pos+section_bytes(head, s));
+    }
+    head.file_size = pos;
+}
+
+template Snapshot::Snapshot(const BasicNetwork<double>&, const RunState&, const bool);
+template Snapshot::Snapshot(const BasicNetwork<float>&, const RunState&, const bool);
+
+void Snapshot::write(const std::string &filename) const {
+    std::ofstream outf(filename, std::ios::binary);
+    if (!outf.is_open()) throw(OUTPUT_ERROR("Cannot write to file " + filename));
+    const std::vector<char> padding(SECTION_ALIGN, 0);
+    outf.write((const char*)&head, sizeof(head));
+    outf.write(padding.data(), head.offset[0]-sizeof(head));
+    for (int s=0; s<NUM_SECTIONS; s++) {
+        size_t nb = section_bytes(head, s), end = (s+1<NUM_SECTIONS) ? head.offset[s+1] : head.file_size;
+        if (nb) outf.write((const char*)data[s], nb);
+        outf.write(padding.data(), end-head.offset[s]-nb);
+    }
+    outf.close();
+    if (outf.fail()) throw(OUTPUT_ERROR("Cannot write to file " + filename));
+}
+
+void Snapshot::save(const Network &net, const std::string &filename, const RunState &rs) {
+    Snapshot(net, rs).write(filename);
+}
+
+Snapshot::RunState Snapshot::load(Network &net, const std::string &filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) throw(CFILE_ERROR("Could not open network file " + filename));
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header)) {
+        close(fd);
+        throw(CFILE_ERROR("Not a network snapshot: " + filename));
+    }
+    size_t fsize = st.st_size;
+    void *addr = mmap(nullptr, fsize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) throw(CFILE_ERROR("Could not map network file " + filename));
+    std::shared_ptr<void> mapping(addr, [fsize] (void *p) {munmap(p, fsize);});
+    char *base = static_cast<char*>(addr);
+    const Header &h = *reinterpret_cast<const Header*>(base);
+    if (std::memcmp(h.magic, SNAP_MAGIC, 8) != 0 || h.byte_order != BYTE_ORDER_MARK)
+        throw(CFILE_ERROR("Not a network snapshot: " + filename));
+    if (h.version != version)
+        throw(CFILE_ERROR("Unsupported network snapshot version in " + filename));
+    if (h.file_size != fsize || h.num_types > 255 || h.ring_slots > _MAX_DELAY_)
+        throw(CFILE_ERROR("Corrupted network snapshot: " + filename));
+// --- bounded sizes first, so that the section sizes cannot wrap around
+    if (h.num_neurons >= fsize/8 || h.num_links > fsize/8)
+        throw(CFILE_ERROR("Corrupted network snapshot: " + filename));
+    for (int s=0; s<NUM_SECTIONS; s++) {
+        const size_t bytes = section_bytes(h, s);
+        if (h.offset[s] % SECTION_ALIGN || bytes > fsize || h.offset[s] > fsize-bytes)
+            throw(CFILE_ERROR("Corrupted network snapshot: " + filename));
+    }
+    size_t n = h.num_neurons, e = h.num_links;
+    auto section = [&] (int s) {return base+h.offset[s];};
+    const unsigned char *tid = (const unsigned char*)section(TYPE_ID);
+    if (n && *std::max_element(tid, tid+n) >= h.num_types)
+        throw(CFILE_ERROR("Corrupted network snapshot: " + filename));
+// --- the CSR arrays are read without checks by step: the offsets must be increasing from 0 to e, 
+// --- the rows strictly increasing and in range, and each direction the transpose of the other (same degrees)
+    const int starts[2] = {ROW_START, OUT_START}, indices[2] = {SOURCES, TARGETS}, delays[2] = {DELAYS, OUT_DELAYS};
+    std::vector<size_t> counts[2];
+    for (int k=0; k<2; k++) {
+        const size_t *start = (const size_t*)section(starts[k]), *idx = (const size_t*)section(indices[k]);
+        if (start[0] != 0 || start[n] != e) throw(CFILE_ERROR("Corrupted network snapshot: " + filename));
+        for (size_t j=0; j<n; j++)
+            if (start[j] > start[j+1]) throw(CFILE_ERROR("Corrupted network snapshot: " + filename));
+        counts[k].assign(n, 0);
+        for (size_t r=0; r<n; r++)
+            for (size_t j=start[r]; j<start[r+1]; j++) {
+                if (idx[j] >= n || (j > start[r] && idx[j] <= idx[j-1]))
+                    throw(CFILE_ERROR("Corrupted network snapshot: " + filename));
+                counts[k][idx[j]]++;
+            }
+        if (h.ring_slots < 2) continue;
+        const uint8_t *del = (const uint8_t*)section(delays[k]);
+        for (size_t j=0; j<e; j++)
+            if (del[j] < 1 || del[j] > h.ring_slots) throw(CFILE_ERROR("Corrupted network snapshot: " + filename));
+    }
+    for (int k=0; k<2; k++) {
+        const size_t *start = (const size_t*)section(starts[1-k]);
+        for (size_t j=0; j<n; j++)
+            if (counts[k][j] != start[j+1]-start[j]) throw(CFILE_ERROR("Corrupted network snapshot: " + filename));
+    }
+// --- the external indices must be a permutation
+    std::vector<size_t> internal_ids;
+    if (h.reordered) {
+        const size_t *ext = (const size_t*)section(EXTERNAL_IDS);
+        internal_ids.assign(n, n);
+        for (size_t k=0; k<n; k++) {
+            if (ext[k] >= n || internal_ids[ext[k]] != n) throw(CFILE_ERROR("Corrupted network snapshot: " + filename));
+            internal_ids[ext[k]] = k;
+        }
+    }
+    NeuronPopulation &pop = net.neurons;
+    pop.type_names.clear();
+    for (size_t k=0; k<h.num_types; k++) {
+        const char *nm = section(TYPE_NAMES)+k*type_name_size;
+        pop.type_names.push_back(std::string(nm, strnlen(nm, type_name_size)));
+    }
+    pop.type_id.map((unsigned char*)section(TYPE_ID), n, mapping);
+    pop.inhib.map(section(INHIB), n, mapping);
+    pop.a.map((double*)section(PAR_A), n, mapping);
+    pop.b.map((double*)section(PAR_B), n, mapping);
+    pop.c.map((double*)section(PAR_C), n, mapping);
+    pop.d.map((double*)section(PAR_D), n, mapping);
+    pop.w.map((double*)section(PAR_W), n, mapping);
+    pop.v.map((double*)section(VAR_V), n, mapping);
+    pop.u.map((double*)section(VAR_U), n, mapping);
+    pop.I.map((double*)section(VAR_I), n, mapping);
+    pop.spikes_valid = false;
+    pop.classified = false;
+    SynapseTable &syn = net.synapses;
+    syn.row_start.map((size_t*)section(ROW_START), n+1, mapping);
+    syn.sources.map((size_t*)section(SOURCES), e, mapping);
+    syn.weights.map((double*)section(WEIGHTS), e, mapping);
+    syn.out_start.map((size_t*)section(OUT_START), n+1, mapping);
+    syn.targets.map((size_t*)section(TARGETS), e, mapping);
+    syn.out_weights.map((double*)section(OUT_WEIGHTS), e, mapping);
+    syn.delays.clear();
+    syn.out_delays.clear();
+    net.external_ids.clear();
+    if (h.reordered) net.external_ids.map((size_t*)section(EXTERNAL_IDS), n, mapping);
+    net.internal_ids.swap(internal_ids);
+    net.ring_slots = std::max(h.ring_slots, (uint64_t)1);
+    net.ring_pos = 0;
+    net.links.clear();
+    net.init_buffers();
+    if (net.ring_slots > 1) {
+        syn.delays.map((uint8_t*)section(DELAYS), e, mapping);
+        syn.out_delays.map((uint8_t*)section(OUT_DELAYS), e, mapping);
+        const double *pending[2] = {(const double*)section(PENDING_EXC), (const double*)section(PENDING_INH)};
+        net.exc_input.assign(pending[0], pending[0]+n*net.ring_slots);
+        net.inh_input.assign(pending[1], pending[1]+n*net.ring_slots);
+    }
+    return RunState(h.time, h.seed, h.rng_position, h.rs_complement != 0);
+}
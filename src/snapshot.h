@@ -0,0 +1,90 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "network.h"
+
+/*! \class Snapshot
+  Saves a \ref Network to a binary file and loads it back by memory-mapping the file.
+
+  The file holds a fixed header followed by one section per array of the network:
+  neuron types, parameters and dynamic state (\ref NeuronPopulation), and the CSR arrays of the links
+  (\ref SynapseTable), each section starting on a 64-byte boundary.
+  The arrays are stored exactly as in memory (native byte order, 64-bit indices),
+  so that \ref load maps the file (privately, copy-on-write) and uses the arrays in place, without parsing or copying.
+
+  The header records a format \ref version and a byte-order marker, a file written by an incompatible build is rejected.
+  It also holds a \ref RunState, so that a snapshot taken during Simulation::run is a checkpoint from which the run can be resumed.
+  If the links have delays, the file also holds them and the input in transit (the circular buffers of Network::step).
+  If the network has been reordered (Network::reorder), the file holds the external index of each neuron.
+
+  A Snapshot object is an image of a network ready to be written: it refers to the arrays of the network,
+  except for the dynamic variables which can be copied (\p copy_state), so that the image can be written
+  on another thread while the simulation goes on (the parameters and links must not change meanwhile).
+  The file is always in double precision: the arrays of a single precision network are converted (and copied),
+  and it is loaded as a \ref Network.
+ */
+
+class Snapshot {
+
+public:
+    static const uint32_t version = 5;
+/*!
+  State of a simulation run: last time-step done, seed and position of the sequential counter of \ref _RNG,
+  and whether the RS neurons are the complement of the other types in Simulation::ntypes (random networks) 
+  or a type of their own (configuration files), which sets the order of the trajectory columns.
+ */
+    struct RunState {
+        RunState(const uint64_t t=0, const uint64_t s=0, const uint64_t p=0, const bool c=true) 
+            : time(t), seed(s), rng_position(p), rs_complement(c) {}
+        uint64_t time, seed, rng_position, rs_complement;
+    };
+/*!
+  Captures network \p net and run state \p rs, copying the membrane potentials, recovery variables and inputs if \p copy_state.
+ */
+    template<typename Real>
+    Snapshot(const BasicNetwork<Real> &net, const RunState &rs, const bool copy_state=false);
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+/*!
+  Writes the image to file \p filename, throws an OUTPUT_ERROR if it fails.
+ */
+    void write(const std::string &filename) const;
+/*!
+  Writes network \p net (and run state \p rs) to file \p filename, throws an OUTPUT_ERROR if it fails.
+ */
+    static void save(const Network &net, const std::string &filename, const RunState &rs=RunState());
+/*!
+  Replaces network \p net with the content of file \p filename, throws a CFILE_ERROR if the file is not a valid snapshot.
+  \return the run state saved with the network.
+ */
+    static RunState load(Network &net, const std::string &filename);
+
+private:
+    enum Section {TYPE_NAMES, TYPE_ID, INHIB, PAR_A, PAR_B, PAR_C, PAR_D, PAR_W, VAR_V, VAR_U, VAR_I,
+                  ROW_START, SOURCES, WEIGHTS, OUT_START, TARGETS, OUT_WEIGHTS, 
+                  DELAYS, OUT_DELAYS, PENDING_EXC, PENDING_INH, EXTERNAL_IDS, NUM_SECTIONS};
+    static const size_t type_name_size = 16;
+    struct Header {
+        char magic[8];
+        uint32_t version, byte_order;
+        uint64_t num_neurons, num_links, num_types;
+        uint64_t time, seed, rng_position, rs_complement;
+        uint64_t ring_slots, reordered;
+        uint64_t offset[NUM_SECTIONS];
+        uint64_t file_size;
+    };
+    static size_t section_bytes(const Header&, const int);
+/*!
+  Points section \p s to array \p arr, or to a copy in double precision if \p copy or if the array is not in double precision.
+ */
+    template<typename Real>
+    void set_section(const int s, const ArrayStore<Real> &arr, const bool copy);
+
+    Header head;
+    std::vector<char> names;
+    std::vector<double> copies[NUM_SECTIONS];
+    const void *data[NUM_SECTIONS];
+
+};
+
+#endif //SNAPSHOT_H
@@ -0,0 +1,76 @@
+#ifndef SPIKES_H
+#define SPIKES_H
+
+#include "globals.h"
+
+/*! \class SpikeList
+  The set of neurons firing at one time-step, as filled by Network::step, reused from step to step.
+
+  The spikes are held both as a sorted list of neuron indices (to iterate over them)
+  and as a bitset of one bit per neuron (to test membership in O(1) with \ref contains,
+  and count the spikes of a range of neurons with \ref count, one population count per 64 neurons).
+  \ref assign only touches the bits of the previous and new spikes, and the list keeps its capacity,
+  so that once the list has grown to the largest number of spikes, filling it does not allocate memory.
+ */
+
+class SpikeList {
+
+public:
+/*!
+  Empty list for a network of \p n neurons.
+ */
+    SpikeList(const size_t n=0) {resize(n);}
+/*!
+  Sets the number of neurons to \p n and empties the list.
+ */
+    void resize(const size_t n) {
+        neurons = n;
+        indices.clear();
+        bits.assign((n+63)/64, 0);
+    }
+    size_t num_neurons() const {return neurons;}
+    void clear() {
+        for (auto nn : indices) bits[nn>>6] = 0;
+        indices.clear();
+    }
+/*!
+  Replaces the spikes by the neuron indices in [\p first, \p last), in increasing order.
+ */
+    template<typename It>
+    void assign(It first, It last) {
+        clear();
+        for (; first!=last; ++first) {
+            indices.push_back(*first);
+            bits[*first>>6] |= uint64_t(1) << (*first & 63);
+        }
+    }
+    bool contains(const size_t n) const {return (bits[n>>6] >> (n & 63)) & 1;}
+/*!
+  Number of spikes among neurons [\p begin, \p end).
+ */
+    size_t count(const size_t begin, const size_t end) const {
+        if (begin >= end) return 0;
+        size_t first = begin>>6, last = (end-1)>>6, total = 0;
+        for (size_t k=first; k<=last; k++) {
+            uint64_t w = bits[k];
+            if (k == first) w &= ~uint64_t(0) << (begin & 63);
+            if (k == last && (end & 63)) w &= ~(~uint64_t(0) << (end & 63));
+            total += __builtin_popcountll(w);
+        }
+        return total;
+    }
+    size_t size() const {return indices.size();}
+    bool empty() const {return indices.empty();}
+    size_t operator[](const size_t k) const {return indices[k];}
+    std::vector<size_t>::const_iterator begin() const {return indices.begin();}
+    std::vector<size_t>::const_iterator end() const {return indices.end();}
+    const std::vector<size_t>& list() const {return indices;}
+
+private:
+    size_t neurons = 0;
+    std::vector<size_t> indices;
+    std::vector<uint64_t> bits;
+
+};
+
+#endif //SPIKES_H
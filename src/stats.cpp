@@ -0,0 +1,179 @@
+#include "stats.h"
+
+namespace {
+
+template<typename T>
+void write_list(std::ostream &out, const std::vector<T> &vals, size_t n) {
+    out << "[";
+    for (size_t k=0; k<n; k++) out << (k ? ", " : "") << vals[k];
+    out << "]";
+}
+
+}
+
+template<typename Real>
+PopulationStats::PopulationStats(const BasicNetwork<Real> &net, const int window, const size_t isi_bins)
+    : win_steps(std::max(window, 1)) {
+    const size_t n = net.size();
+    std::map<std::string, unsigned char> ids;
+    for (size_t k=0; k<n; k++) ids[net.type(k)] = 0;
+    for (auto &I : ids) {
+        I.second = names.size();
+        names.push_back(I.first);
+    }
+    names.push_back("all");
+// --- bin k counts the intervals of k+1 time-steps, the last bin the longer ones
+    Group empty{0, 0, 0, 0, 0., 0., std::vector<uint64_t>(std::max(isi_bins, (size_t)1)+1, 0), {}};
+    groups.assign(names.size(), empty);
+    group_of.resize(n);
+    for (size_t k=0; k<n; k++) {
+        group_of[k] = ids[net.type(k)];
+        groups[group_of[k]].neurons++;
+    }
+    groups.back().neurons = n;
+    count.assign(n, 0);
+    window_count.assign(n, 0);
+    last_spike.assign(n, -1);
+    count_sumsq.assign(n, 0.);
+    active.reserve(n);
+}
+
+template PopulationStats::PopulationStats(const BasicNetwork<double>&, const int, const size_t);
+template PopulationStats::PopulationStats(const BasicNetwork<float>&, const int, const size_t);
+
+template<typename Spikes>
+void PopulationStats::record(const int time, const Spikes &spikes) {
+    const size_t nbins = groups.back().isi_hist.size()-1;
+    for (auto nn : spikes) {
+        count[nn]++;
+        if (window_count[nn]++ == 0) active.push_back(nn);
+        const int isi = (last_spike[nn] >= 0) ? time-last_spike[nn] : 0;
+        last_spike[nn] = time;
+        for (Group *g : {&groups[group_of[nn]], &groups.back()}) {
+            g->spikes++;
+            g->window_spikes++;
+            if (isi <= 0) continue;
+            g->isi_count++;
+            g->isi_sum += isi;
+            g->isi_sumsq += (double)isi*isi;
+            g->isi_hist[std::min((size_t)isi, nbins+1)-1]++;
+        }
+    }
+    num_steps++;
+    if (++steps_in_window == (size_t)win_steps) close_window();
+}
+
+template void PopulationStats::record(const int, const SpikeList&);
+template void PopulationStats::record(const int, const std::vector<size_t>&);
+
+void PopulationStats::close_window() {
+    for (auto nn : active) {
+        count_sumsq[nn] += (double)window_count[nn]*window_count[nn];
+        window_count[nn] = 0;
+    }
+    active.clear();
+    for (auto &g : groups) {
+        g.series.push_back(g.window_spikes);
+        g.window_spikes = 0;
+    }
+    num_windows++;
+    steps_in_window = 0;
+}
+
+double PopulationStats::rate(const size_t g) const {
+    if (!groups[g].neurons || !num_steps) return 0;
+    return 1000.*groups[g].spikes/groups[g].neurons/num_steps;
+}
+
+double PopulationStats::silent_fraction(const size_t g) const {
+    if (!groups[g].neurons) return 0;
+    const bool all = (g+1 == groups.size());
+    size_t silent = 0;
+    for (size_t k=0; k<count.size(); k++)
+        if ((all || group_of[k] == g) && !count[k]) silent++;
+    return (double)silent/groups[g].neurons;
+}
+
+double PopulationStats::isi_mean(const size_t g) const {
+    const Group &gr = groups[g];
+    return gr.isi_count ? gr.isi_sum/gr.isi_count : 0;
+}
+
+double PopulationStats::isi_cv(const size_t g) const {
+    const Group &gr = groups[g];
+    if (!gr.isi_count) return 0;
+    const double m = gr.isi_sum/gr.isi_count;
+    return std::sqrt(std::max(gr.isi_sumsq/gr.isi_count - m*m, 0.))/m;
+}
+
+std::vector<double> PopulationStats::rate_series(const size_t g) const {
+    const Group &gr = groups[g];
+    std::vector<double> res;
+    if (!gr.neurons) return res;
+    for (auto s : gr.series) res.push_back(1000.*s/gr.neurons/win_steps);
+    if (steps_in_window) res.push_back(1000.*gr.window_spikes/gr.neurons/steps_in_window);
+    return res;
+}
+
+double PopulationStats::fano_factor(const size_t g) const {
+    const Group &gr = groups[g];
+    if (!num_windows) return 0;
+    double sum = 0, sumsq = 0;
+    for (auto s : gr.series) {
+        sum += s;
+        sumsq += (double)s*s;
+    }
+    const double m = sum/num_windows;
+    return (m > 0) ? std::max(sumsq/num_windows - m*m, 0.)/m : 0;
+}
+
+double PopulationStats::synchrony(const size_t g) const {
+    const Group &gr = groups[g];
+    if (num_windows < 2 || !gr.neurons) return 0;
+    const double K = num_windows;
+    double sum = 0, sumsq = 0;
+    for (auto s : gr.series) {
+        const double x = (double)s/gr.neurons;
+        sum += x;
+        sumsq += x*x;
+    }
+    const double pop_var = sumsq/K - (sum/K)*(sum/K);
+// --- counts of the complete windows only: the current window is not in the sums of squares
+    const bool all = (g+1 == groups.size());
+    double neuron_var = 0;
+    for (size_t k=0; k<count.size(); k++) {
+        if (!all && group_of[k] != g) continue;
+        const double m = (count[k]-window_count[k])/K;
+        neuron_var += count_sumsq[k]/K - m*m;
+    }
+    neuron_var /= gr.neurons;
+    return (neuron_var > 0) ? std::max(pop_var, 0.)/neuron_var : 0;
+}
+
+void PopulationStats::write_json(std::ostream *_out) const {
+    (*_out) << "{\n  \"steps\": " << num_steps
+            << ",\n  \"window\": " << win_steps
+            << ",\n  \"isi_bins\": " << groups.back().isi_hist.size()-1
+            << ",\n  \"groups\": [";
+    for (size_t g=0; g<groups.size(); g++) {
+        const std::vector<uint64_t> &hist = groups[g].isi_hist;
+        size_t nbins = hist.size();
+        while (nbins && !hist[nbins-1]) nbins--;
+        (*_out) << (g ? "," : "") << "\n    {\"type\": \"" << names[g] << "\""
+                << ", \"neurons\": " << groups[g].neurons
+                << ", \"spikes\": " << groups[g].spikes
+                << ", \"rate_hz\": " << rate(g)
+                << ", \"silent_fraction\": " << silent_fraction(g)
+                << ", \"isi_mean\": " << isi_mean(g)
+                << ", \"isi_cv\": " << isi_cv(g)
+                << ", \"fano_factor\": " << fano_factor(g)
+                << ", \"synchrony\": " << synchrony(g)
+                << ",\n     \"isi_histogram\": ";
+        write_list(*_out, hist, nbins);
+        const std::vector<double> series(rate_series(g));
+        (*_out) << ",\n     \"rate_series_hz\": ";
+        write_list(*_out, series, series.size());
+        (*_out) << "}";
+    }
+    (*_out) << "\n  ]\n}" << std::endl;
+}
@@ -0,0 +1,112 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "network.h"
+
+/*! \class PopulationStats
+  Statistics of the activity of a network, accumulated during the run from the spikes of each time-step
+  (option --stats of \ref Simulation), so that the raster does not have to be written and post-processed.
+
+  The neurons are grouped by type (see Neuron::NeuronTypes), plus one group for the whole population.
+  For each group, \ref record accumulates in O(spikes) per time-step:
+  - the number of spikes (mean firing rate, fraction of silent neurons),
+  - the inter-spike intervals (ISI) of its neurons: mean, coefficient of variation and a histogram of one bin per time-step
+    (the last bin counts the longer intervals),
+  - the number of spikes in consecutive windows of \ref window time-steps (population rate series), and
+    for each neuron the sum of squares of its window counts, from which \ref synchrony is reduced at the end.
+
+  Rates are given in Hz, a time-step being 1 ms in the Izhikevich model.
+ */
+
+class PopulationStats {
+
+public:
+/*!
+  Statistics of the neurons of \p net (their types are read once).
+  \param window : number of time-steps of the windows of the rate series,
+  \param isi_bins : number of bins of one time-step of the ISI histograms, which have one more bin for the longer intervals.
+ */
+    template<typename Real>
+    PopulationStats(const BasicNetwork<Real> &net, const int window=_STATS_WINDOW_, const size_t isi_bins=_ISI_BINS_);
+/*!
+  Adds the spikes of time-step \p time (time-steps are recorded in increasing order),
+  \p spikes is a \ref SpikeList or a std::vector of neuron indices (see TrialBatch::spikes).
+ */
+    template<typename Spikes>
+    void record(const int time, const Spikes &spikes);
+/*!
+  Reserves the rate series of a run of \p steps time-steps, so that \ref record makes no allocation.
+ */
+    void reserve(const size_t steps) {
+        for (auto &g : groups) g.series.reserve(steps/win_steps+1);
+    }
+/*! @name Groups
+  Groups 0 to \ref num_groups-2 are the neuron types in alphabetical order, the last one is the whole population ("all").
+ */
+///@{
+    size_t num_groups() const {return names.size();}
+    const std::string& group_name(const size_t g) const {return names[g];}
+    size_t group_size(const size_t g) const {return groups[g].neurons;}
+///@}
+    size_t steps() const {return num_steps;}
+    int window() const {return win_steps;}
+/*! @name Statistics of group g */
+///@{
+    uint64_t spikes(const size_t g) const {return groups[g].spikes;}
+    double rate(const size_t g) const;
+/*!
+  Fraction of the neurons which have not fired.
+ */
+    double silent_fraction(const size_t g) const;
+    double isi_mean(const size_t g) const;
+    double isi_cv(const size_t g) const;
+    const std::vector<uint64_t>& isi_histogram(const size_t g) const {return groups[g].isi_hist;}
+/*!
+  Population rate (Hz) in each window, the last one can be shorter than \ref window.
+ */
+    std::vector<double> rate_series(const size_t g) const;
+/*!
+  Fano factor (variance over mean) of the number of spikes of the group in the complete windows.
+ */
+    double fano_factor(const size_t g) const;
+/*!
+  Synchrony measure of Golomb (Scholarpedia, 2007) over the complete windows: the variance of the population rate
+  divided by the mean variance of the rates of its neurons, 1 for fully synchronous neurons, close to 0 for independent ones.
+ */
+    double synchrony(const size_t g) const;
+///@}
+/*!
+  Writes the statistics of all groups as JSON, the ISI histograms without their trailing empty bins
+  (*isi_bins* is the number of bins given to the constructor, without the bin of the longer intervals).
+ */
+    void write_json(std::ostream *_out) const;
+
+private:
+    void close_window();
+
+    struct Group {
+        size_t neurons;
+        uint64_t spikes, window_spikes, isi_count;
+        double isi_sum, isi_sumsq;
+        std::vector<uint64_t> isi_hist, series;
+    };
+    std::vector<std::string> names;
+    std::vector<Group> groups;
+/*! @name Per-neuron counters
+  \ref group_of is the group of each neuron, \ref last_spike the time-step of its last spike (-1 if none),
+  \ref window_count its spikes in the current window and \ref count_sumsq the sum of squares of its counts in the complete windows.
+  \ref active lists the neurons which have fired in the current window.
+ */
+///@{
+    std::vector<unsigned char> group_of;
+    std::vector<uint32_t> count, window_count;
+    std::vector<int> last_spike;
+    std::vector<double> count_sumsq;
+    std::vector<size_t> active;
+///@}
+    int win_steps;
+    size_t num_steps = 0, num_windows = 0, steps_in_window = 0;
+
+};
+
+#endif //STATS_H
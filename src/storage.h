@@ -0,0 +1,105 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include "globals.h"
+#include <cstdint>
+#include <memory>
+#include <new>
+
+/*! \class AlignedAllocator
+  Minimal allocator returning storage aligned on \p Align bytes (a cache line by default),
+  so that the arrays of \ref NeuronPopulation can be loaded in full SIMD registers.
+  The memory comes from the global operator new (so that a replacement, such as the allocation audit of the tests, sees it):
+  the block is aligned by hand and the pointer to free is stored just before the aligned storage.
+ */
+template<typename T, size_t Align=64>
+struct AlignedAllocator {
+    typedef T value_type;
+    template<typename U> struct rebind {typedef AlignedAllocator<U, Align> other;};
+    AlignedAllocator() {}
+    template<typename U> AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+    T* allocate(size_t n) {
+        char *raw = static_cast<char*>(::operator new(n*sizeof(T) + 2*Align + sizeof(void*)));
+        uintptr_t p = (reinterpret_cast<uintptr_t>(raw) + sizeof(void*) + Align-1) / Align * Align;
+        reinterpret_cast<void**>(p)[-1] = raw;
+        return reinterpret_cast<T*>(p);
+    }
+    void deallocate(T *p, size_t) {::operator delete(reinterpret_cast<void**>(p)[-1]);}
+};
+template<typename T, typename U, size_t A>
+bool operator==(const AlignedAllocator<T, A>&, const AlignedAllocator<U, A>&) {return true;}
+template<typename T, typename U, size_t A>
+bool operator!=(const AlignedAllocator<T, A>&, const AlignedAllocator<U, A>&) {return false;}
+
+/*! \class ArrayStore
+  A contiguous aligned array which either owns its memory (like a std::vector)
+  or is a view of an external memory block, typically a memory-mapped \ref Snapshot file.
+
+  Reading and writing elements works the same in both cases. The operations which change the size
+  first copy a mapped array into owned memory.
+  The mapping is kept alive by a shared pointer as long as an array refers to it.
+ */
+template<typename T>
+class ArrayStore {
+
+public:
+    typedef std::vector<T, AlignedAllocator<T> > vector_type;
+    ArrayStore() {}
+    ArrayStore(std::initializer_list<T> il) : owned(il) {attach();}
+    ArrayStore(const size_t n, const T &x) : owned(n, x) {attach();}
+    ArrayStore(const ArrayStore &other) : owned(other.begin(), other.end()) {attach();}
+    ArrayStore(ArrayStore &&other) {swap(other);}
+    ArrayStore& operator=(ArrayStore other) {swap(other); return *this;}
+/*!
+  Makes this array a view of the \p n elements at \p p, \p keep holds the underlying memory.
+ */
+    void map(T *p, const size_t n, std::shared_ptr<void> keep) {
+        vector_type().swap(owned);
+        ptr = p;
+        len = n;
+        mapping = keep;
+    }
+    bool is_mapped() const {return (bool)mapping;}
+    void swap(ArrayStore &other) {
+        owned.swap(other.owned);
+        std::swap(ptr, other.ptr);
+        std::swap(len, other.len);
+        mapping.swap(other.mapping);
+    }
+    size_t size() const {return len;}
+    bool empty() const {return len == 0;}
+    T* data() {return ptr;}
+    const T* data() const {return ptr;}
+    T& operator[](const size_t k) {return ptr[k];}
+    const T& operator[](const size_t k) const {return ptr[k];}
+    T* begin() {return ptr;}
+    T* end() {return ptr+len;}
+    const T* begin() const {return ptr;}
+    const T* end() const {return ptr+len;}
+    void reserve(const size_t n) {detach(); owned.reserve(n); attach();}
+    void resize(const size_t n, const T &x=T()) {detach(); owned.resize(n, x); attach();}
+    void assign(const size_t n, const T &x) {detach(); owned.assign(n, x); attach();}
+    template<typename It>
+    void assign(It first, It last) {vector_type tmp(first, last); map_release(); owned.swap(tmp); attach();}
+    void push_back(const T &x) {detach(); owned.push_back(x); attach();}
+    void clear() {map_release(); owned.clear(); attach();}
+
+private:
+    void attach() {ptr = owned.data(); len = owned.size();}
+    void map_release() {mapping.reset();}
+    void detach() {
+        if (!mapping) return;
+        vector_type tmp(ptr, ptr+len);
+        owned.swap(tmp);
+        mapping.reset();
+        attach();
+    }
+
+    vector_type owned;
+    T *ptr = nullptr;
+    size_t len = 0;
+    std::shared_ptr<void> mapping;
+
+};
+
+#endif //STORAGE_H
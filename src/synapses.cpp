@@ -0,0 +1,137 @@
+#include "synapses.h"
+
+template<typename Real> template<typename Other>
+BasicSynapseTable<Real>::BasicSynapseTable(const BasicSynapseTable<Other> &other)
+    : row_start(other.row_start), sources(other.sources), delays(other.delays), 
+      out_start(other.out_start), targets(other.targets), out_delays(other.out_delays) {
+    weights.assign(other.weights.begin(), other.weights.end());
+    out_weights.assign(other.out_weights.begin(), other.out_weights.end());
+}
+
+template<typename Real>
+void BasicSynapseTable<Real>::build(const size_t n, const linkmap &lm) {
+    clear();
+    merge(n, lm);
+}
+
+template<typename Real>
+void BasicSynapseTable<Real>::build(const size_t n, const edgelist &el) {
+    ArrayStore<size_t> new_start(n+1, 0);
+    for (auto &e : el) if (e.target<n && e.source<n) new_start[e.target+1]++;
+    for (size_t a=0; a<n; a++) new_start[a+1] += new_start[a];
+// --- scatter the link positions by row, a row keeps the order of the list
+    std::vector<size_t> order(new_start[n]), pos(new_start.begin(), new_start.end()-1);
+    for (size_t k=0; k<el.size(); k++)
+        if (el[k].target<n && el[k].source<n) order[pos[el[k].target]++] = k;
+    ArrayStore<size_t> new_sources;
+    ArrayStore<Real> new_weights;
+    ArrayStore<uint8_t> new_delays;
+    const bool with_delays = std::any_of(el.begin(), el.end(), [] (const Synapse &e) {return e.delay > 1;});
+    new_sources.reserve(order.size());
+    new_weights.reserve(order.size());
+    if (with_delays) new_delays.reserve(order.size());
+    auto by_source = [&el] (const size_t i, const size_t j) {
+        return el[i].source<el[j].source || (el[i].source==el[j].source && i<j);
+    };
+    size_t begin = 0;
+    for (size_t a=0; a<n; a++) {
+        size_t end = new_start[a+1];
+        std::sort(order.begin()+begin, order.begin()+end, by_source);
+        for (size_t k=begin; k<end; k++) {
+            const Synapse &e = el[order[k]];
+            if (k>begin && e.source==el[order[k-1]].source) continue;
+            new_sources.push_back(e.source);
+            new_weights.push_back(e.weight);
+            if (with_delays) new_delays.push_back(std::max(1, std::min(e.delay, _MAX_DELAY_)));
+        }
+        new_start[a+1] = new_sources.size();
+        begin = end;
+    }
+    row_start.swap(new_start);
+    sources.swap(new_sources);
+    weights.swap(new_weights);
+    delays.swap(new_delays);
+    index_outgoing();
+}
+
+template<typename Real>
+void BasicSynapseTable<Real>::merge(const size_t n, const linkmap &lm) {
+    ArrayStore<size_t> new_start(n+1, 0), new_sources;
+    ArrayStore<Real> new_weights;
+    ArrayStore<uint8_t> new_delays;
+    new_sources.reserve(num_links()+lm.size());
+    new_weights.reserve(num_links()+lm.size());
+    auto I = lm.begin();
+    for (size_t a=0; a<n; a++) {
+        size_t k = 0, kend = 0;
+        if (a<size()) {
+            k = row_begin(a);
+            kend = row_end(a);
+        }
+        for (; I!=lm.end() && I->first.first<a; ++I);
+// --- merge the two sorted lists of sending neurons, existing links first
+        while (k<kend || (I!=lm.end() && I->first.first==a)) {
+            bool take_old = (k<kend)
+                && (I==lm.end() || I->first.first!=a || sources[k]<=I->first.second);
+            size_t b = take_old ? sources[k] : I->first.second;
+            double w = take_old ? weights[k] : I->second;
+// --- new links have the default delay
+            int dl = take_old ? delay(k) : 1;
+            if (take_old) {
+                if (I!=lm.end() && I->first.first==a && I->first.second==b) ++I;
+                k++;
+            } else ++I;
+            if (b>=n) continue;
+            new_sources.push_back(b);
+            new_weights.push_back(w);
+            if (has_delays()) new_delays.push_back(dl);
+        }
+        new_start[a+1] = new_sources.size();
+    }
+    row_start.swap(new_start);
+    sources.swap(new_sources);
+    weights.swap(new_weights);
+    delays.swap(new_delays);
+    index_outgoing();
+}
+
+template<typename Real>
+void BasicSynapseTable<Real>::allocate(const std::vector<int> &degrees, const bool with_delays) {
+    row_start.assign(degrees.size()+1, 0);
+    for (size_t a=0; a<degrees.size(); a++) row_start[a+1] = row_start[a]+degrees[a];
+    sources.assign(row_start[degrees.size()], 0);
+    weights.assign(row_start[degrees.size()], 0.0);
+    if (with_delays) delays.assign(row_start[degrees.size()], 1);
+    else delays.clear();
+}
+
+template<typename Real>
+void BasicSynapseTable<Real>::index_outgoing() {
+    size_t n = size();
+    out_start.assign(n+1, 0);
+    for (auto b : sources) out_start[b+1]++;
+    for (size_t b=0; b<n; b++) out_start[b+1] += out_start[b];
+    targets.resize(num_links());
+    out_weights.resize(num_links());
+    if (has_delays()) out_delays.resize(num_links());
+    else out_delays.clear();
+    std::vector<size_t> pos(out_start.begin(), out_start.end()-1);
+    for (size_t a=0; a<n; a++)
+        for (size_t k=row_begin(a); k<row_end(a); k++) {
+            size_t &p = pos[sources[k]];
+            targets[p] = a;
+            out_weights[p] = weights[k];
+            if (has_delays()) out_delays[p] = delays[k];
+            p++;
+        }
+}
+
+template<typename Real>
+bool BasicSynapseTable<Real>::contains(const size_t &a, const size_t &b) const {
+    if (a>=size()) return false;
+    return std::binary_search(sources.begin()+row_begin(a), sources.begin()+row_end(a), b);
+}
+
+template class BasicSynapseTable<double>;
+template class BasicSynapseTable<float>;
+template BasicSynapseTable<float>::BasicSynapseTable(const BasicSynapseTable<double>&);
@@ -0,0 +1,133 @@
+#ifndef SYNAPSES_H
+#define SYNAPSES_H
+
+#include "globals.h"
+#include "storage.h"
+
+/*! \class BasicSynapseTable
+  A frozen, compressed-sparse-row (CSR) index of the links of a \ref Network.
+
+  Links are grouped by receiving neuron: the incoming links of neuron *n* occupy
+  the positions \ref row_begin "row_begin(n)" to \ref row_end "row_end(n)" of the contiguous
+  arrays \ref sources (sending neurons, in increasing order) and \ref weights (link intensities).
+  Access to the incoming links of a neuron is therefore O(in-degree).
+
+  The table is built in one pass from a sorted \ref linkmap or an \ref edgelist with \ref build,
+  or extended with new links with \ref merge, or filled directly after \ref allocate. The arrays are \ref ArrayStore "ArrayStores", 
+  they can be mapped from a \ref Snapshot file without copy.
+
+  The same links are also indexed by sending neuron (transposed table): the outgoing links of neuron *n*
+  occupy the positions \ref out_begin "out_begin(n)" to \ref out_end "out_end(n)" of \ref targets and \ref out_weights,
+  in increasing order of receiving neuron. This is used to propagate spikes from the few firing neurons only.
+
+  A link can have a delay of several time-steps (\ref delays, one byte per link, up to \ref _MAX_DELAY_),
+  the array is empty when all links have the default delay of one step.
+
+  The intensities are stored as \p Real, \ref SynapseTable (double) is the reference.
+ */
+
+typedef std::map<std::pair<size_t, size_t>, double> linkmap;
+
+/*!
+  One link of an \ref edgelist: from neuron \p source to neuron \p target with intensity \p weight,
+  a spike reaches the target \p delay time-steps later (0 is read as 1, the next step).
+ */
+struct Synapse {size_t target, source; double weight; int delay;};
+typedef std::vector<Synapse> edgelist;
+
+template<typename Real>
+class BasicSynapseTable {
+
+public:
+    BasicSynapseTable() {}
+/*!
+  Copy of a table of another scalar type, the intensities are converted.
+ */
+    template<typename Other>
+    explicit BasicSynapseTable(const BasicSynapseTable<Other>&);
+/*!
+  Replaces the table by the links in \p lm for a network of \p n neurons.
+  Links involving neurons with an index larger than \p n are dropped.
+ */
+    void build(const size_t n, const linkmap &lm);
+/*!
+  Replaces the table by the links of the unsorted list \p el for a network of \p n neurons,
+  in time linear in the number of links (counting sort by receiving neuron).
+  Links involving neurons with an index larger than \p n are dropped, of several links between the same
+  two neurons only the first one in \p el is kept.
+ */
+    void build(const size_t n, const edgelist &el);
+/*!
+  Adds the links in \p lm to the table (links already present are kept),
+  and resizes the table to \p n neurons.
+ */
+    void merge(const size_t n, const linkmap &lm);
+/*!
+  Replaces the table by empty rows of sizes \p degrees (one per neuron).
+  The rows are then filled in place through \ref source_data and \ref weight_data (and \ref delay_data if \p with_delays),
+  with increasing sending neurons in each row, and indexed by calling \ref index_outgoing.
+ */
+    void allocate(const std::vector<int> &degrees, const bool with_delays=false);
+    void index_outgoing();
+    void clear() {
+        row_start.assign(1, 0); sources.clear(); weights.clear(); delays.clear();
+        out_start.assign(1, 0); targets.clear(); out_weights.clear(); out_delays.clear();
+    }
+/*!
+  Checks if the link from \p b to \p a is present (binary search in the row of \p a).
+ */
+    bool contains(const size_t &a, const size_t &b) const;
+    size_t size() const {return row_start.empty() ? 0 : row_start.size()-1;}
+    size_t num_links() const {return sources.size();}
+    size_t degree(const size_t &n) const {return row_end(n)-row_begin(n);}
+    size_t row_begin(const size_t &n) const {return row_start[n];}
+    size_t row_end(const size_t &n) const {return row_start[n+1];}
+    size_t source(const size_t &k) const {return sources[k];}
+    Real weight(const size_t &k) const {return weights[k];}
+    const size_t* source_data() const {return sources.data();}
+    const Real* weight_data() const {return weights.data();}
+    size_t* source_data() {return sources.data();}
+    Real* weight_data() {return weights.data();}
+/*!
+  Delay of link \p k in time-steps, \ref max_delay is the largest one (1 if the links have no delays).
+ */
+    int delay(const size_t &k) const {return delays.empty() ? 1 : delays[k];}
+    bool has_delays() const {return !delays.empty();}
+    int max_delay() const {return delays.empty() ? 1 : *std::max_element(delays.begin(), delays.end());}
+    uint8_t* delay_data() {return delays.data();}
+    size_t out_degree(const size_t &n) const {return out_end(n)-out_begin(n);}
+    size_t out_begin(const size_t &n) const {return out_start[n];}
+    size_t out_end(const size_t &n) const {return out_start[n+1];}
+    const size_t* target_data() const {return targets.data();}
+    const Real* out_weight_data() const {return out_weights.data();}
+    const uint8_t* out_delay_data() const {return out_delays.data();}
+
+private:
+/*! @name CSR arrays
+  \ref row_start has one entry per neuron plus one,
+  \ref sources, \ref weights and \ref delays (if any) have one entry per link.
+ */
+///@{
+    ArrayStore<size_t> row_start{0};
+    ArrayStore<size_t> sources;
+    ArrayStore<Real> weights;
+    ArrayStore<uint8_t> delays;
+///@}
+/*! @name Transposed CSR arrays
+  Same links as above, grouped by sending neuron, rebuilt by \ref index_outgoing.
+ */
+///@{
+    ArrayStore<size_t> out_start{0};
+    ArrayStore<size_t> targets;
+    ArrayStore<Real> out_weights;
+    ArrayStore<uint8_t> out_delays;
+///@}
+    template<typename> friend class BasicSynapseTable;
+    friend class Snapshot;
+    friend class TrialBatch;
+
+};
+
+typedef BasicSynapseTable<double> SynapseTable;
+
+#endif //SYNAPSES_H
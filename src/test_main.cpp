@@ -1,7 +1,35 @@
 #include <gtest/gtest.h>
 #include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include "batch.h"
+#include "checkpoint.h"
+#include "config.h"
 #include "random.h"
+#include "ranks.h"
+#include "recorder.h"
 #include "simulation.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "writer.h"
+
+/*
+  Allocation audit: the global operator new counts the allocations made (by any thread) while counting is on,
+  including the aligned arrays of ArrayStore (see AlignedAllocator).
+ */
+namespace {
+std::atomic<bool> count_allocations(false);
+std::atomic<size_t> num_allocations(0);
+}
+
+void* operator new(size_t size) {
+    if (count_allocations.load(std::memory_order_relaxed)) num_allocations++;
+    if (void *p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void *p) noexcept {std::free(p);}
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept {std::free(p);}
 
 RandomNumbers *_RNG = new RandomNumbers(101301091);
 Network net;
@@ -21,6 +49,36 @@ TEST(simulationTest, parse) {
     EXPECT_EQ(5, s1.size_type("IB"));
 }
 
+TEST(randomTest, streams) {
+    RandomNumbers rng(2019), rng2(2019);
+    EXPECT_EQ(rng(), rng2());
+    uint64_t pos = rng.position();
+    double x = rng.normal();
+    rng.position(pos);
+    EXPECT_EQ(x, rng.normal());
+// --- stream values do not depend on how the range is split
+    std::vector<double> all(1000), parts(1000);
+    rng.normal(all.data(), 0, 1000, 17, RandomNumbers::THALAMIC, 0, 2);
+    rng2.normal(parts.data(), 0, 333, 17, RandomNumbers::THALAMIC, 0, 2);
+    rng2.normal(parts.data()+333, 333, 1, 17, RandomNumbers::THALAMIC, 0, 2);
+    rng2.normal(parts.data()+334, 334, 666, 17, RandomNumbers::THALAMIC, 0, 2);
+    EXPECT_EQ(all, parts);
+    double mean = 0, sdv = 0;
+    for (auto I : all) {
+        mean += 0.001*I;
+        sdv  += 0.001*I*I;
+    }
+    EXPECT_NEAR(0, mean, 0.2);
+    EXPECT_NEAR(2, std::sqrt(sdv-mean*mean), 0.2);
+    rng.normal(parts.data(), 0, 1000, 18, RandomNumbers::THALAMIC, 0, 2);
+    EXPECT_NE(all, parts);
+    std::vector<int> pois(1000);
+    rng.poisson(pois.data(), 0, 1000, 0, RandomNumbers::DEGREE, 50);
+    mean = 0;
+    for (auto I : pois) mean += 0.001*I;
+    EXPECT_NEAR(50, mean, 1);
+}
+
 TEST(neuronTest, initialize) {
     n1.set_default_params("RS");
     n2.set_default_params("FS");
@@ -46,6 +104,8 @@ TEST(neuronTest, step) {
 }
 
 TEST(networkTest, initialize) {
+// --- the expected firing in networkTest.connect depends on the drawn parameters: start from a fixed position
+    _RNG->position(0);
     net.resize(nlinks);
     EXPECT_EQ(nlinks, net.size());
     double mean = 0, sdv = 0;
@@ -97,6 +157,1049 @@ TEST(networkTest, connect) {
     EXPECT_DOUBLE_EQ(.4*noise, net.neuron(inhib1).input());
 }
 
+TEST(networkTest, synapses) {
+    size_t nlink = net.random_connect(20, 1.);
+    size_t total = 0;
+    std::vector<size_t> outdeg(net.size(), 0);
+    for (size_t nn=0; nn<net.size(); nn++) {
+        std::vector<std::pair<size_t, double> > neigh(net.neighbors(nn));
+        std::pair<size_t, double> dI = net.degree(nn);
+        double valence = 0, exc = 0, inh = 0;
+        for (size_t k=0; k<neigh.size(); k++) {
+            valence += neigh[k].second;
+            (neigh[k].second < 0 ? inh : exc) += std::abs(neigh[k].second);
+            outdeg[neigh[k].first]++;
+            EXPECT_NE(nn, neigh[k].first);
+            if (k>0) {
+                EXPECT_LT(neigh[k-1].first, neigh[k].first);
+            }
+            EXPECT_EQ(net.neuron(neigh[k].first).is_inhibitory(), neigh[k].second<0);
+        }
+        EXPECT_EQ(neigh.size(), dI.first);
+        EXPECT_DOUBLE_EQ(valence, dI.second);
+        EXPECT_DOUBLE_EQ(exc, net.split_valence(nn).first);
+        EXPECT_DOUBLE_EQ(inh, net.split_valence(nn).second);
+        total += dI.first;
+    }
+    for (size_t nn=0; nn<net.size(); nn++) EXPECT_EQ(outdeg[nn], net.out_degree(nn));
+    EXPECT_EQ(nlink, total);
+    EXPECT_NEAR(20, (double)nlink/net.size(), 1);
+// --- a link added after random_connect is merged into the table
+    size_t a = 0, b = 1, deg0 = net.degree(a).first;
+    for (; b<net.size(); b++) 
+        if (net.add_link(a, b, .5)) break;
+    EXPECT_EQ(deg0+1, net.degree(a).first);
+    EXPECT_EQ(deg0+1, net.neighbors(a).size());
+    EXPECT_EQ(outdeg[b]+1, net.out_degree(b));
+    EXPECT_FALSE(net.add_link(a, b, .5));
+}
+
+TEST(networkTest, random) {
+    Network net1, net4;
+    net1.resize(nlinks, .2);
+    net4.resize(nlinks, .2);
+    net4.set_threads(4);
+    for (auto *nt : {&net1, &net4}) {
+        uint64_t pos = _RNG->position();
+        nt->random_connect(40, 2.);
+        _RNG->position(pos);
+    }
+    for (size_t nn=0; nn<nlinks; nn++)
+        EXPECT_EQ(net1.neighbors(nn), net4.neighbors(nn));
+// --- a complete graph: every other neuron is picked exactly once
+    net1.resize(50);
+    EXPECT_EQ(50*49, net1.random_connect(1000, 2.));
+    EXPECT_EQ(49, net1.degree(7).first);
+}
+
+TEST(networkTest, propagation) {
+    Network net2(net);
+    net2.set_event_driven(false);
+    EXPECT_TRUE(net.is_event_driven());
+    std::vector<double> noisev(net.size());
+    size_t nfirs = 0;
+    for (size_t t=0; t<50; t++) {
+        _RNG->normal(noisev, 0, noise);
+        std::set<size_t> firs = net.step(noisev);
+        EXPECT_EQ(firs, net2.step(noisev));
+        nfirs += firs.size();
+    }
+    EXPECT_GT(nfirs, 0);
+    EXPECT_EQ(net.potentials(), net2.potentials());
+    EXPECT_EQ(net.recoveries(), net2.recoveries());
+}
+
+TEST(networkTest, spikelist) {
+    Network net2(net), net3(net);
+    SpikeList firing;
+    size_t nfirs = 0;
+    for (size_t t=0; t<50; t++) {
+        std::set<size_t> firs = net2.step(noise, t);
+        net3.step(noise, t, firing);
+        ASSERT_EQ(net.size(), firing.num_neurons());
+        EXPECT_TRUE(std::equal(firs.begin(), firs.end(), firing.begin()) && firs.size() == firing.size());
+        size_t members = 0;
+        for (size_t nn=0; nn<net.size(); nn++) members += firing.contains(nn);
+        EXPECT_EQ(firs.size(), members);
+        EXPECT_EQ(firs.size(), firing.count(0, net.size()));
+        EXPECT_EQ(std::distance(firs.lower_bound(70), firs.lower_bound(710)), firing.count(70, 710));
+        nfirs += firing.size();
+    }
+    EXPECT_GT(nfirs, 0);
+    EXPECT_EQ(net2.potentials(), net3.potentials());
+    SpikeList sl(130);
+    std::vector<size_t> idx{0, 63, 64, 127, 129};
+    sl.assign(idx.begin(), idx.end());
+    EXPECT_EQ(2, sl.count(63, 65));
+    EXPECT_EQ(1, sl.count(64, 127));
+    EXPECT_EQ(5, sl.count(0, 130));
+    sl.assign(idx.begin()+4, idx.end());
+    EXPECT_FALSE(sl.contains(63));
+    EXPECT_TRUE(sl.contains(129));
+    EXPECT_EQ(1, sl.size());
+}
+
+TEST(networkTest, threads) {
+    Network net2(net), net3(net);
+    net2.set_threads(4);
+    net3.set_threads(3);
+    net3.set_event_driven(false);
+    EXPECT_EQ(4, net2.num_threads());
+    std::vector<double> noisev(net.size());
+    for (size_t t=0; t<50; t++) {
+        _RNG->normal(noisev, 0, noise);
+        std::set<size_t> firs = net.step(noisev);
+        EXPECT_EQ(firs, net2.step(noisev));
+        EXPECT_EQ(firs, net3.step(noisev));
+    }
+    for (size_t t=0; t<20; t++) {
+        std::set<size_t> firs = net.step(noise, t);
+        EXPECT_EQ(firs, net2.step(noise, t));
+        EXPECT_EQ(firs, net3.step(noise, t));
+    }
+    EXPECT_EQ(net.potentials(), net2.potentials());
+    EXPECT_EQ(net.potentials(), net3.potentials());
+    EXPECT_EQ(net.recoveries(), net2.recoveries());
+// --- copies have their own pool: they can be stepped at the same time from different threads
+    Network copied(net2), assigned;
+    assigned = net2;
+    EXPECT_EQ(4, copied.num_threads());
+    EXPECT_EQ(4, assigned.num_threads());
+    std::vector<std::set<size_t> > spikes1, spikes2;
+    auto run = [&noisev] (Network *nw, std::vector<std::set<size_t> > *spk) {
+        for (size_t t=0; t<50; t++) spk->push_back(nw->step(noisev));
+    };
+    std::thread th(run, &copied, &spikes1);
+    run(&assigned, &spikes2);
+    th.join();
+    EXPECT_EQ(spikes1, spikes2);
+    EXPECT_EQ(copied.potentials(), assigned.potentials());
+// --- the workers are known to the profiler by their thread ids
+    ThreadPool pool(3);
+    ASSERT_EQ(2, pool.thread_ids().size());
+#ifdef __linux__
+    EXPECT_GT(pool.thread_ids()[0], 0);
+    EXPECT_NE(pool.thread_ids()[0], pool.thread_ids()[1]);
+#endif
+}
+
+TEST(networkTest, snapshot) {
+    std::string fname = ::testing::TempDir() + "nn_snapshot.bin";
+    Snapshot::save(net, fname, Snapshot::RunState(42, 7, 1234));
+    Network net2;
+    Snapshot::RunState rs = Snapshot::load(net2, fname);
+    EXPECT_EQ(42, rs.time);
+    EXPECT_EQ(7, rs.seed);
+    EXPECT_EQ(1234, rs.rng_position);
+    ASSERT_EQ(net.size(), net2.size());
+    EXPECT_EQ(net.potentials(), net2.potentials());
+    EXPECT_EQ(net.recoveries(), net2.recoveries());
+    for (size_t n=0; n<net.size(); n+=7) {
+        EXPECT_EQ(net.neuron(n).type(), net2.neuron(n).type());
+        EXPECT_EQ(net.neighbors(n), net2.neighbors(n));
+    }
+    for (size_t t=0; t<20; t++) EXPECT_EQ(net.step(noise, t), net2.step(noise, t));
+    EXPECT_EQ(net.potentials(), net2.potentials());
+    net2.resize(10);
+    EXPECT_EQ(10, net2.size());
+    std::ofstream(fname) << "not a snapshot";
+    EXPECT_THROW(Snapshot::load(net2, fname), CFILE_ERROR);
+// --- a link index out of range is rejected: the single source 999 is the only aligned word of this value in the file
+    Network small;
+    small.resize(1000);
+    ASSERT_TRUE(small.add_link(998, 999, 1.));
+    Snapshot::save(small, fname);
+    std::string bytes;
+    {
+        std::ifstream inf(fname, std::ios::binary);
+        bytes.assign((std::istreambuf_iterator<char>(inf)), std::istreambuf_iterator<char>());
+    }
+    size_t pos = 0;
+    for (size_t p=0; p+8<=bytes.size(); p+=64)
+        if (*reinterpret_cast<const uint64_t*>(&bytes[p]) == 999) pos = p;
+    ASSERT_GT(pos, 0);
+    EXPECT_NO_THROW(Snapshot::load(net2, fname));
+    const uint64_t bad = 1000;
+    {
+        std::fstream outf(fname, std::ios::binary | std::ios::in | std::ios::out);
+        outf.seekp(pos);
+        outf.write((const char*)&bad, sizeof(bad));
+    }
+    EXPECT_THROW(Snapshot::load(net2, fname), CFILE_ERROR);
+// --- row of sources {997, 998}: an unsorted row, a row which is not the transpose of the targets 
+// --- and a number of links whose section sizes wrap around (header word at byte 24) are rejected
+    Network pair;
+    pair.resize(1000);
+    ASSERT_TRUE(pair.add_link(999, 997, 1.));
+    ASSERT_TRUE(pair.add_link(999, 998, 1.));
+    auto patch = [&fname] (const size_t at, const std::vector<uint64_t> &words) {
+        std::fstream outf(fname, std::ios::binary | std::ios::in | std::ios::out);
+        outf.seekp(at);
+        outf.write((const char*)words.data(), 8*words.size());
+    };
+    const std::vector<std::vector<uint64_t> > corrupt{{998, 997}, {996, 998}};
+    for (auto &words : corrupt) {
+        Snapshot::save(pair, fname);
+        std::ifstream inf(fname, std::ios::binary);
+        bytes.assign((std::istreambuf_iterator<char>(inf)), std::istreambuf_iterator<char>());
+        pos = 0;
+        for (size_t p=0; p+16<=bytes.size(); p+=64)
+            if (*reinterpret_cast<const uint64_t*>(&bytes[p]) == 997 && *reinterpret_cast<const uint64_t*>(&bytes[p+8]) == 998) pos = p;
+        ASSERT_GT(pos, 0);
+        EXPECT_NO_THROW(Snapshot::load(net2, fname));
+        patch(pos, words);
+        EXPECT_THROW(Snapshot::load(net2, fname), CFILE_ERROR);
+    }
+    Snapshot::save(pair, fname);
+    patch(24, {(uint64_t)1 << 61});
+    EXPECT_THROW(Snapshot::load(net2, fname), CFILE_ERROR);
+    std::remove(fname.c_str());
+}
+
+TEST(networkTest, reorder) {
+// --- intensities in multiples of 1/4 are summed exactly in any order: the reordered networks fire exactly the same neurons
+    *_RNG = RandomNumbers(31);
+    Network base;
+    base.resize(500, .2);
+    base.set_default_params({{"FS", 60}, {"IB", 40}, {"CH", 40}}, 100);
+    edgelist el;
+    for (size_t a=0; a<500; a++)
+        for (int k=0; k<20; k++)
+            el.push_back({a, (size_t)(_RNG->uniform_double()*500), .25*(1+(int)(_RNG->uniform_double()*16)), 1+k%3});
+    base.set_links(el);
+    Network rcm(base), typed(base);
+    rcm.set_threads(3);
+    rcm.reorder(rcm.locality_order("rcm"));
+    typed.reorder(typed.locality_order("type"));
+    EXPECT_FALSE(base.is_reordered());
+    ASSERT_TRUE(rcm.is_reordered());
+    for (size_t e=0; e<base.size(); e++) {
+        EXPECT_EQ(e, rcm.external(rcm.internal(e)));
+        EXPECT_EQ(base.type(e), rcm.type(rcm.internal(e)));
+        if (e) {
+            EXPECT_LE(typed.type(e-1), typed.type(e));
+        }
+    }
+    for (size_t e=0; e<base.size(); e+=7) {
+        std::vector<std::pair<size_t, double> > neigh(rcm.neighbors(rcm.internal(e)));
+        for (auto &l : neigh) l.first = rcm.external(l.first);
+        std::sort(neigh.begin(), neigh.end());
+        EXPECT_EQ(base.neighbors(e), neigh);
+        EXPECT_EQ(base.out_degree(e), rcm.out_degree(rcm.internal(e)));
+    }
+    std::stringstream pars, rpars;
+    base.print_params(&pars);
+    rcm.print_params(&rpars);
+    EXPECT_EQ(pars.str(), rpars.str());
+    SpikeList firing, rfiring, tfiring;
+    size_t nfirs = 0;
+    for (size_t t=0; t<60; t++) {
+        base.step(noise, t, firing);
+        rcm.step(noise, t, rfiring);
+        typed.step(noise, t, tfiring);
+        std::vector<size_t> expected(firing.begin(), firing.end()), spikes(rfiring.begin(), rfiring.end()),
+            tspikes(tfiring.begin(), tfiring.end());
+        rcm.to_external(spikes);
+        typed.to_external(tspikes);
+        EXPECT_EQ(expected, spikes);
+        EXPECT_EQ(expected, tspikes);
+        nfirs += expected.size();
+    }
+    EXPECT_GT(nfirs, 0);
+    for (size_t e=0; e<base.size(); e++) EXPECT_EQ(base.neuron(e).potential(), rcm.neuron(rcm.internal(e)).potential());
+// --- the permutation and the input in transit are saved with the network
+    std::string fname = ::testing::TempDir() + "nn_reorder.bin";
+    Snapshot::save(rcm, fname);
+    Network loaded;
+    Snapshot::load(loaded, fname);
+    ASSERT_TRUE(loaded.is_reordered());
+    for (size_t k=0; k<base.size(); k++) EXPECT_EQ(rcm.external(k), loaded.external(k));
+    for (size_t t=60; t<80; t++) {
+        rcm.step(noise, t, rfiring);
+        loaded.step(noise, t, firing);
+        EXPECT_EQ(std::vector<size_t>(rfiring.begin(), rfiring.end()), std::vector<size_t>(firing.begin(), firing.end()));
+    }
+    std::remove(fname.c_str());
+    EXPECT_THROW(rcm.reorder(std::vector<size_t>(base.size(), 0)), TCLAP_ERROR);
+    EXPECT_THROW(rcm.locality_order("random"), TCLAP_ERROR);
+    EXPECT_THROW(TrialBatch(rcm, {1, 2}), TCLAP_ERROR);
+}
+
+TEST(networkTest, delays) {
+// --- a spike of neuron 1 reaches neuron 2 at the next step and neuron 0 three steps later
+    std::string fname = ::testing::TempDir() + "nn_delays.txt";
+    std::ofstream(fname) << "0; RS\n1; RS; v=40\n2; RS\nlink; 0,1:10:3; 2,1:10\n";
+    ConfigReader conf(fname);
+    ASSERT_EQ(2, conf.links().size());
+    EXPECT_EQ(3, conf.links()[0].delay);
+    Network small;
+    small.resize(3, 0);
+    small.set_types_params(conf.types(), conf.params());
+    small.set_values(conf.potentials());
+    small.set_links(conf.links());
+    EXPECT_EQ(3, small.max_delay());
+    EXPECT_EQ(std::vector<int>{3}, small.delays(0));
+    std::vector<double> inputs;
+    for (int t=0; t<4; t++) {
+        small.step(std::vector<double>(3, 0.));
+        inputs.push_back(small.neuron(0).input());
+        inputs.push_back(small.neuron(2).input());
+    }
+    EXPECT_EQ(std::vector<double>({0, 5, 0, 0, 5, 0, 0, 0}), inputs);
+    std::ofstream(fname) << "link; 0,1:1:0\n";
+    EXPECT_THROW(ConfigReader conf2(fname), CFILE_ERROR);
+    std::remove(fname.c_str());
+// --- random delays do not depend on the number of threads, and survive a snapshot with their input in transit
+    *_RNG = RandomNumbers(23);
+    Network base;
+    base.resize(1000, .2);
+    base.random_connect(20, 4., 8);
+    *_RNG = RandomNumbers(23);
+    Network threaded;
+    threaded.set_threads(3);
+    threaded.resize(1000, .2);
+    threaded.random_connect(20, 4., 8);
+    EXPECT_EQ(8, base.max_delay());
+    double mean = 0;
+    size_t links = 0;
+    for (size_t n=0; n<base.size(); n++) {
+        std::vector<int> dl = base.delays(n);
+        EXPECT_EQ(dl, threaded.delays(n));
+        for (int d : dl) {
+            EXPECT_TRUE(d >= 1 && d <= 8);
+            mean += d;
+        }
+        links += dl.size();
+    }
+    EXPECT_NEAR(4.5, mean/links, .1);
+    for (size_t t=0; t<30; t++) EXPECT_EQ(base.step(noise, t), threaded.step(noise, t));
+    fname = ::testing::TempDir() + "nn_delays.bin";
+    Snapshot::save(base, fname);
+    Network loaded;
+    Snapshot::load(loaded, fname);
+    for (size_t t=30; t<60; t++) EXPECT_EQ(base.step(noise, t), loaded.step(noise, t));
+    EXPECT_EQ(base.potentials(), loaded.potentials());
+    EXPECT_THROW(TrialBatch(base, {1, 2}), TCLAP_ERROR);
+    std::remove(fname.c_str());
+}
+
+TEST(networkTest, batch) {
+    Network base;
+    base.resize(300, .2);
+    base.random_connect(20, 4.);
+    std::vector<unsigned long> seeds{11, 12, 13, 14, 15};
+    const NeuronPopulation::SimdLevel best = NeuronPopulation::simd_level();
+    std::vector<std::vector<std::set<size_t> > > rasters(seeds.size());
+    std::vector<std::vector<double> > potentials(seeds.size());
+    RandomNumbers *global = _RNG;
+    for (size_t k=0; k<seeds.size(); k++) {
+        Network single(base);
+        _RNG = new RandomNumbers(seeds[k]);
+        for (int t=0; t<100; t++) rasters[k].push_back(single.step(noise, t));
+        potentials[k] = single.potentials();
+        delete _RNG;
+    }
+    _RNG = global;
+// --- each trial follows the network stepped alone with its seed, with all kernels and on several threads
+    for (auto level : {NeuronPopulation::SCALAR, best}) {
+        NeuronPopulation::set_simd_level(level);
+        TrialBatch batch(base, seeds, 3);
+        EXPECT_EQ(seeds.size(), batch.trials());
+        for (int t=0; t<100; t++) {
+            batch.step(noise, t);
+            for (size_t k=0; k<seeds.size(); k++)
+                EXPECT_EQ(std::vector<size_t>(rasters[k][t].begin(), rasters[k][t].end()), batch.spikes(k));
+        }
+        for (size_t k=0; k<seeds.size(); k++)
+            for (size_t nn=0; nn<base.size(); nn++)
+                EXPECT_EQ(potentials[k][nn], batch.potential(k, nn));
+    }
+    NeuronPopulation::set_simd_level(best);
+}
+
+TEST(networkTest, precision) {
+    Network ref;
+    ref.resize(nlinks, .2);
+    ref.random_connect(40, 1.);
+    BasicNetwork<float> single(ref), scalar(ref);
+    EXPECT_EQ(ref.neighbors(3).size(), single.neighbors(3).size());
+    const SimdDispatch::SimdLevel best = SimdDispatch::simd_level();
+    size_t nspikes_ref = 0, nspikes = 0;
+    double mean_ref = 0, mean = 0;
+    for (int t=0; t<1000; t++) {
+        nspikes_ref += ref.step(5., t).size();
+        std::set<size_t> firs = single.step(5., t);
+        nspikes += firs.size();
+        SimdDispatch::set_simd_level(SimdDispatch::SCALAR);
+        EXPECT_EQ(firs, scalar.step(5., t));
+        SimdDispatch::set_simd_level(best);
+        std::vector<double> pref = ref.potentials(), pot = single.potentials();
+        for (size_t nn=0; nn<nlinks; nn++) {
+            if (t < 50) {
+                EXPECT_NEAR(pref[nn], pot[nn], 1.+.01*std::abs(pref[nn]));
+            }
+            mean_ref += pref[nn];
+            mean += pot[nn];
+        }
+    }
+// --- the float kernels agree with each other exactly, and with the reference (up to 1% at the spike peaks)
+// --- before chaos sets in; on longer runs only the firing rate and mean potential are comparable
+    EXPECT_EQ(single.potentials(), scalar.potentials());
+    EXPECT_NEAR(1., (double)nspikes/nspikes_ref, .02);
+    EXPECT_NEAR(mean_ref/(1000*nlinks), mean/(1000*nlinks), .1);
+}
+
+TEST(networkTest, compact) {
+    *_RNG = RandomNumbers(11);
+    Network full;
+    full.resize(2000, .2);
+    full.random_connect(40, 1.);
+    size_t bytes_u32 = 0;
+    for (std::string name : {"u32-f32", "u32-f16", "u32-i8", "varint-f32", "varint-f16", "varint-i8"}) {
+        Network net(full);
+        net.set_compact(CompactSynapses::parse_format(name));
+        ASSERT_TRUE(net.is_compact());
+        const CompactSynapses &cs = *net.compact_synapses();
+        EXPECT_EQ(CompactSynapses::format_name(cs.get_format()), name);
+        EXPECT_EQ(full.neighbors(0).size()+full.neighbors(1999).size(), cs.degree(0)+cs.degree(1999));
+        double bound = 0;
+        for (size_t n=0; n<full.size(); n++) {
+            std::vector<std::pair<size_t, double> > ref = full.neighbors(n), row = net.neighbors(n);
+            ASSERT_EQ(ref.size(), row.size());
+// --- half precision: relative error 2^-11, absolute 2^-25 for subnormal numbers
+            double rowmax = 0;
+            for (auto &l : ref) rowmax = std::max(rowmax, std::abs(l.second));
+            for (size_t k=0; k<ref.size(); k++) {
+                EXPECT_EQ(ref[k].first, row[k].first);
+                double tol = (name.find("f32") != std::string::npos) ? 1e-7*std::abs(ref[k].second)
+                    : (name.find("f16") != std::string::npos) ? std::max(std::abs(ref[k].second)/2048, std::ldexp(1., -25)) : rowmax/254*1.0001;
+                EXPECT_NEAR(ref[k].second, row[k].second, tol);
+                bound = std::max(bound, std::abs(ref[k].second-row[k].second));
+            }
+        }
+        EXPECT_DOUBLE_EQ(bound, cs.max_error());
+        EXPECT_FALSE(net.add_link(0, 1, 1.));
+        double per_link = (double)cs.bytes()/cs.num_links();
+        if (name == "u32-i8") {
+            EXPECT_LT(per_link, 6);
+            bytes_u32 = cs.bytes();
+        }
+        if (name == "varint-i8") {
+            EXPECT_LT(cs.bytes(), bytes_u32);
+        }
+    }
+// --- with single precision intensities, a float network runs exactly as with the full table
+    BasicNetwork<float> single(full), compact(full);
+    single.set_event_driven(false);
+    compact.set_compact(CompactSynapses::parse_format("u32-f32"));
+    compact.set_threads(3);
+    for (int t=0; t<200; t++) EXPECT_EQ(single.step(5., t), compact.step(5., t));
+    EXPECT_EQ(single.potentials(), compact.potentials());
+// --- random links coded as they are drawn are those of the full table
+    *_RNG = RandomNumbers(11);
+    Network direct;
+    direct.set_compact(CompactSynapses::parse_format("varint-i8"));
+    direct.resize(2000, .2);
+    direct.set_threads(3);
+    EXPECT_EQ(0, direct.degree(1999).first);
+    direct.random_connect(40, 1.);
+    Network converted(full);
+    converted.set_compact(CompactSynapses::parse_format("varint-i8"));
+    for (size_t n=0; n<full.size(); n+=97) EXPECT_EQ(converted.neighbors(n), direct.neighbors(n));
+    EXPECT_EQ(converted.compact_synapses()->bytes(), direct.compact_synapses()->bytes());
+    EXPECT_THROW(Snapshot(direct, Snapshot::RunState()), OUTPUT_ERROR);
+// --- 32-bit indices cannot number more than 2^32 neurons
+    const size_t huge = (size_t)UINT32_MAX+1;
+    EXPECT_THROW(CompactSynapses::parse_format("u32-i8", huge), TCLAP_ERROR);
+    EXPECT_NO_THROW(CompactSynapses::parse_format("u32-i8", UINT32_MAX));
+    EXPECT_NO_THROW(CompactSynapses::parse_format("varint-i8", huge));
+}
+
+TEST(networkTest, compactRows) {
+// --- row n links from neurons 0, 3, ..., 3(n%50) with intensity n: decoded row by row in both index codings
+    for (std::string name : {"u32-f32", "varint-f32"}) {
+        CompactSynapses cs(CompactSynapses::parse_format(name));
+        std::vector<size_t> src;
+        std::vector<double> w;
+        for (size_t n=0; n<3000; n++) {
+            src.clear();
+            for (size_t s=0; s<=3*(n%50); s+=3) src.push_back(s);
+            w.assign(src.size(), n);
+            cs.add_row(src.data(), w.data(), src.size());
+        }
+        size_t links = 0;
+        std::vector<std::pair<size_t, double> > row;
+        for (size_t n=0; n<cs.size(); n++) {
+            cs.row(n, row);
+            ASSERT_EQ(n%50+1, cs.degree(n));
+            ASSERT_EQ(cs.degree(n), row.size());
+            for (size_t k=0; k<row.size(); k++) {
+                EXPECT_EQ(3*k, row[k].first);
+                EXPECT_EQ(n, row[k].second);
+            }
+            EXPECT_DOUBLE_EQ((double)n*(n%50+1), cs.valence(n));
+            links += cs.degree(n);
+        }
+        EXPECT_EQ(links, cs.num_links());
+    }
+}
+
+TEST(networkTest, ranks) {
+// --- each rank simulates its slice with the spikes gathered from all ranks: they all see the spikes of the whole network
+    auto build = [] (Network &nt, RankGroup *group) {
+        *_RNG = RandomNumbers(37);
+        nt.resize(300, .2);
+        if (group) nt.set_slice(group->slice(300).first, group->slice(300).second);
+        nt.set_default_params({{"FS", 30}, {"CH", 30}}, 60);
+        nt.random_connect(30, 4., 3);
+    };
+    RankGroup group(3);
+    Network base, sliced;
+    build(base, nullptr);
+    build(sliced, &group);
+    const std::pair<size_t, size_t> own = group.slice(300);
+    EXPECT_TRUE(sliced.is_sliced());
+    EXPECT_EQ(own.second-own.first, sliced.slice_end()-sliced.slice_begin());
+    for (size_t n=0; n<300; n+=11) {
+        if (!sliced.owns(n)) continue;
+        EXPECT_EQ(base.neighbors(n), sliced.neighbors(n));
+    }
+    group.allocate(300);
+    std::vector<size_t> local, all;
+    sliced.next_spikes(local);
+    group.exchange(local, all);
+    SpikeList firing, sfiring;
+    size_t nfirs = 0;
+    for (size_t t=0; t<80; t++) {
+        base.step(4., t, firing);
+        sliced.step(4., t, all, sfiring);
+        EXPECT_EQ(std::vector<size_t>(firing.begin(), firing.end()), std::vector<size_t>(sfiring.begin(), sfiring.end()));
+        nfirs += firing.size();
+        sliced.next_spikes(local);
+        group.exchange(local, all);
+    }
+    EXPECT_GT(nfirs, 0u);
+    if (group.rank()) {
+        group.finish();
+        std::fflush(nullptr);
+        std::_Exit(::testing::Test::HasFailure() ? 1 : 0);
+    }
+    EXPECT_NO_THROW(group.finish());
+}
+
+TEST(configTest, parse) {
+    std::string fname = ::testing::TempDir() + "nn_config.txt";
+    std::ofstream(fname) << "# test network\n\n2; FS; v=-60\n0 ;RS\n 1;IB; A=0.03; inhibitory=1\n"
+                         << "Link; 0,1:2.5; 2 ,0:1; 0,1:7; 1,1:3; 0,5:1\n";
+    ConfigReader conf(fname);
+    ASSERT_EQ(3, conf.size());
+    EXPECT_EQ("FS", conf.types()[0]);
+    EXPECT_EQ(-60, conf.potentials()[0]);
+    EXPECT_EQ(0.03, conf.params()[2].a);
+    EXPECT_TRUE(conf.params()[2].inhib);
+    EXPECT_EQ(5, conf.links().size());
+    Network net2;
+    net2.resize(3, 0);
+    net2.set_types_params(conf.types(), conf.params());
+    EXPECT_EQ(2, net2.set_links(conf.links()));
+    EXPECT_EQ(1, net2.neighbors(1).size());
+    EXPECT_EQ(2, net2.neighbors(1)[0].first);
+    EXPECT_EQ(-5, net2.neighbors(1)[0].second);
+    EXPECT_EQ(1, net2.neighbors(0)[0].first);
+// --- a file large enough to be split in chunks gives the same result with several threads
+    {
+        std::ofstream cf(fname);
+        for (size_t k=0; k<20000; k++) cf << k << "; RS; v=" << -65-(k%7) << "; d=" << k%5 << "\n";
+        for (size_t k=0; k<20000; k++) cf << "link; " << k << "," << (7*k+3)%20000 << ":" << k%13 << "\n";
+    }
+    ConfigReader conf1(fname), conf4(fname, 4);
+    ASSERT_EQ(20000, conf4.size());
+    EXPECT_EQ(conf1.potentials(), conf4.potentials());
+    ASSERT_EQ(conf1.links().size(), conf4.links().size());
+    for (size_t k=0; k<conf1.links().size(); k++) {
+        EXPECT_EQ(conf1.links()[k].source, conf4.links()[k].source);
+        EXPECT_EQ(conf1.links()[k].weight, conf4.links()[k].weight);
+    }
+    EXPECT_EQ(4, conf4.params()[19999].d);
+    std::ofstream(fname) << "0; RS\nlink; 0:3\n";
+    EXPECT_THROW(ConfigReader(fname, 1), CFILE_ERROR);
+    std::remove(fname.c_str());
+}
+
+TEST(populationTest, simd) {
+    NeuronPopulation::SimdLevel best = NeuronPopulation::simd_level();
+    Network net2(net);
+    std::vector<double> noisev(net.size());
+    std::vector<std::set<size_t> > firs1, firs2;
+    RandomNumbers rng(2019);
+    NeuronPopulation::set_simd_level(NeuronPopulation::SCALAR);
+    EXPECT_EQ(NeuronPopulation::SCALAR, NeuronPopulation::simd_level());
+    for (size_t t=0; t<50; t++) {
+        rng.normal(noisev, 0, noise);
+        firs1.push_back(net.step(noisev));
+    }
+    NeuronPopulation::set_simd_level(best);
+    RandomNumbers rng2(2019);
+    for (size_t t=0; t<50; t++) {
+        rng2.normal(noisev, 0, noise);
+        firs2.push_back(net2.step(noisev));
+    }
+    EXPECT_EQ(firs1, firs2);
+    EXPECT_EQ(net.potentials(), net2.potentials());
+    EXPECT_EQ(net.recoveries(), net2.recoveries());
+// --- the population kernel gives the same values as Neuron::step
+    Neuron nr = net2.neuron(7);
+    NeuronPopulation pop;
+    pop.resize(1);
+    pop.set(0, nr);
+    double th = 4., ex = 3., in = 1.;
+    size_t spk;
+    pop.step_range(0, 1, &th, &ex, &in, &spk);
+    if (nr.firing()) nr.reset();
+    nr.input((nr.is_inhibitory() ? .4 : 1.)*th + .5*ex - in);
+    nr.step();
+    EXPECT_EQ(nr.potential(), pop.potential(0));
+    EXPECT_EQ(nr.recovery(), pop.recovery(0));
+}
+
+TEST(populationTest, types) {
+    NeuronPopulation pop;
+    pop.resize(1000);
+    Neuron nr;
+    for (size_t k=300; k<700; k++) {
+        nr.set_default_params(k<500 ? "FS" : "CH");
+        pop.set(k, nr);
+    }
+    nr.set_default_params("IB", .5);
+    pop.set(600, nr);
+    NeuronPopulation ref(pop);
+// --- only the neuron with noisy parameters is left to the generic kernel
+    pop.classify();
+    EXPECT_EQ(999, pop.typed_neurons());
+    std::vector<double> thal(1000), exc(1000), inh(1000);
+    RandomNumbers rng(2021);
+    for (int t=0; t<200; t++) {
+        rng.normal(thal, 0, noise);
+        rng.uniform_double(exc, 0, 10);
+        rng.uniform_double(inh, 0, 5);
+        pop.step(thal.data(), exc.data(), inh.data());
+        NeuronPopulation::set_type_kernels(false);
+        ref.step(thal.data(), exc.data(), inh.data());
+        NeuronPopulation::set_type_kernels(true);
+        EXPECT_EQ(ref.spikes(), pop.spikes());
+    }
+    for (size_t k=0; k<1000; k++) {
+        EXPECT_EQ(ref.potential(k), pop.potential(k));
+        EXPECT_EQ(ref.recovery(k), pop.recovery(k));
+    }
+    for (size_t k=0; k<1000; k++) {
+        nr.set_default_params("RS", rng.uniform_double());
+        pop.set(k, nr);
+    }
+    pop.classify();
+    EXPECT_EQ(0, pop.typed_neurons());
+}
+
+TEST(outputTest, resume) {
+    std::string fname = ::testing::TempDir() + "nn_resume";
+    {
+        std::ofstream outf(fname);
+        outf << "\tRS.v\n1\t0.5\n2\t0.6\n3\t0.7\n4\t0.";
+    }
+    OutputWriter::truncate_text(fname, 2);
+    std::ifstream inf(fname);
+    std::string content((std::istreambuf_iterator<char>(inf)), std::istreambuf_iterator<char>());
+    EXPECT_EQ("\tRS.v\n1\t0.5\n2\t0.6\n", content);
+// --- an AER raster cut after step 5 and continued gives the same file as an uninterrupted one
+    std::vector<std::vector<size_t> > spk{{1, 4}, {}, {0}, {2, 3}, {5}, {1}, {}, {0, 5}};
+    std::ostringstream full;
+    {
+        AerWriter aer(&full, 6);
+        for (size_t t=0; t<spk.size(); t++) aer.write(t+1, spk[t]);
+        aer.close(8);
+    }
+    {
+        std::ofstream outf(fname, std::ios::binary);
+        AerWriter aer(&outf, 6);
+        for (size_t t=0; t<7; t++) aer.write(t+1, spk[t]);
+        aer.close(7);
+    }
+    uint64_t last = AerReader::truncate(fname, 5);
+    EXPECT_EQ(5, last);
+    {
+        std::ofstream outf(fname, std::ios::binary | std::ios::app);
+        AerWriter aer(&outf, 6, true, last);
+        for (size_t t=5; t<spk.size(); t++) aer.write(t+1, spk[t]);
+        aer.close(8);
+    }
+    std::ifstream ainf(fname, std::ios::binary);
+    std::string resumed((std::istreambuf_iterator<char>(ainf)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(full.str(), resumed);
+    std::remove(fname.c_str());
+}
+
+TEST(outputTest, resumedRun) {
+// --- a run interrupted at a checkpoint and resumed writes the same files as an uninterrupted one,
+// --- for a random network and a configuration file with a type after RS in alphabetical order
+    const std::string dir = ::testing::TempDir(), conf = dir + "nn_resume.conf";
+    {
+        std::ofstream outf(conf);
+        const char *types[4] = {"RS", "TC", "FS", "IB"};
+        for (int k=0; k<200; k++) outf << k << "; " << types[k%4] << "\n";
+    }
+    auto simulate = [] (std::vector<std::string> args) {
+        args.insert(args.begin(), "NeuronNet");
+        std::vector<char*> argv;
+        for (auto &a : args) argv.push_back(&a[0]);
+        Simulation sim(argv.size(), argv.data());
+        sim.run();
+    };
+    auto content = [] (const std::string &fname) {
+        std::ifstream inf(fname, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(inf)), std::istreambuf_iterator<char>());
+    };
+    const std::vector<std::vector<std::string> > networks{{"-N", "200", "-T", "TC:0.2,IB:0.1", "--seed", "3"},
+                                                          {"-c", conf, "--seed", "3"}};
+    for (auto nw : networks) {
+        const std::string full = dir + "nn_full", part = dir + "nn_part", ckpt = dir + "nn_resume.ckpt";
+        std::vector<std::string> args(nw);
+        args.insert(args.end(), {"-t", "200", "-o", full});
+        simulate(args);
+        args = nw;
+        args.insert(args.end(), {"-t", "100", "-o", part, "--checkpoint", ckpt, "--checkpoint-every", "100"});
+        simulate(args);
+        simulate({"-t", "200", "-o", part, "--resume", ckpt});
+        for (std::string suffix : {"", "_traj", "_pars"}) {
+            EXPECT_EQ(content(full+suffix), content(part+suffix)) << nw[0] << " " << suffix;
+            std::remove((full+suffix).c_str());
+            std::remove((part+suffix).c_str());
+        }
+        EXPECT_THROW(simulate({"-t", "200", "-o", part, "--resume", ckpt, "--stats"}), TCLAP_ERROR);
+        std::remove(ckpt.c_str());
+    }
+    std::remove(conf.c_str());
+}
+
+TEST(outputTest, checkpointSkip) {
+// --- a checkpoint waits for the outputs of its time-step, the next one is skipped meanwhile instead of blocking the run
+    std::string fname = ::testing::TempDir() + "nn_skip.ckpt";
+    std::ostringstream rast;
+    OutputWriter writer(&rast, nullptr, net.size(), false);
+    CheckpointWriter ckpt(fname);
+    ckpt.save(net, Snapshot::RunState(3), &writer);
+    EXPECT_FALSE(ckpt.ready());
+    ckpt.save(net, Snapshot::RunState(4), &writer);
+    EXPECT_EQ(1, ckpt.count());
+    EXPECT_EQ(1, ckpt.skipped());
+    for (int t=1; t<=3; t++) {
+        OutputWriter::StepRecord &rec = writer.acquire();
+        rec.time = t;
+        rec.spikes.clear();
+        rec.values.clear();
+        rec.sync = (t == 3);
+        writer.publish();
+    }
+    ckpt.finish();
+    EXPECT_TRUE(ckpt.ready());
+    writer.close(3);
+    Network loaded;
+    EXPECT_EQ(3, Snapshot::load(loaded, fname).time);
+    std::remove(fname.c_str());
+}
+
+TEST(outputTest, profile) {
+    Network net2(net);
+    Profiler prof;
+    net2.set_profiler(&prof);
+    prof.start();
+    size_t nspikes = 0;
+    for (size_t t=0; t<20; t++) nspikes += net2.step(noise, t).size();
+    nspikes += net2.step(noise, 20).size();
+    prof.stop();
+    EXPECT_EQ(21, prof.steps());
+    EXPECT_GT(prof.time(Profiler::UPDATE), 0);
+    EXPECT_GT(Profiler::peak_memory(), 0);
+    std::ostringstream json;
+    prof.write_json(&json);
+    EXPECT_NE(std::string::npos, json.str().find("\"steps\": 21"));
+    EXPECT_NE(std::string::npos, json.str().find("\"synaptic_events_per_second\""));
+    EXPECT_NE(std::string::npos, json.str().find("\"typed_neurons\": "));
+}
+
+TEST(outputTest, allocations) {
+// --- after a warm-up, a simulation step (network, trajectory values, writer thread, binary trajectories and statistics) 
+// --- does not allocate memory
+    std::string fname = ::testing::TempDir() + "nn_alloc";
+    *_RNG = RandomNumbers(5);
+    Network push, pull, delayed;
+    for (Network *nt : {&push, &pull, &delayed}) {
+        nt->resize(1000, .2);
+        nt->set_threads(3);
+    }
+    push.random_connect(30, 2.);
+    pull.random_connect(30, 2.);
+    pull.set_event_driven(false);
+    delayed.random_connect(30, 2., 6);
+    BasicNetwork<float> single(push);
+    Network compact(push);
+    compact.set_compact(CompactSynapses::parse_format("varint-i8"));
+    Profiler prof;
+    push.set_profiler(&prof);
+    TrialBatch batch(pull, {1, 2, 3}, 2);
+    std::map<std::string, size_t> ntypes{{"FS", 400}};
+    std::vector<size_t> trajidx(push.traj_neurons(ntypes));
+// --- the recorder gets 8 records per step, so that several blocks are written by its thread during the audit
+    Recorder recorder(push, "random:20", ntypes);
+    recorder.open(fname+"_bin");
+    PopulationStats pstats(push, 4);
+    pstats.reserve(800);
+    for (bool aer : {false, true}) {
+        std::ofstream outf(fname), outf2(fname+"_traj");
+        OutputWriter writer(&outf, &outf2, push.size(), aer, 8);
+        SpikeList firing;
+        for (int t=0; t<400; t++) {
+            if (t == 200) count_allocations = true;
+            push.step(noise, t, firing);
+            OutputWriter::StepRecord &rec = writer.acquire();
+            rec.time = t+1;
+            rec.spikes.assign(firing.begin(), firing.end());
+            rec.values.clear();
+            push.state_values(trajidx, rec.values);
+            rec.sync = false;
+            writer.publish();
+            pull.step(noise, t, firing);
+            delayed.step(noise, t, firing);
+            single.step(noise, t, firing);
+            compact.step(noise, t, firing);
+            batch.step(noise, t);
+            push.print_traj(t, ntypes, &outf2);
+            for (int k=0; k<8; k++) recorder.record(8*(400*aer+t)+k, push);
+            pstats.record(400*aer+t+1, firing);
+        }
+        count_allocations = false;
+        writer.close(400);
+    }
+    recorder.close();
+    EXPECT_EQ(0, num_allocations.load());
+// --- the audit sees the growth of the aligned arrays of the populations and links
+    count_allocations = true;
+    ArrayStore<double> grown;
+    grown.resize(1000);
+    count_allocations = false;
+    EXPECT_GT(num_allocations.load(), 0);
+    push.set_profiler(nullptr);
+    std::remove(fname.c_str());
+    std::remove((fname+"_traj").c_str());
+    std::remove((fname+"_bin").c_str());
+}
+
+TEST(outputTest, stats) {
+// --- 3 FS and 5 RS neurons with given spikes: neuron 0 (FS) fires every 2 steps, neuron 5 (RS) at steps 3 and 9
+    Network small;
+    small.resize(8, 0);
+    small.set_default_params({{"FS", 3}});
+    PopulationStats st(small, 4, 10);
+    ASSERT_EQ(3, st.num_groups());
+    EXPECT_EQ("FS", st.group_name(0));
+    EXPECT_EQ("all", st.group_name(2));
+    EXPECT_EQ(5, st.group_size(1));
+    SpikeList spk(8);
+    for (int t=1; t<=10; t++) {
+        std::vector<size_t> idx;
+        if (t%2 == 0) idx.push_back(0);
+        if (t == 3 || t == 9) idx.push_back(5);
+        spk.assign(idx.begin(), idx.end());
+        st.record(t, spk);
+    }
+    EXPECT_EQ(10, st.steps());
+    EXPECT_EQ(5, st.spikes(0));
+    EXPECT_EQ(7, st.spikes(2));
+    EXPECT_NEAR(1000.*5/3/10, st.rate(0), 1e-9);
+    EXPECT_NEAR(40, st.rate(1), 1e-9);
+    EXPECT_NEAR(4./5, st.silent_fraction(1), 1e-12);
+    EXPECT_NEAR(2, st.isi_mean(0), 1e-12);
+    EXPECT_NEAR(0, st.isi_cv(0), 1e-12);
+    EXPECT_NEAR(2.8, st.isi_mean(2), 1e-12);
+    EXPECT_EQ(4, st.isi_histogram(0)[1]);
+    EXPECT_EQ(1, st.isi_histogram(2)[5]);
+// --- windows of 4 steps: 2 complete ones and a partial one of 2 steps
+    std::vector<double> series(st.rate_series(0));
+    ASSERT_EQ(3, series.size());
+    for (auto r : series) EXPECT_NEAR(1000./6, r, 1e-9);
+    EXPECT_NEAR(0, st.fano_factor(0), 1e-12);
+    EXPECT_NEAR(0.125, st.synchrony(2), 1e-12);
+    std::ostringstream json;
+    st.write_json(&json);
+    EXPECT_NE(std::string::npos, json.str().find("\"type\": \"RS\", \"neurons\": 5, \"spikes\": 2"));
+    EXPECT_NE(std::string::npos, json.str().find("\"isi_bins\": 10"));
+// --- on a simulated network, the groups add up to the whole population
+    Network net2(net);
+    PopulationStats st2(net2);
+    SpikeList firing;
+    for (int t=0; t<300; t++) {
+        net2.step(noise, t, firing);
+        st2.record(t+1, firing);
+    }
+    uint64_t total = 0;
+    for (size_t g=0; g+1<st2.num_groups(); g++) total += st2.spikes(g);
+    EXPECT_EQ(st2.spikes(st2.num_groups()-1), total);
+    EXPECT_GT(total, 0);
+    EXPECT_EQ(3, st2.rate_series(0).size());
+}
+
+TEST(outputTest, recorder) {
+    std::map<std::string, size_t> ntypes{{"FS", 0}};
+    for (size_t nn=0; nn<net.size(); nn++) if (net.type(nn) == "FS") ntypes["FS"]++;
+    Recorder reps(net, "types", ntypes);
+    EXPECT_EQ(net.traj_neurons(ntypes), reps.neurons());
+    Recorder list(net, "3,1", ntypes, 2);
+    EXPECT_EQ(std::vector<size_t>({3, 1}), list.neurons());
+    EXPECT_EQ(net.type(3)+"3", list.labels()[0]);
+    EXPECT_TRUE(list.due(4));
+    EXPECT_FALSE(list.due(5));
+    EXPECT_THROW(Recorder(net, "2,100000", ntypes), TCLAP_ERROR);
+    EXPECT_THROW(Recorder(net, "random:x", ntypes), TCLAP_ERROR);
+    Recorder sample(net, "random:10", ntypes), sample2(net, "random:10", ntypes);
+    EXPECT_EQ(10, sample.neurons().size());
+    EXPECT_EQ(sample.neurons(), sample2.neurons());
+    EXPECT_TRUE(std::adjacent_find(sample.neurons().begin(), sample.neurons().end(),
+                                   std::greater_equal<size_t>()) == sample.neurons().end());
+// --- binary file: a full block, a block cut by a checkpoint at step 1200, then the rest of the run
+    std::string fname = ::testing::TempDir() + "nn_traj";
+    Network net2(net);
+    SpikeList firing;
+    std::vector<double> expected;
+    {
+        sample.open(fname);
+        for (int t=1; t<=1500; t++) {
+            net2.step(noise, t, firing);
+            sample.values(net2, expected);
+            sample.record(t, net2);
+            if (t == 1200) sample.sync();
+        }
+        sample.close();
+    }
+    std::ifstream inf(fname, std::ios::binary);
+    std::vector<size_t> idx;
+    Recorder::Header head = Recorder::read_header(inf, idx);
+    EXPECT_EQ(sample.neurons(), idx);
+    EXPECT_EQ(1, head.every);
+    std::vector<int64_t> times;
+    std::vector<double> cols;
+    std::vector<size_t> counts;
+    bool same = true;
+    int64_t last = 0;
+    while (Recorder::read_block(inf, 10, times, cols)) {
+        counts.push_back(times.size());
+        for (size_t j=0; j<times.size(); j++) {
+            same = same && (times[j] == ++last);
+            for (size_t k=0; k<30; k++)
+                same = same && (cols[k*times.size()+j] == expected[(last-1)*30 + 3*(k%10) + k/10]);
+        }
+    }
+    inf.close();
+    EXPECT_EQ(std::vector<size_t>({_TRAJ_BLOCK_, 1200-_TRAJ_BLOCK_, 300}), counts);
+    EXPECT_TRUE(same);
+    Recorder::truncate(fname, 1300);
+    std::ifstream inf2(fname, std::ios::binary);
+    Recorder::read_header(inf2, idx);
+    while (Recorder::read_block(inf2, 10, times, cols)) last = times.back();
+    EXPECT_EQ(1200, last);
+    std::remove(fname.c_str());
+}
+
+TEST(outputTest, aer) {
+    std::stringstream aerstr, txtstr;
+    {
+        AerWriter aerw(&aerstr, 300);
+        aerw.write(2, std::set<size_t>{0, 5, 299});
+        aerw.write(3, std::set<size_t>{});
+        aerw.write(4, std::vector<size_t>{130, 131});
+        aerw.close(5);
+    }
+// --- without close, the records are written but not the end record; write errors are not thrown by the destructor
+    std::stringstream cut;
+    {
+        AerWriter aerw(&cut, 300);
+        aerw.write(2, std::set<size_t>{7});
+    }
+    AerReader cutr(&cut);
+    std::vector<size_t> cutspk;
+    uint64_t cutstep;
+    EXPECT_TRUE(cutr.next(cutstep, cutspk));
+    EXPECT_EQ(std::vector<size_t>({7}), cutspk);
+    EXPECT_THROW(cutr.next(cutstep, cutspk), CFILE_ERROR);
+    {
+        std::ostringstream bad;
+        bad.setstate(std::ios::badbit);
+        EXPECT_NO_THROW(AerWriter(&bad, 300).write(2, std::set<size_t>{7}));
+    }
+    AerReader aerr(&aerstr);
+    EXPECT_EQ(300, aerr.size());
+    std::vector<size_t> spk;
+    uint64_t step;
+    EXPECT_TRUE(aerr.next(step, spk));
+    EXPECT_EQ(2, step);
+    EXPECT_EQ(std::vector<size_t>({0, 5, 299}), spk);
+    EXPECT_TRUE(aerr.next(step, spk));
+    EXPECT_EQ(4, step);
+    EXPECT_EQ(std::vector<size_t>({130, 131}), spk);
+    EXPECT_FALSE(aerr.next(step, spk));
+    EXPECT_EQ(5, step);
+    aerstr.clear();
+    aerstr.seekg(0);
+    AerReader::to_text(&aerstr, &txtstr);
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(txtstr, line); ) lines.push_back(line);
+    EXPECT_EQ(5, lines.size());
+    std::string expec("4");
+    for (size_t nn=0; nn<300; nn++) expec += (nn==130 || nn==131) ? " 1" : " 0";
+    EXPECT_EQ(expec, lines[3]);
+    EXPECT_EQ(std::string::npos, lines[4].find('1', 1));
+    std::stringstream bad("NNTXT");
+    EXPECT_THROW(AerReader badr(&bad), CFILE_ERROR);
+}
+
+TEST(outputTest, writer) {
+    std::stringstream rast, traj, expec_rast, expec_traj;
+    OutputWriter writer(&rast, &traj, 5, false, 2);
+    EXPECT_EQ(2, writer.capacity());
+    for (int t=1; t<=200; t++) {
+        OutputWriter::StepRecord &rec = writer.acquire();
+        rec.time = t;
+        rec.spikes.assign(1, t%5);
+        rec.values.assign(3, -.5*t);
+        writer.publish();
+        expec_rast << t;
+        for (int nn=0; nn<5; nn++) expec_rast << ' ' << (int)(nn==t%5);
+        expec_rast << std::endl;
+        expec_traj << t << '\t' << -.5*t << '\t' << -.5*t << '\t' << -.5*t << std::endl;
+    }
+    writer.close(200);
+    EXPECT_EQ(expec_rast.str(), rast.str());
+    EXPECT_EQ(expec_traj.str(), traj.str());
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
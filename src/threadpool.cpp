@@ -0,0 +1,70 @@
+#include "threadpool.h"
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+ThreadPool::ThreadPool(const size_t n) : next_task(0) {
+    tids.assign(n > 1 ? n-1 : 0, 0);
+    for (size_t k=1; k<n; k++) workers.emplace_back(&ThreadPool::work, this, k-1);
+// --- the workers have recorded their ids when the pool is returned
+    std::unique_lock<std::mutex> lock(mtx);
+    done_cv.wait(lock, [this] {return started == tids.size();});
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+    }
+    start_cv.notify_all();
+    for (auto &W : workers) W.join();
+}
+
+void ThreadPool::run(const size_t ntasks, const std::function<void(size_t)> &f) {
+    if (workers.empty() || ntasks < 2) {
+        for (size_t k=0; k<ntasks; k++) f(k);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        task = &f;
+        num_tasks = ntasks;
+        next_task = 0;
+        active = workers.size();
+        generation++;
+    }
+    start_cv.notify_all();
+    do_tasks();
+    std::unique_lock<std::mutex> lock(mtx);
+    done_cv.wait(lock, [this] {return active == 0;});
+    task = nullptr;
+}
+
+void ThreadPool::do_tasks() {
+    for (size_t k=next_task++; k<num_tasks; k=next_task++) (*task)(k);
+}
+
+void ThreadPool::work(const size_t k) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+#ifdef __linux__
+        tids[k] = syscall(SYS_gettid);
+#else
+        tids[k] = 0;
+#endif
+        if (++started == tids.size()) done_cv.notify_one();
+    }
+    size_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            start_cv.wait(lock, [&] {return stop || generation != seen;});
+            if (stop) return;
+            seen = generation;
+        }
+        do_tasks();
+        std::lock_guard<std::mutex> lock(mtx);
+        if (--active == 0) done_cv.notify_one();
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*! \class ThreadPool
+  A persistent pool of worker threads, created once and reused at every time-step.
+
+  \ref run executes a number of independent tasks (identified by their index) and returns when all are done.
+  Tasks are taken in increasing order by the calling thread and the workers as they become free,
+  so the result of a task must only depend on its index for the computation to be deterministic.
+ */
+
+class ThreadPool {
+
+public:
+/*!
+  Creates a pool running on \p n threads: the calling thread and \p n-1 workers.
+ */
+    ThreadPool(const size_t n);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+/*!
+  Number of threads, including the calling thread.
+ */
+    size_t size() const {return workers.size()+1;}
+/*!
+  System thread ids of the workers (Linux, 0 elsewhere), for instance to attach hardware counters (Profiler::add_thread).
+ */
+    const std::vector<long>& thread_ids() const {return tids;}
+/*!
+  Calls \p f(k) for k=0..\p ntasks-1 on all threads of the pool, returns when all calls are finished.
+ */
+    void run(const size_t ntasks, const std::function<void(size_t)> &f);
+
+private:
+    void work(const size_t);
+    void do_tasks();
+
+    std::vector<std::thread> workers;
+    std::vector<long> tids;
+    std::mutex mtx;
+    std::condition_variable start_cv, done_cv;
+    const std::function<void(size_t)> *task = nullptr;
+    size_t num_tasks = 0, generation = 0, active = 0, started = 0;
+    std::atomic<size_t> next_task;
+    bool stop = false;
+
+};
+
+#endif //THREADPOOL_H
@@ -0,0 +1,118 @@
+#include "writer.h"
+#include <unistd.h>
+
+OutputWriter::OutputWriter(std::ostream *_raster, std::ostream *_traj, const size_t n, const bool aer,
+                           const size_t cap, const bool append, const uint64_t aer_last)
+    : raster(_raster), traj(_traj), nneurons(n), ring(std::max(cap, (size_t)2)),
+      head(0), tail(0), done(false), failed(false), synced(-1) {
+    if (aer && raster) aerw.reset(new AerWriter(raster, n, append, aer_last));
+    worker = std::thread(&OutputWriter::run, this);
+}
+
+OutputWriter::~OutputWriter() {
+    done = true;
+    if (worker.joinable()) worker.join();
+}
+
+OutputWriter::StepRecord& OutputWriter::acquire() {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= ring.size()) {
+        auto start = std::chrono::steady_clock::now();
+        num_stalls++;
+        while (h - tail.load(std::memory_order_acquire) >= ring.size()) {
+            if (failed.load(std::memory_order_acquire)) break;
+            std::this_thread::yield();
+        }
+        stall_time += std::chrono::steady_clock::now() - start;
+    }
+    StepRecord &rec = ring[h % ring.size()];
+// --- every slot gets the capacity of the largest record so far (doubled, the activity of a network drifts), so that filling it does not allocate
+    if (rec.spikes.capacity() < largest_spikes) rec.spikes.reserve(2*largest_spikes);
+    if (rec.values.capacity() < largest_values) rec.values.reserve(largest_values);
+    return rec;
+}
+
+void OutputWriter::publish() {
+    const StepRecord &rec = ring[head.load(std::memory_order_relaxed) % ring.size()];
+    largest_spikes = std::max(largest_spikes, rec.spikes.size());
+    largest_values = std::max(largest_values, rec.values.size());
+    head.store(head.load(std::memory_order_relaxed)+1, std::memory_order_release);
+}
+
+void OutputWriter::close(const int endtime) {
+    if (!worker.joinable()) return;
+    done.store(true, std::memory_order_release);
+    worker.join();
+    if (error) std::rethrow_exception(error);
+    if (aerw) aerw->close(endtime);
+    if (raster) raster->flush();
+    if (traj) traj->flush();
+    if (num_stalls)
+        std::cerr << "Output writer: " << num_stalls << " stalls (" << stall_seconds()
+                  << " s) waiting for the disk" << std::endl;
+}
+
+void OutputWriter::run() {
+    try {
+        size_t idle = 0;
+        while (true) {
+            size_t t = tail.load(std::memory_order_relaxed);
+            if (t == head.load(std::memory_order_acquire)) {
+                if (done.load(std::memory_order_acquire) && t == head.load(std::memory_order_acquire)) break;
+                if (++idle < 64) std::this_thread::yield();
+                else std::this_thread::sleep_for(std::chrono::microseconds(50));
+                continue;
+            }
+            idle = 0;
+            write(ring[t % ring.size()]);
+            tail.store(t+1, std::memory_order_release);
+        }
+    } catch (...) {
+        error = std::current_exception();
+        failed.store(true, std::memory_order_release);
+    }
+}
+
+void OutputWriter::write(const StepRecord &rec) {
+    auto start = std::chrono::steady_clock::now();
+    if (aerw) aerw->write(rec.time, rec.spikes);
+    else if (raster) {
+        line.assign(2*nneurons, ' ');
+        for (size_t nn=0; nn<nneurons; nn++) line[2*nn+1] = '0';
+        for (auto nn : rec.spikes) line[2*nn+1] = '1';
+        (*raster) << rec.time << line << '\n';
+    }
+    if (raster && raster->bad()) throw(OUTPUT_ERROR("Cannot write the raster output"));
+    auto lap = std::chrono::steady_clock::now();
+    raster_time += lap - start;
+    if (traj && !rec.values.empty()) {
+        (*traj) << rec.time;
+        for (size_t k=0; k<rec.values.size(); k++) (*traj) << '\t' << rec.values[k];
+        (*traj) << '\n';
+        if (traj->bad()) throw(OUTPUT_ERROR("Cannot write the trajectory output"));
+        traj_time += std::chrono::steady_clock::now() - lap;
+    }
+    if (rec.sync) {
+        if (aerw) aerw->sync();
+        if (raster) raster->flush();
+        if (traj) traj->flush();
+        if ((raster && raster->bad()) || (traj && traj->bad())) throw(OUTPUT_ERROR("Cannot write the outputs"));
+        synced.store(rec.time, std::memory_order_release);
+    }
+}
+
+void OutputWriter::truncate_text(const std::string &filename, const int time) {
+    std::ifstream inf(filename);
+    if (!inf.is_open()) throw(CFILE_ERROR("Could not open file " + filename));
+    std::string line;
+    std::streamoff offset = 0;
+    while (std::getline(inf, line)) {
+        char *end;
+        long t = strtol(line.c_str(), &end, 10);
+        if (end != line.c_str() && t > time) break;
+        if (inf.eof()) break;
+        offset = inf.tellg();
+    }
+    inf.close();
+    if (::truncate(filename.c_str(), offset) != 0) throw(OUTPUT_ERROR("Cannot truncate file " + filename));
+}
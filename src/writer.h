@@ -0,0 +1,120 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include "globals.h"
+#include "aer.h"
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <thread>
+
+/*! \class OutputWriter
+  Formats and writes the raster and trajectory outputs of Simulation::run on a separate thread,
+  so that the integration of the next time-steps overlaps the serialization of the previous ones.
+
+  The simulation thread fills a \ref StepRecord (spikes and recorded values of one time-step) obtained with \ref acquire
+  and hands it over with \ref publish. Records go through a bounded single-producer single-consumer ring of
+  \ref capacity slots, synchronized by two atomic counters only (no lock). The records are reused, so their vectors
+  do not allocate once they have reached their working size.
+
+  If the writer thread cannot keep up (slow disk), \ref acquire waits for a free slot:
+  these backpressure stalls are counted (\ref stalls, \ref stall_seconds) and reported by \ref close.
+ */
+
+class OutputWriter {
+
+public:
+/*!
+  Output of one time-step: the indices of firing neurons (increasing order) and the recorded variables
+  (for the trajectory file, 3 values per recorded neuron, no line is written for a step without values).
+ */
+    struct StepRecord {
+        int time;
+        std::vector<size_t> spikes;
+        std::vector<double> values;
+/*!
+  If true, the streams are flushed after this record is written and \ref synced_time is updated.
+ */
+        bool sync = false;
+    };
+/*!
+  Starts the writer thread.
+  \param _raster : stream for the raster (nullptr if not written),
+  \param _traj : stream for the trajectories (nullptr if not written),
+  \param n : number of neurons,
+  \param aer : true for the binary AER format (\ref AerWriter), false for the text raster,
+  \param cap : number of slots of the ring,
+  \param append : the streams continue the outputs of a resumed run (see \ref truncate_text and AerReader::truncate),
+  \param aer_last : time-step of the last record of the AER raster which is continued.
+ */
+    OutputWriter(std::ostream *_raster, std::ostream *_traj, const size_t n, const bool aer,
+                 const size_t cap=_QUEUE_SIZE_, const bool append=false, const uint64_t aer_last=0);
+    ~OutputWriter();
+/*! @name Producer side
+  The slot returned by \ref acquire has at least the capacity of the largest record published so far,
+  so that once the outputs have reached their steady state, filling the records does not allocate memory.
+ */
+///@{
+    StepRecord& acquire();
+    void publish();
+///@}
+/*!
+  Waits until all records are written, flushes the streams and stops the writer thread.
+  Errors of the writer thread are re-thrown here. If there were stalls, they are reported on std::cerr.
+  \param endtime : last time-step (for the AER end record).
+ */
+    void close(const int endtime);
+/*!
+  Time-step of the last record with the \ref StepRecord::sync flag which is written and flushed (-1 if none).
+  \ref ok is false if the writer thread stopped on an error.
+ */
+///@{
+    long synced_time() const {return synced.load(std::memory_order_acquire);}
+    bool ok() const {return !failed.load(std::memory_order_acquire);}
+///@}
+/*!
+  Removes the lines of a text output (raster or trajectories) starting with a time-step larger than \p time,
+  so that a resumed run can append its output. Lines which do not start with a number (headers) are kept.
+ */
+    static void truncate_text(const std::string &filename, const int time);
+    size_t capacity() const {return ring.size();}
+    size_t stalls() const {return num_stalls;}
+    double stall_seconds() const {return stall_time.count();}
+/*!
+  Time spent by the writer thread writing the raster and the trajectories.
+ */
+///@{
+    double raster_seconds() const {return raster_time.count();}
+    double traj_seconds() const {return traj_time.count();}
+///@}
+
+private:
+    void run();
+    void write(const StepRecord&);
+
+    std::ostream *raster, *traj;
+    size_t nneurons;
+    std::unique_ptr<AerWriter> aerw;
+    std::vector<StepRecord> ring;
+/*! @name Ring counters
+  \ref head is the number of records published, \ref tail the number of records written.
+ */
+///@{
+    std::atomic<size_t> head, tail;
+///@}
+    std::atomic<bool> done, failed;
+    std::atomic<long> synced;
+    std::exception_ptr error;
+    std::thread worker;
+    size_t num_stalls = 0;
+/*!
+  Sizes of the largest record published, the slots of the ring are grown to them in \ref acquire.
+ */
+    size_t largest_spikes = 0, largest_values = 0;
+    std::chrono::duration<double> stall_time{0}, raster_time{0}, traj_time{0};
+    std::string line;
+
+};
+
+#endif //WRITER_H